@@ -0,0 +1,28 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <types.hpp>
+
+// Small in-tree LZ77 codec in the LZ4 block layout: a token byte with
+// literal/match lengths, the literals, then a 16-bit offset. Greedy single
+// hash-probe matching; fast rather than tight. Used for trace chunks and
+// save-state sections.
+namespace compress {
+
+[[nodiscard]] std::vector<U8> Compress(std::span<const U8> input);
+
+// Largest output Compress() can produce for `size` input bytes: incompressible
+// data grows by its literal-length bytes and one token. Readers use it to
+// reject stored sizes before allocating.
+[[nodiscard]] constexpr Size CompressBound(Size size) { return size + size / 255 + 16; }
+
+// Largest output Decompress() can produce from `size` input bytes; every
+// length-extension byte stands for at most 255 output bytes
+[[nodiscard]] constexpr Size DecompressBound(Size size) { return size * 255; }
+
+// Fills `output` exactly (its size must be the original size); false if the
+// data is corrupt or doesn't decode to that size
+[[nodiscard]] bool Decompress(std::span<const U8> input, std::span<U8> output);
+
+} // namespace compress
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <expected>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <types.hpp>
+
+namespace file {
+
+// Writes `path` through a temporary next to it, flushed to disk, and renames
+// it into place, so a crash or power loss leaves the old file or the new one
+[[nodiscard]] bool WriteAtomic(const std::filesystem::path& path, std::span<const U8> data);
+
+// Shared read-write mapping of a whole file, created or resized to `size`
+// (new bytes are zero). Pages load on first touch and writes reach the file
+// through the page cache; Sync() forces them out.
+class MappedFile {
+public:
+    static std::expected<MappedFile, std::string> Open(const std::filesystem::path& path, Size size);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    [[nodiscard]] std::span<U8> Data() const { return {m_Data, m_Size}; }
+    // Blocks until dirty pages are on disk; safe alongside writes from other threads
+    bool Sync() const;
+
+private:
+    MappedFile() = default;
+    void Close();
+
+    U8* m_Data{};
+    Size m_Size{0};
+#ifdef _WIN32
+    void* m_File{};
+    void* m_Mapping{};
+#else
+    int m_Fd{-1};
+#endif
+};
+
+} // namespace file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <span>
+#include <type_traits>
+#include <types.hpp>
+
+namespace hash {
+
+// Streaming XXH64: fast, well-distributed 64-bit hash for framebuffers and
+// emulator state. Output matches the reference implementation on
+// little-endian hosts.
+class Xxh64 {
+public:
+    explicit Xxh64(U64 seed = 0);
+
+    void Update(const void* data, Size size);
+    template<typename T>
+    void Update(std::span<const T> values) { Update(values.data(), values.size_bytes()); }
+    // Trivially copyable values by their bytes, e.g. registers and small arrays
+    template<typename... Ts>
+        requires (std::is_trivially_copyable_v<Ts> && ...)
+    void Add(const Ts&... values) { (Update(&values, sizeof(Ts)), ...); }
+
+    [[nodiscard]] U64 Digest() const;
+
+private:
+    std::array<U64, 4> m_Acc;
+    std::array<U8, 32> m_Buffer{};
+    Size m_Buffered{0};
+    U64 m_TotalSize{0};
+    U64 m_Seed;
+};
+
+[[nodiscard]] U64 Xxh64Of(const void* data, Size size, U64 seed = 0);
+
+template<typename T>
+[[nodiscard]] U64 Xxh64Of(std::span<const T> values, U64 seed = 0)
+{
+    return Xxh64Of(values.data(), values.size_bytes(), seed);
+}
+
+// Hash of a memory region of up to MaxBytes that only rehashes the pages
+// written since the last Digest(). Every store must call MarkDirty().
+template<Size MaxBytes, Size PageSize = 0x100>
+class PageHashes {
+public:
+    PageHashes() { MarkAllDirty(); }
+
+    void MarkDirty(Size offset) { m_Dirty[offset / (PageSize * 64)] |= 1ull << (offset / PageSize % 64); }
+    void MarkAllDirty() { m_Dirty.fill(~0ull); }
+
+    // `data` is the same region each call
+    [[nodiscard]] U64 Digest(std::span<const U8> data) const
+    {
+        const Size pages = (data.size() + PageSize - 1) / PageSize;
+        bool changed = false;
+        for (Size word = 0; word < m_Dirty.size(); ++word)
+        {
+            changed |= m_Dirty[word] != 0;
+            for (U64 bits = m_Dirty[word]; bits != 0; bits &= bits - 1)
+            {
+                const Size page = word * 64 + static_cast<Size>(std::countr_zero(bits));
+                if (page >= pages)
+                    break;
+                const Size offset = page * PageSize;
+                m_Hashes[page] = Xxh64Of(data.data() + offset, std::min(PageSize, data.size() - offset));
+            }
+            m_Dirty[word] = 0;
+        }
+        if (changed)
+            m_Digest = Xxh64Of(std::span<const U64>{m_Hashes.data(), pages});
+        return m_Digest;
+    }
+
+private:
+    static constexpr Size Pages = MaxBytes / PageSize;
+
+    mutable std::array<U64, (Pages + 63) / 64> m_Dirty;
+    mutable std::array<U64, Pages> m_Hashes{};
+    mutable U64 m_Digest{0};
+};
+
+// CRC-32 (IEEE, as in zlib/PNG). Pass the previous result to continue a running checksum.
+[[nodiscard]] U32 Crc32(const void* data, Size size, U32 crc = 0);
+
+} // namespace hash
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <string_view>
+#include <types.hpp>
+
+// Host-side timing spans. PHOSPHOR_SPAN(zone) times the enclosing scope and
+// adds it to the zone's total for the current frame; EndFrame() closes the
+// frame and feeds the min/avg/p99 history. While tracing, spans are also
+// kept as events for a Chrome trace (chrome://tracing, Perfetto).
+//
+// Spans cost a relaxed atomic load when disabled at runtime and nothing at
+// all when built with PHOSPHOR_INSTRUMENT=OFF.
+namespace instrument {
+
+enum class Zone : U8 {
+    Emulate,     // Whole emulated frame (inclusive of Render and Synthesis)
+    Render,      // PPU scanline rendering
+    Synthesis,   // APU channel ticking and sample generation
+    QueueAudio,  // Handing samples to SDL
+    Present,     // Texture upload and SDL present
+    Rollback,    // Netplay restore and re-run after a misprediction (inside Emulate)
+    Cpu,         // Derived per frame: Emulate - Render - Synthesis
+    Count
+};
+
+// Zones are closed per frame by the thread that owns them
+enum class Track : U8 { Emulation, Presentation };
+
+struct ZoneStats {
+    double MinMs{};
+    double AvgMs{};
+    double P99Ms{};
+};
+
+[[nodiscard]] constexpr std::string_view ZoneName(Zone zone)
+{
+    constexpr std::array<std::string_view, static_cast<Size>(Zone::Count)> names = {
+        "Emulate", "Render", "Synthesis", "QueueAudio", "Present", "Rollback", "CPU"
+    };
+    return names[static_cast<Size>(zone)];
+}
+
+#ifdef PHOSPHOR_INSTRUMENT
+
+void SetEnabled(bool enabled);
+[[nodiscard]] bool Enabled();
+
+// Starts collecting events for WriteChromeTrace (also enables spans)
+void StartTrace();
+bool WriteChromeTrace(const std::filesystem::path& path);
+void SetThreadName(std::string_view name);
+
+void EndFrame(Track track);
+[[nodiscard]] ZoneStats Stats(Zone zone);
+
+[[nodiscard]] U64 Now();
+void Record(Zone zone, U64 start, U64 end);
+
+class Span {
+public:
+    explicit Span(Zone zone) : m_Zone{zone}, m_Start{Enabled() ? Now() : 0} {}
+    ~Span() { if (m_Start != 0) Record(m_Zone, m_Start, Now()); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+private:
+    Zone m_Zone;
+    U64 m_Start;
+};
+
+#define PHOSPHOR_SPAN_CONCAT_(a, b) a##b
+#define PHOSPHOR_SPAN_NAME_(line) PHOSPHOR_SPAN_CONCAT_(phosphorSpan, line)
+#define PHOSPHOR_SPAN(zone) const ::instrument::Span PHOSPHOR_SPAN_NAME_(__LINE__){zone}
+
+#else
+
+inline void SetEnabled(bool) {}
+[[nodiscard]] inline bool Enabled() { return false; }
+inline void StartTrace() {}
+inline bool WriteChromeTrace(const std::filesystem::path&) { return false; }
+inline void SetThreadName(std::string_view) {}
+inline void EndFrame(Track) {}
+[[nodiscard]] inline ZoneStats Stats(Zone) { return {}; }
+
+#define PHOSPHOR_SPAN(zone) static_cast<void>(0)
+
+#endif
+
+} // namespace instrument
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <types.hpp>
+
+namespace net {
+
+// Unreliable datagrams to one peer, as UDP gives them: packets may be lost,
+// duplicated or reordered. Neither call blocks.
+class Transport {
+public:
+    static constexpr Size MaxPacketSize = 1200;  // Fits a typical MTU unfragmented
+
+    virtual ~Transport() = default;
+
+    virtual void Send(std::span<const U8> packet) = 0;
+    // Next packet that has arrived, if any
+    [[nodiscard]] virtual std::optional<std::vector<U8>> Receive() = 0;
+};
+
+// Two connected in-process endpoints for tests. Time is counted in Tick()
+// calls, so runs are reproducible: a packet arrives `latency` ticks after
+// it was sent, and every `dropEvery`-th packet (0: none) is lost. Either end
+// may be used from its own thread.
+class Loopback {
+public:
+    explicit Loopback(U32 latency = 0, U32 dropEvery = 0);
+
+    [[nodiscard]] Transport& End(Size index) { return m_Ends[index]; }
+    void Tick();
+
+private:
+    struct Packet {
+        U64 ArrivalTick;
+        std::vector<U8> Data;
+    };
+
+    class Endpoint : public Transport {
+    public:
+        Endpoint(Loopback& owner, Size index) : m_Owner{owner}, m_Index{index} {}
+        void Send(std::span<const U8> packet) override;
+        [[nodiscard]] std::optional<std::vector<U8>> Receive() override;
+
+    private:
+        Loopback& m_Owner;
+        Size m_Index;
+    };
+
+    std::mutex m_Mutex;
+    std::array<std::deque<Packet>, 2> m_Inboxes;  // Indexed by receiving end
+    U64 m_Tick{0};
+    U32 m_Latency;
+    U32 m_DropEvery;
+    U64 m_Sent{0};
+    std::array<Endpoint, 2> m_Ends{Endpoint{*this, 0}, Endpoint{*this, 1}};
+};
+
+// Non-blocking UDP socket bound to `localPort` and connected to the peer,
+// so only its datagrams are received
+class UdpTransport : public Transport {
+public:
+    static std::expected<std::unique_ptr<UdpTransport>, std::string> Open(U16 localPort, std::string_view peerHost, U16 peerPort);
+    ~UdpTransport() override;
+
+    UdpTransport(const UdpTransport&) = delete;
+    UdpTransport& operator=(const UdpTransport&) = delete;
+
+    void Send(std::span<const U8> packet) override;
+    [[nodiscard]] std::optional<std::vector<U8>> Receive() override;
+
+private:
+    UdpTransport() = default;
+
+#ifdef _WIN32
+    U64 m_Socket{~0ull};  // SOCKET
+#else
+    int m_Socket{-1};
+#endif
+};
+
+} // namespace net
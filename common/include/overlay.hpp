@@ -0,0 +1,17 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+#include <types.hpp>
+
+// Text drawn straight into an ARGB framebuffer before it is uploaded, so
+// status readouts (speed, timings) need no extra render passes.
+namespace overlay {
+
+constexpr S32 CharAdvance = 6;
+constexpr S32 LineHeight = 9;
+
+// Draws text with a 1px dark shadow; pixels outside the buffer are clipped
+void DrawText(std::span<U32> pixels, S32 width, S32 height, S32 x, S32 y, std::string_view text, U32 color);
+
+} // namespace overlay
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <types.hpp>
+
+// Calls body(i) for every i in [0, count) on up to `jobs` threads (0 = one
+// per hardware thread), returning once all of them are done. Indices are
+// handed out one at a time, so a few slow items don't stall a whole slice.
+template<typename F>
+void ParallelFor(Size count, U32 jobs, F&& body)
+{
+    if (jobs == 0)
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    const Size threadCount = std::min<Size>(jobs, count);
+
+    std::atomic<Size> next{0};
+    auto worker = [&] {
+        for (Size i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+             i = next.fetch_add(1, std::memory_order_relaxed))
+            body(i);
+    };
+
+    std::vector<std::jthread> threads;
+    for (Size t = 1; t < threadCount; ++t)
+        threads.emplace_back(worker);
+    worker();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <types.hpp>
+
+namespace audio {
+
+// Dynamic rate control: instead of blocking on the audio queue, the emulator
+// runs off the host clock and the resampling ratio is nudged by at most
+// MaxAdjust so that the queued audio hovers around a small target level.
+// A +-0.5% pitch change is inaudible but absorbs both clock drift and
+// display refresh rates that don't match the Game Boy's ~59.73 Hz.
+class RateControl {
+public:
+    static constexpr double DefaultMaxAdjust = 0.005;
+
+    explicit RateControl(Size targetSamples, double maxAdjust = DefaultMaxAdjust)
+        : m_Target{static_cast<double>(targetSamples)}
+        , m_MaxAdjust{maxAdjust}
+    {
+    }
+
+    // Returns the resampling ratio to use for the next batch of samples
+    [[nodiscard]] double Update(Size queuedSamples)
+    {
+        // Queue level moves in frame-sized steps; smooth it a little so the
+        // ratio doesn't jitter every frame
+        const double fill = static_cast<double>(queuedSamples) / m_Target;
+        m_Fill += (fill - m_Fill) * Smoothing;
+
+        const double error = std::clamp(1.0 - m_Fill, -1.0, 1.0);
+        m_Ratio = 1.0 + m_MaxAdjust * error;
+        return m_Ratio;
+    }
+
+    void Reset() { m_Fill = 1.0; m_Ratio = 1.0; }
+
+    [[nodiscard]] Size TargetSamples() const { return static_cast<Size>(m_Target); }
+    [[nodiscard]] double Ratio() const { return m_Ratio; }
+
+private:
+    static constexpr double Smoothing = 0.1;
+
+    double m_Target;
+    double m_MaxAdjust;
+    double m_Fill{1.0};
+    double m_Ratio{1.0};
+};
+
+} // namespace audio
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <types.hpp>
+
+// Lock-free single-producer/single-consumer ring of trivially copyable
+// records. The producer pushes one at a time; the consumer drains in bulk.
+template<typename T>
+class SpscRing {
+public:
+    // Capacity must be a power of two
+    explicit SpscRing(Size capacity)
+        : m_Buffer{std::make_unique<T[]>(capacity)}
+        , m_Mask{capacity - 1}
+    {
+    }
+
+    // Producer side: false if the ring is full
+    bool TryPush(const T& value)
+    {
+        const Size head = m_Head.load(std::memory_order_relaxed);
+        if (head - m_CachedTail > m_Mask)
+        {
+            m_CachedTail = m_Tail.load(std::memory_order_acquire);
+            if (head - m_CachedTail > m_Mask)
+                return false;
+        }
+        m_Buffer[head & m_Mask] = value;
+        m_Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: copies up to `max` records into `out`, returns the count
+    Size Pop(T* out, Size max)
+    {
+        const Size tail = m_Tail.load(std::memory_order_relaxed);
+        const Size available = std::min(m_Head.load(std::memory_order_acquire) - tail, max);
+        for (Size i = 0; i < available; ++i)
+            out[i] = m_Buffer[(tail + i) & m_Mask];
+        m_Tail.store(tail + available, std::memory_order_release);
+        return available;
+    }
+
+private:
+    // Keep the indices on separate cache lines so the two threads don't share one
+    static constexpr Size CacheLine = 64;
+
+    std::unique_ptr<T[]> m_Buffer;
+    Size m_Mask;
+
+    alignas(CacheLine) std::atomic<Size> m_Head{0};
+    Size m_CachedTail{0};  // Producer's last view of m_Tail
+    alignas(CacheLine) std::atomic<Size> m_Tail{0};
+};
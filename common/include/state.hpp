@@ -1,7 +1,11 @@
 #pragma once
 
-#include <iosfwd>
+#include <istream>
+#include <ostream>
 #include <array>
+#include <expected>
+#include <span>
+#include <string>
 #include <vector>
 #include <types.hpp>
 
@@ -42,7 +46,54 @@ inline void Read(std::istream& in, std::vector<U8>& vec) {
         in.read(reinterpret_cast<char*>(vec.data()), size);
 }
 
+// For untrusted input: a stored size over `maxSize` fails the stream
+// instead of being allocated
+inline void Read(std::istream& in, std::vector<U8>& vec, Size maxSize) {
+    U32 size = 0;
+    Read(in, size);
+    if (size > maxSize) {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+    vec.resize(size);
+    if (size > 0)
+        in.read(reinterpret_cast<char*>(vec.data()), size);
+}
+
 constexpr U32 Magic = 0x53534247;  // "GBSS"
-constexpr U8 Version = 3;
+constexpr U8 Version = 4;
+constexpr U8 LegacyVersion = 3;  // Fields concatenated with no section table
+
+// Far above any real section or whole state (cartridge RAM is at most
+// 128 KiB); larger sizes read from a file are corruption, not something
+// to allocate
+constexpr U32 MaxRawSize = 16 * 1024 * 1024;
+
+// Version 4 container, after Magic and Version:
+//   U32 section count
+//   per section: U32 id, U16 version, U16 flags, U32 offset (from the
+//                start of the file), U32 stored size, U32 raw size,
+//                U32 CRC32 of the raw bytes
+//   section payloads, LZ-compressed when that makes them smaller
+// Unknown sections are skipped, so components can be added freely; a
+// component bumps its section version when its own layout changes.
+struct Section {
+    U32 Id{0};
+    U16 Version{1};
+    std::vector<U8> Data;
+};
+
+[[nodiscard]] constexpr U32 SectionId(const char (&tag)[5]) {
+    return static_cast<U32>(static_cast<U8>(tag[0])) | (static_cast<U32>(static_cast<U8>(tag[1])) << 8)
+         | (static_cast<U32>(static_cast<U8>(tag[2])) << 16) | (static_cast<U32>(static_cast<U8>(tag[3])) << 24);
+}
+
+// Writes Magic, Version, the table and the payloads
+bool WriteSections(std::ostream& out, std::span<const Section> sections);
+
+// Reads the table and payloads following Magic and Version. Only sections
+// listed in `wanted` are loaded (all of them if empty); each is checked
+// against its CRC. Large states decompress on several threads.
+[[nodiscard]] std::expected<std::vector<Section>, std::string> ReadSections(std::istream& in, std::span<const U32> wanted = {});
 
 } // namespace state
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <string_view>
+#include <types.hpp>
+
+// Incremental substring search (Knuth-Morris-Pratt) over a byte stream:
+// Feed() is O(1) amortized per byte and nothing is buffered, so watching
+// serial output for a marker costs the same no matter how long it runs.
+class StreamMatcher {
+public:
+    static constexpr Size MaxPattern = 32;
+
+    explicit constexpr StreamMatcher(std::string_view pattern)
+        : m_Length{pattern.size() < MaxPattern ? pattern.size() : MaxPattern}
+    {
+        for (Size i = 0; i < m_Length; ++i)
+            m_Pattern[i] = pattern[i];
+
+        // m_Fallback[i]: length of the longest proper border of pattern[0..i]
+        for (Size i = 1, k = 0; i < m_Length; ++i)
+        {
+            while (k > 0 && m_Pattern[i] != m_Pattern[k])
+                k = m_Fallback[k - 1];
+            if (m_Pattern[i] == m_Pattern[k])
+                ++k;
+            m_Fallback[i] = static_cast<U8>(k);
+        }
+    }
+
+    // Returns true when the byte completes an occurrence of the pattern
+    constexpr bool Feed(char c)
+    {
+        if (m_Length == 0)
+            return false;
+        while (m_Matched > 0 && c != m_Pattern[m_Matched])
+            m_Matched = m_Fallback[m_Matched - 1];
+        if (c == m_Pattern[m_Matched])
+            ++m_Matched;
+        if (m_Matched == m_Length)
+        {
+            m_Matched = m_Fallback[m_Length - 1];
+            return true;
+        }
+        return false;
+    }
+
+    constexpr void Reset() { m_Matched = 0; }
+
+private:
+    std::array<char, MaxPattern> m_Pattern{};
+    std::array<U8, MaxPattern> m_Fallback{};
+    Size m_Length;
+    Size m_Matched{0};
+};
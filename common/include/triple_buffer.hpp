@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <types.hpp>
+
+// Lock-free single-producer/single-consumer triple buffer. The producer
+// always has a buffer to write into, the consumer always reads the most
+// recently published one, and neither side ever waits for the other.
+template<typename T>
+class TripleBuffer {
+public:
+    // Producer side
+    [[nodiscard]] T& WriteBuffer() { return m_Buffers[m_WriteIndex]; }
+
+    void Publish()
+    {
+        m_WriteIndex = m_Middle.exchange(static_cast<U8>(m_WriteIndex | FreshBit), std::memory_order_acq_rel) & IndexMask;
+    }
+
+    // Consumer side: returns false if nothing new was published since the last call
+    bool Acquire()
+    {
+        if (!(m_Middle.load(std::memory_order_relaxed) & FreshBit))
+            return false;
+        m_ReadIndex = m_Middle.exchange(m_ReadIndex, std::memory_order_acq_rel) & IndexMask;
+        return true;
+    }
+
+    [[nodiscard]] const T& ReadBuffer() const { return m_Buffers[m_ReadIndex]; }
+
+private:
+    static constexpr U8 IndexMask = 0x03;
+    static constexpr U8 FreshBit = 0x04;
+
+    std::array<T, 3> m_Buffers{};
+    U8 m_WriteIndex{0};
+    std::atomic<U8> m_Middle{1};
+    U8 m_ReadIndex{2};
+};
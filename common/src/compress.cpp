@@ -0,0 +1,159 @@
+#include <compress.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace compress {
+
+namespace {
+
+constexpr Size MinMatch = 4;
+constexpr Size MaxOffset = 0xFFFF;
+constexpr U32 HashBits = 14;
+
+U32 Read32(const U8* p)
+{
+    U32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+U32 Hash(U32 sequence)
+{
+    return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+// Lengths >= 15 continue in following bytes: 255s, then the remainder
+void WriteLength(std::vector<U8>& out, Size length)
+{
+    for (; length >= 255; length -= 255)
+        out.push_back(255);
+    out.push_back(static_cast<U8>(length));
+}
+
+bool ReadLength(const U8*& ip, const U8* end, Size& length)
+{
+    U8 byte;
+    do
+    {
+        if (ip == end)
+            return false;
+        byte = *ip++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+void WriteSequence(std::vector<U8>& out, std::span<const U8> literals, Size offset, Size matchLength)
+{
+    const Size extraMatch = matchLength - MinMatch;
+    const U8 token = static_cast<U8>((std::min<Size>(literals.size(), 15) << 4) | std::min<Size>(extraMatch, 15));
+    out.push_back(token);
+    if (literals.size() >= 15)
+        WriteLength(out, literals.size() - 15);
+    out.insert(out.end(), literals.begin(), literals.end());
+
+    out.push_back(static_cast<U8>(offset));
+    out.push_back(static_cast<U8>(offset >> 8));
+    if (extraMatch >= 15)
+        WriteLength(out, extraMatch - 15);
+}
+
+// The final sequence is literals only; the decoder stops at end of input
+void WriteLastLiterals(std::vector<U8>& out, std::span<const U8> literals)
+{
+    out.push_back(static_cast<U8>(std::min<Size>(literals.size(), 15) << 4));
+    if (literals.size() >= 15)
+        WriteLength(out, literals.size() - 15);
+    out.insert(out.end(), literals.begin(), literals.end());
+}
+
+} // namespace
+
+std::vector<U8> Compress(std::span<const U8> input)
+{
+    std::vector<U8> out;
+    out.reserve(input.size() / 2 + 16);
+
+    // Positions + 1, so 0 means empty
+    std::vector<U32> table(Size{1} << HashBits, 0);
+
+    const U8* const base = input.data();
+    const Size size = input.size();
+    Size anchor = 0;
+    Size pos = 0;
+
+    while (pos + MinMatch <= size)
+    {
+        const U32 sequence = Read32(base + pos);
+        U32& slot = table[Hash(sequence)];
+        const Size candidate = slot;
+        slot = static_cast<U32>(pos + 1);
+
+        if (candidate == 0 || pos - (candidate - 1) > MaxOffset || Read32(base + candidate - 1) != sequence)
+        {
+            ++pos;
+            continue;
+        }
+
+        const Size match = candidate - 1;
+        Size length = MinMatch;
+        while (pos + length < size && base[match + length] == base[pos + length])
+            ++length;
+
+        WriteSequence(out, input.subspan(anchor, pos - anchor), pos - match, length);
+        pos += length;
+        anchor = pos;
+    }
+
+    WriteLastLiterals(out, input.subspan(anchor));
+    return out;
+}
+
+bool Decompress(std::span<const U8> input, std::span<U8> output)
+{
+    const U8* ip = input.data();
+    const U8* const end = ip + input.size();
+    U8* op = output.data();
+    U8* const outEnd = op + output.size();
+
+    while (ip < end)
+    {
+        const U8 token = *ip++;
+
+        Size literals = token >> 4;
+        if (literals == 15 && !ReadLength(ip, end, literals))
+            return false;
+        if (static_cast<Size>(end - ip) < literals || static_cast<Size>(outEnd - op) < literals)
+            return false;
+        std::memcpy(op, ip, literals);
+        ip += literals;
+        op += literals;
+
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            return false;
+        const Size offset = ip[0] | (static_cast<Size>(ip[1]) << 8);
+        ip += 2;
+        if (offset == 0 || offset > static_cast<Size>(op - output.data()))
+            return false;
+
+        Size length = token & 0x0F;
+        if (length == 15 && !ReadLength(ip, end, length))
+            return false;
+        length += MinMatch;
+        if (static_cast<Size>(outEnd - op) < length)
+            return false;
+
+        // Byte by byte: matches may overlap their own output (runs)
+        const U8* match = op - offset;
+        for (Size i = 0; i < length; ++i)
+            op[i] = match[i];
+        op += length;
+    }
+
+    return op == outEnd;
+}
+
+} // namespace compress
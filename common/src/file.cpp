@@ -0,0 +1,248 @@
+#include <file.hpp>
+#include <algorithm>
+#include <format>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+namespace file {
+
+namespace {
+
+bool WriteSynced(const std::filesystem::path& path, std::span<const U8> data)
+{
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    const U8* next = data.data();
+    Size left = data.size();
+    while (left > 0)
+    {
+        DWORD written = 0;
+        const auto chunk = static_cast<DWORD>(std::min<Size>(left, Size{1} << 30));
+        if (!::WriteFile(file, next, chunk, &written, nullptr) || written == 0)
+            break;
+        next += written;
+        left -= written;
+    }
+    const bool synced = left == 0 && FlushFileBuffers(file);
+    return CloseHandle(file) && synced;
+}
+
+bool Replace(const std::filesystem::path& from, const std::filesystem::path& to)
+{
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+}
+
+} // namespace
+
+std::expected<MappedFile, std::string> MappedFile::Open(const std::filesystem::path& path, Size size)
+{
+    MappedFile mapped;
+    mapped.m_File = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+        nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (mapped.m_File == INVALID_HANDLE_VALUE)
+    {
+        mapped.m_File = nullptr;
+        return std::unexpected(std::format("Failed to open {}", path.string()));
+    }
+
+    LARGE_INTEGER end{};
+    end.QuadPart = static_cast<LONGLONG>(size);
+    if (!SetFilePointerEx(mapped.m_File, end, nullptr, FILE_BEGIN) || !SetEndOfFile(mapped.m_File))
+        return std::unexpected(std::format("Failed to resize {}", path.string()));
+
+    mapped.m_Mapping = CreateFileMappingW(mapped.m_File, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    if (!mapped.m_Mapping)
+        return std::unexpected(std::format("Failed to map {}", path.string()));
+
+    mapped.m_Data = static_cast<U8*>(MapViewOfFile(mapped.m_Mapping, FILE_MAP_ALL_ACCESS, 0, 0, size));
+    if (!mapped.m_Data)
+        return std::unexpected(std::format("Failed to map {}", path.string()));
+    mapped.m_Size = size;
+    return mapped;
+}
+
+bool MappedFile::Sync() const
+{
+    return m_Data && FlushViewOfFile(m_Data, m_Size) && FlushFileBuffers(m_File);
+}
+
+void MappedFile::Close()
+{
+    if (m_Data)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping)
+        CloseHandle(m_Mapping);
+    if (m_File)
+        CloseHandle(m_File);
+    m_Data = nullptr;
+    m_Mapping = nullptr;
+    m_File = nullptr;
+    m_Size = 0;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_Data{std::exchange(other.m_Data, nullptr)}
+    , m_Size{std::exchange(other.m_Size, 0)}
+    , m_File{std::exchange(other.m_File, nullptr)}
+    , m_Mapping{std::exchange(other.m_Mapping, nullptr)}
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_Data = std::exchange(other.m_Data, nullptr);
+        m_Size = std::exchange(other.m_Size, 0);
+        m_File = std::exchange(other.m_File, nullptr);
+        m_Mapping = std::exchange(other.m_Mapping, nullptr);
+    }
+    return *this;
+}
+
+} // namespace file
+
+#else
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace file {
+
+namespace {
+
+bool WriteSynced(const std::filesystem::path& path, std::span<const U8> data)
+{
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    const U8* next = data.data();
+    Size left = data.size();
+    while (left > 0)
+    {
+        const ssize_t written = ::write(fd, next, left);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            break;
+        next += written;
+        left -= static_cast<Size>(written);
+    }
+    const bool synced = left == 0 && ::fsync(fd) == 0;
+    return ::close(fd) == 0 && synced;
+}
+
+bool Replace(const std::filesystem::path& from, const std::filesystem::path& to)
+{
+    if (std::rename(from.c_str(), to.c_str()) != 0)
+        return false;
+
+    // The new name is an entry in the directory; sync that too so the
+    // rename itself survives a crash
+    const auto parent = to.has_parent_path() ? to.parent_path() : std::filesystem::path{"."};
+    const int dir = ::open(parent.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir >= 0)
+    {
+        (void)::fsync(dir);
+        ::close(dir);
+    }
+    return true;
+}
+
+} // namespace
+
+std::expected<MappedFile, std::string> MappedFile::Open(const std::filesystem::path& path, Size size)
+{
+    MappedFile mapped;
+    mapped.m_Fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (mapped.m_Fd < 0)
+        return std::unexpected(std::format("Failed to open {}", path.string()));
+
+    if (::ftruncate(mapped.m_Fd, static_cast<off_t>(size)) != 0)
+        return std::unexpected(std::format("Failed to resize {}", path.string()));
+
+    void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapped.m_Fd, 0);
+    if (data == MAP_FAILED)
+        return std::unexpected(std::format("Failed to map {}", path.string()));
+
+    mapped.m_Data = static_cast<U8*>(data);
+    mapped.m_Size = size;
+    return mapped;
+}
+
+bool MappedFile::Sync() const
+{
+    return m_Data && ::msync(m_Data, m_Size, MS_SYNC) == 0;
+}
+
+void MappedFile::Close()
+{
+    if (m_Data)
+        ::munmap(m_Data, m_Size);
+    if (m_Fd >= 0)
+        ::close(m_Fd);
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Fd = -1;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : m_Data{std::exchange(other.m_Data, nullptr)}
+    , m_Size{std::exchange(other.m_Size, 0)}
+    , m_Fd{std::exchange(other.m_Fd, -1)}
+{
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_Data = std::exchange(other.m_Data, nullptr);
+        m_Size = std::exchange(other.m_Size, 0);
+        m_Fd = std::exchange(other.m_Fd, -1);
+    }
+    return *this;
+}
+
+} // namespace file
+
+#endif
+
+namespace file {
+
+bool WriteAtomic(const std::filesystem::path& path, std::span<const U8> data)
+{
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+
+    // The data has to be on disk before the rename publishes it, or a crash
+    // can leave an empty or partly written file under the real name
+    if (!WriteSynced(temp, data) || !Replace(temp, path))
+    {
+        std::error_code ignored;
+        std::filesystem::remove(temp, ignored);
+        return false;
+    }
+    return true;
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+} // namespace file
@@ -0,0 +1,156 @@
+#include <hash.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace hash {
+
+namespace {
+
+constexpr U64 Prime1 = 0x9E3779B185EBCA87ULL;
+constexpr U64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr U64 Prime3 = 0x165667B19E3779F9ULL;
+constexpr U64 Prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr U64 Prime5 = 0x27D4EB2F165667C5ULL;
+
+U64 Read64(const U8* p)
+{
+    U64 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+U32 Read32(const U8* p)
+{
+    U32 value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+U64 Round(U64 acc, U64 input)
+{
+    acc += input * Prime2;
+    acc = std::rotl(acc, 31);
+    return acc * Prime1;
+}
+
+U64 MergeRound(U64 acc, U64 value)
+{
+    acc ^= Round(0, value);
+    return acc * Prime1 + Prime4;
+}
+
+constexpr std::array<U32, 256> MakeCrcTable()
+{
+    std::array<U32, 256> table{};
+    for (U32 i = 0; i < 256; ++i)
+    {
+        U32 c = i;
+        for (S32 bit = 0; bit < 8; ++bit)
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[i] = c;
+    }
+    return table;
+}
+
+constexpr auto CrcTable = MakeCrcTable();
+
+} // namespace
+
+Xxh64::Xxh64(U64 seed)
+    : m_Acc{seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1}
+    , m_Seed{seed}
+{
+}
+
+void Xxh64::Update(const void* data, Size size)
+{
+    const U8* p = static_cast<const U8*>(data);
+    const U8* const end = p + size;
+    m_TotalSize += size;
+
+    // Top up a partial stripe first
+    if (m_Buffered > 0)
+    {
+        const Size take = std::min(size, m_Buffer.size() - m_Buffered);
+        std::memcpy(m_Buffer.data() + m_Buffered, p, take);
+        m_Buffered += take;
+        p += take;
+        if (m_Buffered < m_Buffer.size())
+            return;
+        for (Size lane = 0; lane < 4; ++lane)
+            m_Acc[lane] = Round(m_Acc[lane], Read64(m_Buffer.data() + lane * 8));
+        m_Buffered = 0;
+    }
+
+    for (; end - p >= 32; p += 32)
+    {
+        m_Acc[0] = Round(m_Acc[0], Read64(p));
+        m_Acc[1] = Round(m_Acc[1], Read64(p + 8));
+        m_Acc[2] = Round(m_Acc[2], Read64(p + 16));
+        m_Acc[3] = Round(m_Acc[3], Read64(p + 24));
+    }
+
+    m_Buffered = static_cast<Size>(end - p);
+    std::memcpy(m_Buffer.data(), p, m_Buffered);
+}
+
+U64 Xxh64::Digest() const
+{
+    U64 h;
+    if (m_TotalSize >= 32)
+    {
+        h = std::rotl(m_Acc[0], 1) + std::rotl(m_Acc[1], 7) + std::rotl(m_Acc[2], 12) + std::rotl(m_Acc[3], 18);
+        for (U64 acc : m_Acc)
+            h = MergeRound(h, acc);
+    }
+    else
+    {
+        h = m_Seed + Prime5;
+    }
+    h += m_TotalSize;
+
+    const U8* p = m_Buffer.data();
+    const U8* const end = p + m_Buffered;
+    for (; end - p >= 8; p += 8)
+    {
+        h ^= Round(0, Read64(p));
+        h = std::rotl(h, 27) * Prime1 + Prime4;
+    }
+    if (end - p >= 4)
+    {
+        h ^= static_cast<U64>(Read32(p)) * Prime1;
+        h = std::rotl(h, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        h ^= *p * Prime5;
+        h = std::rotl(h, 11) * Prime1;
+    }
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+U64 Xxh64Of(const void* data, Size size, U64 seed)
+{
+    Xxh64 hasher{seed};
+    hasher.Update(data, size);
+    return hasher.Digest();
+}
+
+U32 Crc32(const void* data, Size size, U32 crc)
+{
+    const U8* p = static_cast<const U8*>(data);
+    U32 c = ~crc;
+    for (Size i = 0; i < size; ++i)
+        c = CrcTable[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    return ~c;
+}
+
+} // namespace hash
@@ -0,0 +1,222 @@
+#include <instrument.hpp>
+
+#ifdef PHOSPHOR_INSTRUMENT
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PHOSPHOR_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PHOSPHOR_RDTSC 1
+#endif
+
+namespace instrument {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr Size ZoneCount = static_cast<Size>(Zone::Count);
+constexpr Size HistorySize = 128;
+constexpr Size MaxEventsPerThread = Size{1} << 22;
+
+constexpr std::array<Track, ZoneCount> ZoneTracks = {
+    Track::Emulation, Track::Emulation, Track::Emulation,
+    Track::Emulation, Track::Presentation, Track::Emulation, Track::Emulation
+};
+
+struct Event {
+    U64 Start;
+    U64 End;
+    Zone Kind;
+};
+
+struct ThreadTrace {
+    U32 Id{};
+    std::string Name;
+    std::vector<Event> Events;
+};
+
+struct Anchor {
+    U64 Ticks;
+    Clock::time_point Time;
+};
+
+std::atomic<bool> g_Enabled{false};
+std::atomic<bool> g_Tracing{false};
+std::array<std::atomic<U64>, ZoneCount> g_FrameTicks{};
+std::array<std::array<std::atomic<U64>, HistorySize>, ZoneCount> g_History{};
+std::array<std::atomic<U32>, 2> g_Frames{};
+
+std::mutex g_TraceMutex;
+std::vector<std::unique_ptr<ThreadTrace>> g_Threads;
+thread_local ThreadTrace* t_Trace = nullptr;
+
+const Anchor g_Anchor{Now(), Clock::now()};
+
+ThreadTrace& LocalTrace()
+{
+    if (!t_Trace)
+    {
+        std::lock_guard lock{g_TraceMutex};
+        auto& trace = g_Threads.emplace_back(std::make_unique<ThreadTrace>());
+        trace->Id = static_cast<U32>(g_Threads.size());
+        t_Trace = trace.get();
+    }
+    return *t_Trace;
+}
+
+// Host tick rate, calibrated against steady_clock since startup
+double TicksPerSecond()
+{
+#ifdef PHOSPHOR_RDTSC
+    const double seconds = std::chrono::duration<double>(Clock::now() - g_Anchor.Time).count();
+    if (seconds < 0.01)
+        return 1e9;  // Too early to tell; rough guess for the first frames
+    return static_cast<double>(Now() - g_Anchor.Ticks) / seconds;
+#else
+    return 1e9;
+#endif
+}
+
+} // namespace
+
+U64 Now()
+{
+#ifdef PHOSPHOR_RDTSC
+    return __rdtsc();
+#else
+    return static_cast<U64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count());
+#endif
+}
+
+void SetEnabled(bool enabled)
+{
+    g_Enabled.store(enabled || g_Tracing.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+bool Enabled()
+{
+    return g_Enabled.load(std::memory_order_relaxed);
+}
+
+void StartTrace()
+{
+    g_Tracing.store(true, std::memory_order_relaxed);
+    g_Enabled.store(true, std::memory_order_relaxed);
+}
+
+void SetThreadName(std::string_view name)
+{
+    LocalTrace().Name = name;
+}
+
+void Record(Zone zone, U64 start, U64 end)
+{
+    const auto index = static_cast<Size>(zone);
+    g_FrameTicks[index].fetch_add(end - start, std::memory_order_relaxed);
+
+    if (g_Tracing.load(std::memory_order_relaxed))
+    {
+        auto& trace = LocalTrace();
+        if (trace.Events.size() < MaxEventsPerThread)
+            trace.Events.push_back({start, end, zone});
+    }
+}
+
+void EndFrame(Track track)
+{
+    auto& frames = g_Frames[static_cast<Size>(track)];
+    const U32 frame = frames.load(std::memory_order_relaxed);
+    const Size slot = frame % HistorySize;
+
+    std::array<U64, ZoneCount> ticks{};
+    for (Size zone = 0; zone < ZoneCount; ++zone)
+    {
+        if (ZoneTracks[zone] != track || static_cast<Zone>(zone) == Zone::Cpu)
+            continue;
+        ticks[zone] = g_FrameTicks[zone].exchange(0, std::memory_order_relaxed);
+        g_History[zone][slot].store(ticks[zone], std::memory_order_relaxed);
+    }
+
+    if (track == Track::Emulation)
+    {
+        const U64 emulate = ticks[static_cast<Size>(Zone::Emulate)];
+        const U64 nested = ticks[static_cast<Size>(Zone::Render)] + ticks[static_cast<Size>(Zone::Synthesis)];
+        g_History[static_cast<Size>(Zone::Cpu)][slot].store(emulate > nested ? emulate - nested : 0, std::memory_order_relaxed);
+    }
+
+    frames.store(frame + 1, std::memory_order_release);
+}
+
+ZoneStats Stats(Zone zone)
+{
+    const auto index = static_cast<Size>(zone);
+    const U32 frames = g_Frames[static_cast<Size>(ZoneTracks[index])].load(std::memory_order_acquire);
+    const Size count = std::min<Size>(frames, HistorySize);
+    if (count == 0)
+        return {};
+
+    std::array<U64, HistorySize> values{};
+    for (Size i = 0; i < count; ++i)
+        values[i] = g_History[index][i].load(std::memory_order_relaxed);
+    std::sort(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(count));
+
+    U64 sum = 0;
+    for (Size i = 0; i < count; ++i)
+        sum += values[i];
+
+    const double msPerTick = 1000.0 / TicksPerSecond();
+    return {
+        static_cast<double>(values[0]) * msPerTick,
+        static_cast<double>(sum) / static_cast<double>(count) * msPerTick,
+        static_cast<double>(values[std::min(count - 1, count * 99 / 100)]) * msPerTick,
+    };
+}
+
+bool WriteChromeTrace(const std::filesystem::path& path)
+{
+    std::ofstream out{path};
+    if (!out) return false;
+
+    const double usPerTick = 1e6 / TicksPerSecond();
+    auto micros = [&](U64 ticks) { return static_cast<double>(ticks - g_Anchor.Ticks) * usPerTick; };
+
+    std::lock_guard lock{g_TraceMutex};
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    auto separator = [&] { out << (first ? "" : ",\n"); first = false; };
+
+    for (const auto& trace : g_Threads)
+    {
+        if (!trace->Name.empty())
+        {
+            separator();
+            out << std::format(R"({{"name": "thread_name", "ph": "M", "pid": 1, "tid": {}, "args": {{"name": "{}"}}}})",
+                trace->Id, trace->Name);
+        }
+        for (const auto& event : trace->Events)
+        {
+            separator();
+            out << std::format(R"({{"name": "{}", "ph": "X", "pid": 1, "tid": {}, "ts": {:.3f}, "dur": {:.3f}}})",
+                ZoneName(event.Kind), trace->Id, micros(event.Start), static_cast<double>(event.End - event.Start) * usPerTick);
+        }
+    }
+    out << "\n]}\n";
+    return out.good();
+}
+
+} // namespace instrument
+
+#endif
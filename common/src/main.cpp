@@ -4,9 +4,17 @@
 #include <filesystem>
 #include <string>
 #include <algorithm>
+#include <charconv>
 
 #include <rom_selector.hpp>
 #include <gb_run.hpp>
+#include <gb_bench.hpp>
+#include <gb_tests.hpp>
+#include <gb_trace.hpp>
+#include <gb_link.hpp>
+#include <gb_movie.hpp>
+#include <gb_netplay.hpp>
+#include <gb_bus.hpp>
 
 static bool IsGameBoyRom(const std::string& ext)
 {
@@ -35,6 +43,62 @@ static std::filesystem::path SystemRomDir(EmuSystem system)
     return "roms";
 }
 
+// Parses a whole argument as a positive number, reporting bad values
+template<typename T>
+static bool ParseCount(std::string_view value, T& out)
+{
+    T parsed{};
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+    if (ec != std::errc{} || ptr != value.data() + value.size() || parsed <= T{})
+    {
+        std::println(stderr, "Invalid number: {}", value);
+        return false;
+    }
+    out = parsed;
+    return true;
+}
+
+// Hex address with an optional 0x or $ prefix
+static bool ParseAddress(std::string_view value, U16& out)
+{
+    if (value.starts_with("0x") || value.starts_with("0X"))
+        value.remove_prefix(2);
+    else if (value.starts_with('$'))
+        value.remove_prefix(1);
+
+    auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), out, 16);
+    if (value.empty() || ec != std::errc{} || ptr != value.data() + value.size())
+    {
+        std::println(stderr, "Invalid address: {}", value);
+        return false;
+    }
+    return true;
+}
+
+// ADDR[:r|w|rw], watching writes by default
+static bool ParseWatch(std::string_view value, gb::Watchpoint& out)
+{
+    std::string_view mode = "w";
+    if (const auto colon = value.find(':'); colon != std::string_view::npos)
+    {
+        mode = value.substr(colon + 1);
+        value = value.substr(0, colon);
+    }
+
+    if (mode == "r")
+        out.Flags = gb::Bus::WatchRead;
+    else if (mode == "w")
+        out.Flags = gb::Bus::WatchWrite;
+    else if (mode == "rw")
+        out.Flags = gb::Bus::WatchRead | gb::Bus::WatchWrite;
+    else
+    {
+        std::println(stderr, "Invalid watch mode: {} (use r, w or rw)", mode);
+        return false;
+    }
+    return ParseAddress(value, out.Address);
+}
+
 static bool IsProjectRoot(const std::filesystem::path& dir)
 {
     return std::filesystem::is_directory(dir / "roms")
@@ -65,30 +129,195 @@ static std::filesystem::path FindProjectRoot()
 
 int main(int argc, char* argv[])
 {
-    std::println("Phosphor v0.2.0");
-    std::println("==================\n");
-
-    bool startFullscreen = false;
+    gb::RunOptions run;
     bool runTests = false;
+    bool runBench = false;
+    bool runNetplayTest = false;
+    gb::NetplayTestOptions netplayTest;
+    bool runLinkTest = false;
+    std::string linkPeerRom;
+    gb::LinkTestOptions linkTest;
+    gb::BenchOptions bench;
+    gb::TestOptions tests;
+    gb::ScreenshotOptions screenshots;
     std::string argPath;
+    bool headless = false;
+    std::string traceDiffA;
+    std::string traceDiffB;
     for (S32 i = 1; i < argc; i++)
     {
         std::string arg = argv[i];
         if (arg == "--fullscreen" || arg == "-f")
-            startFullscreen = true;
+            run.Fullscreen = true;
+        else if (arg == "--chrome-trace" && i + 1 < argc)
+            run.ChromeTracePath = argv[++i];
+        else if (arg == "--trace" && i + 1 < argc)
+            run.TracePath = argv[++i];
+        else if (arg == "--trace-diff" && i + 2 < argc)
+        {
+            traceDiffA = argv[++i];
+            traceDiffB = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc)
+            run.RecordMoviePath = argv[++i];
+        else if (arg == "--play" && i + 1 < argc)
+            run.PlayMoviePath = argv[++i];
+        else if (arg == "--headless")
+            headless = true;
+        else if (arg == "--rtc" && i + 1 < argc)
+        {
+            const std::string_view mode = argv[++i];
+            if (mode == "wall")
+                run.Rtc = gb::RtcMode::WallClock;
+            else if (mode == "emulated")
+                run.Rtc = gb::RtcMode::Emulated;
+            else
+            {
+                std::println(stderr, "Invalid RTC mode: {} (use emulated or wall)", mode);
+                return 1;
+            }
+        }
+        else if (arg == "--rtc-epoch" && i + 1 < argc)
+        {
+            S64 epoch = 0;
+            if (!ParseCount(argv[++i], epoch)) return 1;
+            run.RtcEpoch = epoch;
+        }
+        else if (arg == "--mmap-save")
+            run.MapSaveFile = true;
+        else if (arg == "--netplay" && i + 2 < argc)
+        {
+            if (!ParseCount(argv[++i], run.NetplayPort)) return 1;
+            run.NetplayPeer = argv[++i];
+        }
+        else if (arg == "--input-delay" && i + 1 < argc)
+        {
+            // Zero is a valid delay, so ParseCount does not fit
+            const std::string_view value = argv[++i];
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), run.Netplay.InputDelay);
+            if (ec != std::errc{} || ptr != value.data() + value.size())
+            {
+                std::println(stderr, "Invalid number: {}", value);
+                return 1;
+            }
+            netplayTest.Session.InputDelay = run.Netplay.InputDelay;
+        }
+        else if (arg == "--rollback" && i + 1 < argc)
+        {
+            if (!ParseCount(argv[++i], run.Netplay.MaxRollback)) return 1;
+            netplayTest.Session.MaxRollback = run.Netplay.MaxRollback;
+        }
+        else if (arg == "--netplay-test")
+            runNetplayTest = true;
+        else if (arg == "--link-test")
+            runLinkTest = true;
+        else if (arg == "--link-with" && i + 1 < argc)
+            linkPeerRom = argv[++i];
+        else if (arg == "--link-skew" && i + 1 < argc)
+        {
+            if (!ParseCount(argv[++i], linkTest.Link.MaxSkew)) return 1;
+        }
+        else if (arg == "--break" && i + 1 < argc)
+        {
+            if (!ParseAddress(argv[++i], run.Breakpoints.emplace_back())) return 1;
+        }
+        else if (arg == "--watch" && i + 1 < argc)
+        {
+            if (!ParseWatch(argv[++i], run.Watches.emplace_back())) return 1;
+        }
         else if (arg == "--test")
             runTests = true;
+        else if (arg == "--bench")
+            runBench = true;
+        else if (arg == "--json")
+            bench.Json = true;
+        else if (arg == "--frames" && i + 1 < argc)
+        {
+            if (!ParseCount(argv[++i], bench.Frames)) return 1;
+            netplayTest.Frames = bench.Frames;
+            linkTest.Frames = bench.Frames;
+        }
+        else if (arg == "--screenshots" && i + 1 < argc)
+            screenshots.ManifestPath = argv[++i];
+        else if (arg == "--update")
+            screenshots.Update = true;
+        else if (arg == "--filter" && i + 1 < argc)
+            tests.Filter = argv[++i];
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            if (!ParseCount(argv[++i], tests.Jobs)) return 1;
+            screenshots.Jobs = tests.Jobs;
+        }
+        else if (arg == "--timeout" && i + 1 < argc)
+        {
+            if (!ParseCount(argv[++i], tests.TimeoutSeconds)) return 1;
+        }
         else
             argPath = arg;
     }
 
+    // Keep stdout machine-readable in JSON mode
+    if (!(runBench && bench.Json))
+    {
+        std::println("Phosphor v0.2.0");
+        std::println("==================\n");
+    }
+
+    if (!traceDiffA.empty())
+        return gb::DiffTraces(traceDiffA, traceDiffB);
+
+    if (headless)
+    {
+        if (run.PlayMoviePath.empty() || argPath.empty())
+        {
+            std::println(stderr, "--headless needs --play MOVIE and a ROM");
+            return 1;
+        }
+        return gb::ReplayMovie(argPath, run.PlayMoviePath);
+    }
+
+    if (runNetplayTest)
+    {
+        if (argPath.empty())
+        {
+            std::println(stderr, "--netplay-test needs a ROM");
+            return 1;
+        }
+        return gb::RunNetplaySelfTest(argPath, netplayTest);
+    }
+
+    if (runLinkTest)
+    {
+        if (argPath.empty())
+        {
+            std::println(stderr, "--link-test needs a ROM");
+            return 1;
+        }
+        return gb::RunLinkSelfTest(argPath, linkPeerRom.empty() ? argPath : linkPeerRom, linkTest);
+    }
+
+    if (runBench)
+    {
+        bench.TestRomsDir = argPath.empty()
+            ? (FindProjectRoot() / "test-roms/gameboy").string()
+            : argPath;
+        return gb::RunBenchmarks(bench);
+    }
+
+    if (!screenshots.ManifestPath.empty())
+    {
+        screenshots.TestRomsDir = argPath.empty()
+            ? (FindProjectRoot() / "test-roms/gameboy").string()
+            : argPath;
+        return gb::RunScreenshotTests(screenshots);
+    }
+
     if (runTests)
     {
-        auto testDir = argPath.empty()
+        tests.TestRomsDir = argPath.empty()
             ? (FindProjectRoot() / "test-roms/gameboy").string()
             : argPath;
-        gb::RunTests(testDir);
-        return 0;
+        return gb::RunTests(tests);
     }
 
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER) < 0)
@@ -104,7 +333,7 @@ int main(int argc, char* argv[])
 
         S32 result;
         if (IsGameBoyRom(ext))
-            result = gb::Run(argPath, startFullscreen);
+            result = gb::Run(argPath, run);
         else
         {
             std::println(stderr, "Unsupported file: {}", argPath);
@@ -122,7 +351,7 @@ int main(int argc, char* argv[])
     SDL_Renderer* r = SDL_CreateRenderer(w, -1,
         SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
-    if (startFullscreen) SDL_SetWindowFullscreen(w, SDL_WINDOW_FULLSCREEN_DESKTOP);
+    if (run.Fullscreen) SDL_SetWindowFullscreen(w, SDL_WINDOW_FULLSCREEN_DESKTOP);
 
     S32 result = 0;
     bool launched = false;
@@ -149,7 +378,7 @@ int main(int argc, char* argv[])
         switch (*system)
         {
         case EmuSystem::GameBoy:
-            result = gb::Run(selected->string(), startFullscreen);
+            result = gb::Run(selected->string(), run);
             break;
         default:
             std::println(stderr, "System not yet implemented");
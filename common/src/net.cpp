@@ -0,0 +1,223 @@
+#include <net.hpp>
+#include <format>
+#include <utility>
+
+namespace net {
+
+Loopback::Loopback(U32 latency, U32 dropEvery)
+    : m_Latency{latency}
+    , m_DropEvery{dropEvery}
+{
+}
+
+void Loopback::Tick()
+{
+    std::scoped_lock lock{m_Mutex};
+    ++m_Tick;
+}
+
+void Loopback::Endpoint::Send(std::span<const U8> packet)
+{
+    std::scoped_lock lock{m_Owner.m_Mutex};
+    ++m_Owner.m_Sent;
+    if (m_Owner.m_DropEvery != 0 && m_Owner.m_Sent % m_Owner.m_DropEvery == 0)
+        return;
+    m_Owner.m_Inboxes[1 - m_Index].push_back({m_Owner.m_Tick + m_Owner.m_Latency, {packet.begin(), packet.end()}});
+}
+
+std::optional<std::vector<U8>> Loopback::Endpoint::Receive()
+{
+    std::scoped_lock lock{m_Owner.m_Mutex};
+    auto& inbox = m_Owner.m_Inboxes[m_Index];
+    if (inbox.empty() || inbox.front().ArrivalTick > m_Owner.m_Tick)
+        return std::nullopt;
+    auto packet = std::move(inbox.front().Data);
+    inbox.pop_front();
+    return packet;
+}
+
+} // namespace net
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+namespace net {
+
+namespace {
+    std::string LastError()
+    {
+        return std::format("error {}", WSAGetLastError());
+    }
+
+    // Winsock stays initialized for the life of the process
+    bool StartWinsock()
+    {
+        static const bool started = [] {
+            WSADATA data{};
+            return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+        }();
+        return started;
+    }
+}
+
+std::expected<std::unique_ptr<UdpTransport>, std::string> UdpTransport::Open(U16 localPort, std::string_view peerHost, U16 peerPort)
+{
+    if (!StartWinsock())
+        return std::unexpected("Winsock failed to start");
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* peer = nullptr;
+    const std::string host{peerHost};
+    if (getaddrinfo(host.c_str(), std::to_string(peerPort).c_str(), &hints, &peer) != 0 || !peer)
+        return std::unexpected(std::format("Cannot resolve {}", peerHost));
+
+    std::unique_ptr<UdpTransport> transport{new UdpTransport};
+    const SOCKET sock = socket(peer->ai_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock == INVALID_SOCKET)
+    {
+        freeaddrinfo(peer);
+        return std::unexpected(std::format("Cannot create socket: {}", LastError()));
+    }
+    transport->m_Socket = sock;
+
+    sockaddr_storage local{};
+    int localSize = 0;
+    if (peer->ai_family == AF_INET6)
+    {
+        auto& address = reinterpret_cast<sockaddr_in6&>(local);
+        address.sin6_family = AF_INET6;
+        address.sin6_port = htons(localPort);
+        localSize = sizeof(address);
+    }
+    else
+    {
+        auto& address = reinterpret_cast<sockaddr_in&>(local);
+        address.sin_family = AF_INET;
+        address.sin_port = htons(localPort);
+        localSize = sizeof(address);
+    }
+
+    u_long nonBlocking = 1;
+    const bool ready = bind(sock, reinterpret_cast<sockaddr*>(&local), localSize) == 0
+        && connect(sock, peer->ai_addr, static_cast<int>(peer->ai_addrlen)) == 0
+        && ioctlsocket(sock, FIONBIO, &nonBlocking) == 0;
+    freeaddrinfo(peer);
+    if (!ready)
+        return std::unexpected(std::format("Cannot open UDP port {}: {}", localPort, LastError()));
+    return transport;
+}
+
+UdpTransport::~UdpTransport()
+{
+    if (m_Socket != ~0ull)
+        closesocket(static_cast<SOCKET>(m_Socket));
+}
+
+void UdpTransport::Send(std::span<const U8> packet)
+{
+    // Losing a datagram is normal; the protocol resends
+    send(static_cast<SOCKET>(m_Socket), reinterpret_cast<const char*>(packet.data()), static_cast<int>(packet.size()), 0);
+}
+
+std::optional<std::vector<U8>> UdpTransport::Receive()
+{
+    std::vector<U8> packet(MaxPacketSize);
+    const int received = recv(static_cast<SOCKET>(m_Socket), reinterpret_cast<char*>(packet.data()), static_cast<int>(packet.size()), 0);
+    // WSAECONNRESET reports an earlier send the peer refused; nothing to read
+    if (received < 0)
+        return std::nullopt;
+    packet.resize(static_cast<Size>(received));
+    return packet;
+}
+
+} // namespace net
+
+#else
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace net {
+
+std::expected<std::unique_ptr<UdpTransport>, std::string> UdpTransport::Open(U16 localPort, std::string_view peerHost, U16 peerPort)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* peer = nullptr;
+    const std::string host{peerHost};
+    if (getaddrinfo(host.c_str(), std::to_string(peerPort).c_str(), &hints, &peer) != 0 || !peer)
+        return std::unexpected(std::format("Cannot resolve {}", peerHost));
+
+    std::unique_ptr<UdpTransport> transport{new UdpTransport};
+    transport->m_Socket = socket(peer->ai_family, SOCK_DGRAM, IPPROTO_UDP);
+    if (transport->m_Socket < 0)
+    {
+        freeaddrinfo(peer);
+        return std::unexpected(std::format("Cannot create socket: {}", std::strerror(errno)));
+    }
+
+    sockaddr_storage local{};
+    socklen_t localSize = 0;
+    if (peer->ai_family == AF_INET6)
+    {
+        auto& address = reinterpret_cast<sockaddr_in6&>(local);
+        address.sin6_family = AF_INET6;
+        address.sin6_port = htons(localPort);
+        localSize = sizeof(address);
+    }
+    else
+    {
+        auto& address = reinterpret_cast<sockaddr_in&>(local);
+        address.sin_family = AF_INET;
+        address.sin_port = htons(localPort);
+        localSize = sizeof(address);
+    }
+
+    const int sock = transport->m_Socket;
+    const bool ready = bind(sock, reinterpret_cast<sockaddr*>(&local), localSize) == 0
+        && connect(sock, peer->ai_addr, peer->ai_addrlen) == 0
+        && fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) == 0;
+    freeaddrinfo(peer);
+    if (!ready)
+        return std::unexpected(std::format("Cannot open UDP port {}: {}", localPort, std::strerror(errno)));
+    return transport;
+}
+
+UdpTransport::~UdpTransport()
+{
+    if (m_Socket >= 0)
+        close(m_Socket);
+}
+
+void UdpTransport::Send(std::span<const U8> packet)
+{
+    // Losing a datagram is normal; the protocol resends
+    (void)send(m_Socket, packet.data(), packet.size(), 0);
+}
+
+std::optional<std::vector<U8>> UdpTransport::Receive()
+{
+    std::vector<U8> packet(MaxPacketSize);
+    // ECONNREFUSED reports an earlier send the peer refused; nothing to read
+    const ssize_t received = recv(m_Socket, packet.data(), packet.size(), 0);
+    if (received < 0)
+        return std::nullopt;
+    packet.resize(static_cast<Size>(received));
+    return packet;
+}
+
+} // namespace net
+
+#endif
@@ -0,0 +1,44 @@
+#include <overlay.hpp>
+#include <font.hpp>
+
+namespace overlay {
+
+namespace {
+
+constexpr U32 ShadowColor = 0xFF000000;
+
+void DrawChar(std::span<U32> pixels, S32 width, S32 height, S32 x, S32 y, char ch, U32 color)
+{
+    if (ch < font::FirstChar || ch >= font::LastChar) return;
+    const auto& glyph = font::Glyphs[ch - font::FirstChar];
+
+    for (S32 row = 0; row < font::CharHeight; row++)
+    {
+        const S32 py = y + row;
+        if (py < 0 || py >= height) continue;
+
+        const U8 bits = glyph[row];
+        for (S32 col = 0; col < font::CharWidth; col++)
+        {
+            const S32 px = x + col;
+            if (px < 0 || px >= width) continue;
+            if (bits & (0x80 >> col))
+                pixels[static_cast<Size>(py * width + px)] = color;
+        }
+    }
+}
+
+} // namespace
+
+void DrawText(std::span<U32> pixels, S32 width, S32 height, S32 x, S32 y, std::string_view text, U32 color)
+{
+    S32 cx = x;
+    for (const char ch : text)
+    {
+        DrawChar(pixels, width, height, cx + 1, y + 1, ch, ShadowColor);
+        DrawChar(pixels, width, height, cx, y, ch, color);
+        cx += CharAdvance;
+    }
+}
+
+} // namespace overlay
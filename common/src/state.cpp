@@ -0,0 +1,167 @@
+#include <state.hpp>
+#include <algorithm>
+#include <format>
+#include <istream>
+#include <ostream>
+
+#include <compress.hpp>
+#include <hash.hpp>
+#include <parallel.hpp>
+
+namespace state {
+
+namespace {
+
+constexpr U16 Compressed = 0x0001;
+
+// Smaller sections aren't worth a compression attempt
+constexpr Size CompressMinSize = 256;
+
+// Below this total, threads cost more than they save
+constexpr Size ParallelMinSize = 256 * 1024;
+
+struct TableEntry {
+    U32 Id;
+    U16 Version;
+    U16 Flags;
+    U32 Offset;
+    U32 StoredSize;
+    U32 RawSize;
+    U32 Crc;
+};
+static_assert(sizeof(TableEntry) == 24);
+
+std::string IdName(U32 id)
+{
+    std::string name;
+    for (S32 shift = 0; shift < 32; shift += 8)
+        name.push_back(static_cast<char>((id >> shift) & 0xFF));
+    return name;
+}
+
+} // namespace
+
+bool WriteSections(std::ostream& out, std::span<const Section> sections)
+{
+    std::vector<TableEntry> table(sections.size());
+    std::vector<std::vector<U8>> packed(sections.size());
+
+    Size total = 0;
+    for (const auto& section : sections)
+        total += section.Data.size();
+
+    ParallelFor(sections.size(), total >= ParallelMinSize ? 0 : 1, [&](Size i) {
+        const auto& data = sections[i].Data;
+        auto& entry = table[i];
+        entry.Id = sections[i].Id;
+        entry.Version = sections[i].Version;
+        entry.Flags = 0;
+        entry.RawSize = static_cast<U32>(data.size());
+        entry.Crc = hash::Crc32(data.data(), data.size());
+
+        if (data.size() >= CompressMinSize)
+        {
+            auto compressed = compress::Compress(data);
+            if (compressed.size() < data.size())
+            {
+                packed[i] = std::move(compressed);
+                entry.Flags |= Compressed;
+            }
+        }
+        entry.StoredSize = static_cast<U32>(entry.Flags & Compressed ? packed[i].size() : data.size());
+    });
+
+    U32 offset = static_cast<U32>(sizeof(Magic) + sizeof(Version) + sizeof(U32) + table.size() * sizeof(TableEntry));
+    for (auto& entry : table)
+    {
+        entry.Offset = offset;
+        offset += entry.StoredSize;
+    }
+
+    Write(out, Magic);
+    Write(out, Version);
+    Write(out, static_cast<U32>(table.size()));
+    out.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(TableEntry)));
+    for (Size i = 0; i < sections.size(); ++i)
+    {
+        const auto& payload = table[i].Flags & Compressed ? packed[i] : sections[i].Data;
+        out.write(reinterpret_cast<const char*>(payload.data()), static_cast<std::streamsize>(payload.size()));
+    }
+    return out.good();
+}
+
+std::expected<std::vector<Section>, std::string> ReadSections(std::istream& in, std::span<const U32> wanted)
+{
+    // Offsets are relative to the start of the state, just before Magic
+    const auto base = in.tellg() - static_cast<std::streamoff>(sizeof(Magic) + sizeof(Version));
+
+    U32 count = 0;
+    Read(in, count);
+    if (!in || count > 1024)
+        return std::unexpected(std::string{"Corrupt save state table"});
+
+    std::vector<TableEntry> table(count);
+    in.read(reinterpret_cast<char*>(table.data()), static_cast<std::streamsize>(count * sizeof(TableEntry)));
+    if (!in)
+        return std::unexpected(std::string{"Truncated save state table"});
+
+    std::erase_if(table, [&](const TableEntry& entry) {
+        return !wanted.empty() && std::ranges::find(wanted, entry.Id) == wanted.end();
+    });
+
+    // Sizes come from the file; check them before allocating anything
+    in.seekg(0, std::ios::end);
+    const auto end = in.tellg();
+    for (const auto& entry : table)
+    {
+        const bool sized = entry.RawSize <= MaxRawSize
+            && ((entry.Flags & Compressed) || entry.StoredSize == entry.RawSize);
+        if (!sized)
+            return std::unexpected(std::format("Save state section {} is corrupt", IdName(entry.Id)));
+        if (!in || base + static_cast<std::streamoff>(entry.Offset) + static_cast<std::streamoff>(entry.StoredSize) > end)
+            return std::unexpected(std::format("Truncated save state section {}", IdName(entry.Id)));
+    }
+
+    // Payloads are read in table order, then unpacked and checked
+    std::vector<std::vector<U8>> stored(table.size());
+    Size total = 0;
+    for (Size i = 0; i < table.size(); ++i)
+    {
+        stored[i].resize(table[i].StoredSize);
+        in.seekg(base + static_cast<std::streamoff>(table[i].Offset));
+        in.read(reinterpret_cast<char*>(stored[i].data()), table[i].StoredSize);
+        if (!in)
+            return std::unexpected(std::format("Truncated save state section {}", IdName(table[i].Id)));
+        total += table[i].RawSize;
+    }
+
+    std::vector<Section> sections(table.size());
+    std::vector<U8> valid(table.size(), 0);
+    ParallelFor(table.size(), total >= ParallelMinSize ? 0 : 1, [&](Size i) {
+        const auto& entry = table[i];
+        auto& section = sections[i];
+        section.Id = entry.Id;
+        section.Version = entry.Version;
+        if (entry.Flags & Compressed)
+        {
+            section.Data.resize(entry.RawSize);
+            if (!compress::Decompress(stored[i], section.Data))
+                return;
+        }
+        else
+        {
+            section.Data = std::move(stored[i]);
+        }
+        valid[i] = section.Data.size() == entry.RawSize
+            && hash::Crc32(section.Data.data(), section.Data.size()) == entry.Crc;
+    });
+
+    for (Size i = 0; i < table.size(); ++i)
+    {
+        if (!valid[i])
+            return std::unexpected(std::format("Save state section {} is corrupt", IdName(table[i].Id)));
+    }
+    return sections;
+}
+
+} // namespace state
@@ -1,41 +1,143 @@
 #pragma once
 
+#include <iosfwd>
+#include <span>
 #include <string_view>
+#include <vector>
+#include <state.hpp>
 #include <gb_cartridge.hpp>
 #include <gb_timer.hpp>
 #include <gb_ppu.hpp>
 #include <gb_apu.hpp>
 #include <gb_bus.hpp>
 #include <gb_cpu.hpp>
+#include <gb_trace.hpp>
+#include <gb_debugger.hpp>
 
 namespace gb {
 
 class GameBoy {
 public:
+    // RunUntilFrame gives up after this many cycles without a finished frame
+    static constexpr U32 MaxFrameCycles = 1000000;
+
     explicit GameBoy(Cartridge&& cart);
 
+    // Runs one instruction (or one halted M-cycle); returns its cycles
     U32 Step();
 
+    // The run loops execute whole instructions, so they may overshoot by
+    // one; each stops early when the debugger stops and returns the cycles run.
+    // Runs until the PPU finishes a frame (capped for LCD-off programs)
+    U32 RunUntilFrame();
+    // Runs until at least `cycles` have passed
+    U64 RunCycles(U64 cycles);
+    // Runs until `done()`, checked before every instruction, returns true or
+    // `budget` cycles have passed. The loop is inlined into the caller, so
+    // the predicate costs no call per instruction.
+    template<typename Predicate>
+    U64 RunUntil(Predicate done, U64 budget = ~0ull);
+
     [[nodiscard]] const CPU& GetCPU() const { return m_CPU; }
     [[nodiscard]] const Bus& GetBus() const { return m_Bus; }
     [[nodiscard]] Bus& GetBus() { return m_Bus; }
+    [[nodiscard]] Cartridge& GetCartridge() { return m_Cartridge; }
     [[nodiscard]] const PPU& GetPPU() const { return m_PPU; }
     [[nodiscard]] APU& GetAPU() { return m_APU; }
-    [[nodiscard]] bool IsCgbMode() const { return m_CgbMode; }
+    [[nodiscard]] Model GetModel() const { return m_Model; }
+    [[nodiscard]] bool IsCgbMode() const { return m_Model == Model::Cgb; }
+    [[nodiscard]] U64 GetCycles() const { return m_Bus.GetCpuCycles(); }
+    [[nodiscard]] Debugger& GetDebugger() { return m_Debugger; }
+
+    // Records every executed instruction while set (not owned)
+    void SetTracer(TraceRecorder* tracer) { m_Tracer = tracer; }
 
     [[nodiscard]] bool FrameReady() { return m_PPU.FrameReady(); }
+    void SetRenderingEnabled(bool enabled) { m_PPU.SetRenderingEnabled(enabled); }
+#ifdef PHOSPHOR_PROFILE
+    [[nodiscard]] const Profiler& GetProfiler() const { return m_Profiler; }
+#endif
     void SaveRAM() const { m_Cartridge.SaveRAM(); }
     bool SaveState(std::string_view path) const;
     bool LoadState(std::string_view path);
+    bool SaveState(std::ostream& out) const;
+    bool LoadState(std::istream& in);
+    // The uncompressed sections SaveState() writes; cheap enough to take on
+    // the emulation thread and finish with state::WriteSections elsewhere.
+    // Extra sections appended to them are ignored by LoadState().
+    [[nodiscard]] std::vector<state::Section> CaptureState() const;
+    // Applies sections from CaptureState() or state::ReadSections without a
+    // stream round trip; rollback restores snapshots this way
+    bool RestoreState(std::span<const state::Section> sections);
+    // XXH64 over everything SaveState() keeps except output buffers; equal
+    // for identical states. RAM is rehashed only where it was written since
+    // the last call, so this costs a few microseconds per frame.
+    [[nodiscard]] U64 StateHash() const;
+
+    // The RTC runs on emulated time by default, starting from the host's
+    // current time: fast-forward and replays advance it consistently
+    void UseEmulatedRTC(S64 epoch) { m_Cartridge.UseEmulatedClock(m_Bus.GetMasterClock(), epoch); }
+    void UseWallClockRTC() { m_Cartridge.UseWallClock(); }
 
 private:
+    template<Model M> U32 StepAs();
+    template<Model M, typename Predicate> U64 RunAs(Predicate& done, U64 budget);
+    void TraceInstruction();
+    bool LoadLegacyState(std::istream& in);
+
     Cartridge m_Cartridge;
-    bool m_CgbMode;
+    Model m_Model;
+    // Advanced by the Bus, read by the components below
+    U64 m_MasterClock{0};
+    U64 m_CpuCycles{0};
     Timer m_Timer;
     PPU m_PPU;
     APU m_APU;
     Bus m_Bus;
     CPU m_CPU;
+    Debugger m_Debugger;
+    TraceRecorder* m_Tracer{};
+    // Payload size of each state section at its latest version; fixed once
+    // the cartridge is loaded, so RestoreState() checks against it
+    std::vector<Size> m_SectionSizes;
+#ifdef PHOSPHOR_PROFILE
+    Profiler m_Profiler;
+#endif
 };
 
+template<Model M>
+inline U32 GameBoy::StepAs()
+{
+    if (m_Debugger.Armed() && m_Debugger.BeforeInstruction(m_CPU.PC, m_CPU.IsHalted()))
+        return 0;
+
+    if (m_Tracer)
+        TraceInstruction();
+
+    const U64 start = m_Bus.GetCpuCycles();
+    m_CPU.Step<M>();
+    return static_cast<U32>(m_Bus.GetCpuCycles() - start);
+}
+
+template<Model M, typename Predicate>
+inline U64 GameBoy::RunAs(Predicate& done, U64 budget)
+{
+    const U64 start = m_Bus.GetCpuCycles();
+    while (m_Bus.GetCpuCycles() - start < budget && !done())
+    {
+        StepAs<M>();
+        if (m_Debugger.Stopped())
+            break;
+    }
+    // The APU runs behind the other components; bring its samples up to date
+    m_APU.Tick();
+    return m_Bus.GetCpuCycles() - start;
+}
+
+template<typename Predicate>
+U64 GameBoy::RunUntil(Predicate done, U64 budget)
+{
+    return m_Model == Model::Cgb ? RunAs<Model::Cgb>(done, budget) : RunAs<Model::Dmg>(done, budget);
+}
+
 } // namespace gb
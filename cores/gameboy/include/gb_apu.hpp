@@ -4,6 +4,7 @@
 #include <iosfwd>
 #include <optional>
 #include <types.hpp>
+#include <hash.hpp>
 
 namespace gb {
 
@@ -87,13 +88,20 @@ public:
     static constexpr S32 SampleRate = 44100;
     static constexpr S32 CPUFrequency = 4194304;
     static constexpr S32 FrameSequencerRate = 512;
-    static constexpr S32 CyclesPerSample = CPUFrequency / SampleRate;
     static constexpr S32 CyclesPerFrameSequencer = CPUFrequency / FrameSequencerRate;
     static constexpr Size AudioBufferSize = 2048;
 
-    APU();
+    // Sample timer runs in 16.16 fixed point so the resampling ratio can be
+    // nudged by fractions of a percent (dynamic rate control)
+    static constexpr S32 SampleTimerShift = 16;
+    static constexpr S32 SampleTimerStep = 1 << SampleTimerShift;
 
-    void Tick(U8 cycles);
+    // Reads the master clock; Tick catches up to it. The Bus calls it before
+    // APU register accesses and GameBoy at the end of each run, so the
+    // channels run in batches rather than every M-cycle.
+    explicit APU(const U64& clock);
+
+    void Tick();
 
     [[nodiscard]] std::optional<U8> Read(U16 address) const;
     bool Write(U16 address, U8 value);
@@ -103,7 +111,12 @@ public:
     void ClearBuffer() { m_SampleIndex = 0; }
     [[nodiscard]] bool BufferFull() const { return m_SampleIndex >= AudioBufferSize; }
 
+    // ratio > 1 produces more samples per emulated second, < 1 fewer
+    void SetResampleRatio(double ratio);
+
     void SaveState(std::ostream& out) const;
+    // SaveState fields; the output sample buffer is left out
+    void Hash(hash::Xxh64& hasher) const;
     void LoadState(std::istream& in);
 
 private:
@@ -111,6 +124,9 @@ private:
     void TickFrameSequencer();
     void GenerateSample();
     float MixChannels() const;
+    // The counters saved states hold, derived from the deadlines
+    [[nodiscard]] S32 FrameSequencerTimer() const;
+    [[nodiscard]] S32 SampleTimer() const;
 
     SquareChannel m_Channel1;  // Square with sweep
     SquareChannel m_Channel2;  // Square
@@ -121,9 +137,12 @@ private:
     U8 m_NR51{};  // 0xFF25: Sound panning
     U8 m_NR52{};  // 0xFF26: Sound on/off
 
-    S32 m_FrameSequencerTimer{};
+    const U64& m_Clock;
+    U64 m_Time;                 // Master cycle the APU has run up to
+    U64 m_NextFrameSequencer;   // Master cycle of the next frame sequencer step
+    U64 m_NextSample;           // 16.16 fixed point master cycle of the next sample
     S32 m_FrameSequencerStep{};
-    S32 m_SampleTimer{};
+    S32 m_SamplePeriod{};  // 16.16 fixed point, cycles per output sample
 
     std::array<float, AudioBufferSize> m_AudioBuffer{};
     Size m_SampleIndex{};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <types.hpp>
+
+namespace gb {
+
+class Cartridge;
+
+// Write-behind battery saves. Collect() runs on the emulation thread after
+// each frame and only copies RAM pages the game wrote since the last call;
+// a background thread writes the .sav (temp file + rename) once the game
+// has stopped writing for QuietPeriod, or after MaxDelay of steady writes.
+// With a mapped .sav nothing is copied: the writer msyncs it instead and
+// only writes the RTC footer file.
+class BatterySaver {
+public:
+    static constexpr std::chrono::milliseconds QuietPeriod{1000};
+    static constexpr std::chrono::milliseconds MaxDelay{10000};
+
+    explicit BatterySaver(Cartridge& cart);
+    ~BatterySaver();
+
+    BatterySaver(const BatterySaver&) = delete;
+    BatterySaver& operator=(const BatterySaver&) = delete;
+
+    void Collect();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void WriterLoop(std::stop_token stop);
+
+    Cartridge& m_Cartridge;
+    std::filesystem::path m_Path;
+    bool m_Mapped;
+
+    std::mutex m_Mutex;
+    std::condition_variable_any m_Wake;
+    std::vector<U8> m_Image;  // .sav contents as of the last Collect()
+    bool m_Dirty{false};
+    Clock::time_point m_FirstWrite;
+    Clock::time_point m_LastWrite;
+
+    std::jthread m_Writer;
+};
+
+} // namespace gb
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <types.hpp>
+
+namespace gb {
+
+struct BenchOptions {
+    std::string TestRomsDir;  // Blargg ROMs are skipped if not found here
+    U32 Frames{600};
+    bool Json{false};
+};
+
+// Runs fixed workloads (generated CPU/PPU/APU-bound ROMs plus the RunTests
+// ROMs) for a fixed number of frames and reports throughput. Results are
+// the fastest of several runs on a fresh GameBoy each time.
+S32 RunBenchmarks(const BenchOptions& options);
+
+} // namespace gb
@@ -2,11 +2,13 @@
 
 #include <array>
 #include <iosfwd>
-#include <string>
 
 #include <types.hpp>
+#include <hash.hpp>
+#include <stream_matcher.hpp>
 #include <gb_cartridge.hpp>
 #include <gb_joypad.hpp>
+#include <gb_model.hpp>
 
 namespace gb {
 
@@ -16,33 +18,85 @@ class APU;
 
 enum class TestResult { Running, Passed, Failed };
 
+// The other end of the link port, such as a second GameBoy (see LinkCable).
+// Transfers are timed on the master clock.
+class SerialLink {
+public:
+    virtual ~SerialLink() = default;
+
+    // This side's internal clock started shifting `out`; it finishes at `due`
+    virtual void BeginTransfer(U64 due, U8 out) = 0;
+    // The transfer from BeginTransfer finished; returns the byte shifted in
+    virtual U8 CompleteTransfer() = 0;
+    // The master clock reached the time given to Bus::SetLinkDue
+    virtual void Service() = 0;
+};
+
 class Bus {
 public:
-    Bus(Cartridge& cart, Timer& timer, PPU& ppu, APU& apu, bool cgbMode = false);
+    // Debugger watch flags, kept per 256-byte page
+    static constexpr U8 WatchRead = 0x01;
+    static constexpr U8 WatchWrite = 0x02;
+
+    Bus(Cartridge& cart, Timer& timer, PPU& ppu, APU& apu, U64& masterClock, U64& cpuCycles, bool cgbMode = false);
 
     Joypad& GetJoypad() { return m_Joypad; }
+    [[nodiscard]] const Cartridge& GetCartridge() const { return m_Cartridge; }
 
+    // The CPU uses the model-specialized accessors; these dispatch at runtime
+    [[nodiscard]] U8 Read(U16 address) const { return m_CgbMode ? Read<Model::Cgb>(address) : Read<Model::Dmg>(address); }
+    void Write(U16 address, U8 value) { m_CgbMode ? Write<Model::Cgb>(address, value) : Write<Model::Dmg>(address, value); }
+
+    template<Model M>
     [[nodiscard]] U8 Read(U16 address) const;
+    template<Model M>
     void Write(U16 address, U8 value);
 
+    [[nodiscard]] U8 WatchFlags(U16 address) const { return m_WatchPages[address >> 8]; }
+    void SetWatchPage(U8 page, U8 flags) { m_WatchPages[page] = flags; }
+
+    template<Model M>
     void Tick();  // Advance 1 M-cycle (4 T-cycles): ticks Timer, PPU, APU, handles interrupts
-    [[nodiscard]] U32 GetCycleCount() const { return m_CycleCount; }
-    void ResetCycleCount() { m_CycleCount = 0; }
+    // CPU T-cycles since power-on: twice the master rate in double speed
+    [[nodiscard]] U64 GetCpuCycles() const { return m_CpuCycles; }
+    void SetCpuCycles(U64 cycles) { m_CpuCycles = cycles; }  // Restoring a state
+    // 4 MiHz cycles since power-on, whatever the CPU speed; advanced here
+    // each M-cycle and read by every component that keeps time
+    [[nodiscard]] const U64& GetMasterClock() const { return m_MasterClock; }
+    void SetMasterClock(U64 clock) { m_MasterClock = clock; }  // Restoring a state
 
     [[nodiscard]] U8 ReadIF() const { return m_IoRegisters[0x0F]; }
     [[nodiscard]] U8 ReadIE() const { return m_InterruptEnable; }
     void SetIF(U8 value) { m_IoRegisters[0x0F] = value; }
 
     [[nodiscard]] TestResult GetTestResult() const { return m_TestResult; }
+    // First result wins; later reports (e.g. both markers) are ignored
+    void SetTestResult(TestResult result) { if (m_TestResult == TestResult::Running) m_TestResult = result; }
 
     [[nodiscard]] bool IsDoubleSpeed() const { return m_DoubleSpeed; }
     [[nodiscard]] bool IsSpeedSwitchArmed() const { return m_SpeedSwitch; }
     void PerformSpeedSwitch();
 
+    // Plugs a link into the serial port (not owned); null unplugs it, and
+    // transfers then read 0xFF. Link state is not part of save states.
+    void SetLink(SerialLink* link) { m_Link = link; m_LinkDue = NoLinkDue; }
+    // The link's Service() runs on the first M-cycle at or after `due`
+    void SetLinkDue(U64 due) { m_LinkDue = due; }
+    void ClearLinkDue() { m_LinkDue = NoLinkDue; }
+    // The peer's clock shifted `in` over: swaps it with SB if this side is
+    // waiting on the external clock, else leaves it alone and returns 0xFF
+    U8 ShiftExternal(U8 in);
+
     void SaveState(std::ostream& out) const;
+    // SaveState fields, work RAM through cached page hashes
+    void Hash(hash::Xxh64& hasher) const;
     void LoadState(std::istream& in);
 
 private:
+    static constexpr U64 NoLinkDue = ~0ull;
+    // Sound registers and wave RAM
+    static constexpr U16 ApuFirst = 0xFF10;
+    static constexpr U16 ApuLast = 0xFF3F;
 
     Cartridge& m_Cartridge;
     Timer& m_Timer;
@@ -50,11 +104,14 @@ private:
     APU& m_APU;
     Joypad m_Joypad;
     std::array<U8, 0x8000> m_WorkRam{};  // 32KB: 8 banks of 4KB (CGB), only first 8KB used in DMG
+    hash::PageHashes<0x8000> m_WorkRamHashes;
     U8 m_WramBank{1};  // SVBK register (0xFF70), banks 1-7 for 0xD000-0xDFFF
     std::array<U8, 0x80> m_IoRegisters{};
     std::array<U8, 0x7F> m_HighRam{};
     U8 m_InterruptEnable{};
-    U32 m_CycleCount{};
+    U64& m_MasterClock;
+    U64& m_CpuCycles;
+    std::array<U8, 0x100> m_WatchPages{};
 
     bool m_CgbMode{false};
 
@@ -72,8 +129,12 @@ private:
     // Serial transfer
     bool m_SerialTransferring{false};
     U16 m_SerialCycles{0};
+    SerialLink* m_Link{};
+    U64 m_LinkDue{NoLinkDue};
 
-    std::string m_SerialBuffer;
+    // Blargg test ROMs print their verdict over serial
+    StreamMatcher m_SerialPassed{"Passed"};
+    StreamMatcher m_SerialFailed{"Failed"};
     TestResult m_TestResult{TestResult::Running};
 };
 
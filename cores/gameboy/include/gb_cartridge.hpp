@@ -1,26 +1,23 @@
 #pragma once
 
 #include <array>
-#include <chrono>
 #include <filesystem>
 #include <iosfwd>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <string_view>
 #include <vector>
 #include <expected>
 
 #include <types.hpp>
+#include <hash.hpp>
+#include <file.hpp>
+#include <gb_mapper.hpp>
 
 namespace gb {
 
-struct RTCRegisters {
-    U8 Seconds{0};   // 0x08: 0-59
-    U8 Minutes{0};   // 0x09: 0-59
-    U8 Hours{0};     // 0x0A: 0-23
-    U8 DaysLow{0};   // 0x0B: lower 8 bits of day counter
-    U8 DaysHigh{0};  // 0x0C: bit 0 = day counter MSB, bit 6 = halt, bit 7 = day carry
-};
-
 struct CartridgeHeader {
     std::array<U8, 4> EntryPoint;
     std::array<U8, 48> NintendoLogo;
@@ -39,26 +36,54 @@ struct CartridgeHeader {
     U16 GlobalChecksum;
 };
 
-enum class MBCType { None, MBC1, MBC3, MBC5 };
-
 class Cartridge {
 public:
     static std::expected<Cartridge, std::string> Load(std::string_view path);
+    // The ROM alone: battery RAM starts blank and no save file is attached
+    static std::expected<Cartridge, std::string> LoadRom(std::string_view path);
+    // In-memory image with no backing save file (generated or embedded ROMs)
+    static std::expected<Cartridge, std::string> FromData(std::vector<U8> data);
+
+    Cartridge(const Cartridge& other);
+    Cartridge(Cartridge&&) noexcept = default;
+    Cartridge& operator=(const Cartridge&) = delete;
+    Cartridge& operator=(Cartridge&&) noexcept = default;
 
     [[nodiscard]] const CartridgeHeader& Header() const { return m_Header; }
-    [[nodiscard]] const std::vector<U8>& Data() const { return m_Data; }
-    [[nodiscard]] U8 Read(U16 address) const;
-    void Write(U16 address, U8 value);
-    [[nodiscard]] U8 ReadRAM(U16 address) const;
-    void WriteRAM(U16 address, U8 value);
+    [[nodiscard]] std::span<const U8> Data() const { return {m_Data.data(), m_RomSize}; }
+    [[nodiscard]] U8 Read(U16 address) const { return m_Mapper->ReadROM(address); }
+    [[nodiscard]] U32 RomBank() const { return m_Mapper->RomBank(); }  // Bank currently mapped at 0x4000-0x7FFF
+    void Write(U16 address, U8 value) { m_Mapper->Write(address, value); }
+    [[nodiscard]] U8 ReadRAM(U16 address) const { return m_Mapper->ReadRAM(address); }
+    void WriteRAM(U16 address, U8 value) { m_Mapper->WriteRAM(address, value); }
     [[nodiscard]] bool ValidateLogo() const;
     [[nodiscard]] bool ValidateHeaderChecksum() const;
     [[nodiscard]] bool HasRAM() const { return m_Header.RamSize > 0; }
     [[nodiscard]] bool IsCgbMode() const { return m_Header.CgbFlag == 0x80 || m_Header.CgbFlag == 0xC0; }
     [[nodiscard]] bool HasBattery() const { return m_HasBattery; }
+    // No-ops without an MBC3 timer; see Rtc
+    void UseEmulatedClock(const U64& masterClock, S64 epoch);
+    void UseWallClock();
+    [[nodiscard]] RtcMode GetRtcMode() const;
     void SetSavePath(std::filesystem::path path);
+    [[nodiscard]] const std::filesystem::path& SavePath() const { return m_SavePath; }
+    // Backs battery RAM with the .sav file itself, set up by SetSavePath()
+    // or Load(). Pages are written back by the kernel; saving only msyncs
+    // and writes the RTC footer to a separate .rtc file.
+    std::expected<void, std::string> MapSaveFile();
+    [[nodiscard]] bool IsSaveMapped() const { return m_RamFile.has_value(); }
+    // Flushes a mapped .sav to disk; callable from any thread
+    bool SyncSave() const;
     void SaveRAM() const;
+    // Contents of the save file at SaveImagePath(): RAM, then the RTC
+    // footer; only the footer (possibly empty) when the .sav is mapped
+    [[nodiscard]] std::vector<U8> SaveImage() const;
+    [[nodiscard]] std::filesystem::path SaveImagePath() const;
+    // Copies RAM pages written since the last call into `image` (from
+    // SaveImage) and refreshes its RTC footer; false if nothing was written
+    bool CollectSave(std::vector<U8>& image);
     void SaveState(std::ostream& out) const;
+    void Hash(hash::Xxh64& hasher) const;
     void LoadState(std::istream& in);
 
 private:
@@ -67,27 +92,20 @@ private:
     void ParseHeader();
     void InitMBC();
     void LoadSaveRAM();
-    void UpdateRTCRegisters();
+    void WriteRtcFooter(std::vector<U8>& image) const;
+    [[nodiscard]] std::span<U8> Ram() { return m_RamFile ? m_RamFile->Data() : std::span<U8>{m_RAM}; }
+    [[nodiscard]] std::span<const U8> Ram() const { return m_RamFile ? m_RamFile->Data() : std::span<const U8>{m_RAM}; }
+    [[nodiscard]] std::filesystem::path RtcPath() const;
 
-    std::vector<U8> m_Data;
-    std::vector<U8> m_RAM;
+    std::vector<U8> m_Data;  // Padded with 0xFF to whole 16 KB banks
+    Size m_RomSize{0};       // Size of the ROM file
+    std::vector<U8> m_RAM;   // Unused while m_RamFile is mapped
+    std::optional<file::MappedFile> m_RamFile;
     CartridgeHeader m_Header;
     std::filesystem::path m_SavePath;
 
-    MBCType m_MBCType{MBCType::None};
-    U16 m_RomBank{1};      // Current ROM bank (MBC5 needs 9 bits)
-    U8 m_RamBank{0};       // Current RAM bank
-    bool m_RamEnabled{false};
-    bool m_BankingMode{false};  // MBC1: 0 = ROM mode, 1 = RAM mode
+    std::unique_ptr<Mapper> m_Mapper;
     bool m_HasBattery{false};
-    bool m_HasRTC{false};
-
-    // RTC state
-    RTCRegisters m_RTC;            // Live registers
-    RTCRegisters m_LatchedRTC;     // Latched snapshot
-    S64 m_RTCBaseTimestamp{0};     // Unix timestamp when RTC was last synced
-    bool m_RTCLatched{false};
-    U8 m_RTCLatchPrev{0xFF};      // Previous latch write value (0x00 → 0x01 triggers latch)
 };
 
 } // namespace gb
@@ -2,7 +2,12 @@
 
 #include <iosfwd>
 #include <types.hpp>
+#include <hash.hpp>
 #include <gb_bus.hpp>
+#include <gb_debugger.hpp>
+#ifdef PHOSPHOR_PROFILE
+#include <gb_profiler.hpp>
+#endif
 
 namespace gb {
 
@@ -25,14 +30,23 @@ class CPU {
 public:
     explicit CPU(Bus& bus, bool cgbMode = false);
 
+    template<Model M>
     void Step();
 
     [[nodiscard]] bool GetFlag(Flag flag) const;
+    [[nodiscard]] bool IsHalted() const { return m_Halted; }
     void SetFlag(Flag flag, bool value);
 
     void DebugPrint() const;
 
+    void SetDebugger(Debugger* debugger) { m_Debugger = debugger; }
+#ifdef PHOSPHOR_PROFILE
+    void SetProfiler(Profiler* profiler) { m_Profiler = profiler; }
+#endif
+
     void SaveState(std::ostream& out) const;
+    // Same fields as SaveState
+    void Hash(hash::Xxh64& hasher) const;
     void LoadState(std::istream& in);
 
     union { U16 AF; struct { U8 Flags; U8 A; }; };
@@ -45,16 +59,20 @@ public:
 
 private:
     Bus& m_Bus;
-    bool m_CgbMode;
     U8 m_EIDelay;   // Delayed IME enable (EI takes effect after next instruction)
     bool m_Halted;  // CPU is halted, waiting for interrupt
     bool m_HaltBug; // HALT bug: next opcode byte is read twice (PC not incremented)
+    Debugger* m_Debugger{};  // Only reached for accesses to watched pages
+#ifdef PHOSPHOR_PROFILE
+    Profiler* m_Profiler{};
+#endif
 
-    void Tick();                              // 1 M-cycle internal delay
-    U8 BusRead(U16 address);                  // Read + tick (1 M-cycle)
-    void BusWrite(U16 address, U8 value);     // Write + tick (1 M-cycle)
-    U8 Fetch();
-    U16 Fetch16();
+    template<Model M> void Tick();                           // 1 M-cycle internal delay
+    template<Model M> U8 BusRead(U16 address);               // Read + tick (1 M-cycle)
+    template<Model M> void BusWrite(U16 address, U8 value);  // Write + tick (1 M-cycle)
+    template<Model M> U8 Fetch();
+    template<Model M> U16 Fetch16();
+    void CheckTestSignature();                // LD B,B: mooneye pass/fail registers
 
     void Inc(U8& reg);
     void Dec(U8& reg);
@@ -73,6 +91,7 @@ private:
     void SetReg16(U8 index, U16 value);
     U16& GetReg16Ref(U8 index);
     bool CheckCondition(U8 cc) const;
+    template<Model M>
     void ExecuteCB();
 };
 
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <types.hpp>
+
+namespace gb {
+
+class Bus;
+
+enum class BreakReason : U8 { Breakpoint, ReadWatch, WriteWatch, Pause };
+
+struct BreakEvent {
+    BreakReason Reason{BreakReason::Pause};
+    U16 PC{};       // Instruction that hit (a breakpoint's has not run yet)
+    U16 Address{};  // Watched address that was accessed
+    U8 Value{};     // Byte read or written
+};
+
+struct Watchpoint {
+    U16 Address;
+    U8 Flags;  // Bus::WatchRead | Bus::WatchWrite
+};
+
+// PC breakpoints and memory watchpoints. Nothing is checked per access or
+// per instruction unless something is set: watchpoints flag their 256-byte
+// page in the Bus so only accesses to those pages reach OnAccess(), and
+// breakpoints are a 64K-bit bitmap consulted only while Armed().
+class Debugger {
+public:
+    explicit Debugger(Bus& bus) : m_Bus{bus} {}
+
+    void AddBreakpoint(U16 pc);
+    void RemoveBreakpoint(U16 pc);
+    void AddWatch(const Watchpoint& watch);
+    void RemoveWatch(U16 address);
+    void ClearAll();
+
+    [[nodiscard]] bool IsBreakpoint(U16 pc) const { return (m_Breakpoints[pc >> 6] >> (pc & 63)) & 1; }
+    [[nodiscard]] bool Armed() const { return m_Armed; }
+
+    // Called before each instruction while Armed(); true means stop without running it
+    bool BeforeInstruction(U16 pc, bool halted);
+    // Slow path for CPU accesses to a watched page
+    void OnAccess(U16 address, U8 value, U8 kind);
+
+    [[nodiscard]] bool Stopped() const { return m_Stopped; }
+    [[nodiscard]] const BreakEvent& LastBreak() const { return m_Event; }
+
+    void Pause();            // Stop before the next instruction
+    void Resume();           // Run on, past a breakpoint at the current PC
+    void StepInstruction();  // Run one instruction, then stop again
+
+private:
+    void Stop(const BreakEvent& event);
+    void RefreshPage(U8 page);
+    void UpdateArmed();
+
+    Bus& m_Bus;
+    std::array<U64, 0x10000 / 64> m_Breakpoints{};
+    std::array<U8, 0x10000> m_Watches{};
+    U32 m_BreakpointCount{0};
+    U32 m_WatchCount{0};
+
+    U16 m_InstructionPC{0};
+    bool m_Armed{false};
+    bool m_Stopped{false};
+    bool m_PauseRequested{false};
+    bool m_StepPending{false};
+    bool m_SkipBreakpoint{false};
+    BreakEvent m_Event{};
+};
+
+} // namespace gb
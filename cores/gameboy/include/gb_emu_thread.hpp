@@ -0,0 +1,107 @@
+#pragma once
+
+#include <SDL.h>
+#include <array>
+#include <atomic>
+#include <thread>
+
+#include <types.hpp>
+#include <triple_buffer.hpp>
+#include <rate_control.hpp>
+#include <gb_ppu.hpp>
+
+namespace gb {
+
+class GameBoy;
+class Movie;
+class BatterySaver;
+class SaveSlots;
+class RollbackSession;
+
+using Framebuffer = std::array<U32, PPU::ScreenWidth * PPU::ScreenHeight>;
+
+// Runs the core on a dedicated thread, paced by the host clock. The frontend
+// only talks to it through the published framebuffers, an atomic joypad
+// snapshot and atomic requests, so present/vsync stalls never eat into
+// emulation time. The GameBoy must not be touched elsewhere while running.
+class EmuThread {
+public:
+    // Speed multiplier meaning "as fast as the host allows"
+    static constexpr float Uncapped = 0.0f;
+
+    EmuThread(GameBoy& gb, SaveSlots& slots, SDL_AudioDeviceID audioDevice, Size audioTargetSamples);
+    ~EmuThread();
+
+    EmuThread(const EmuThread&) = delete;
+    EmuThread& operator=(const EmuThread&) = delete;
+
+    // Call before Start(); the movies must outlive the thread
+    void SetRecording(Movie* movie) { m_Recording = movie; }
+    void SetPlayback(const Movie* movie) { m_Playback = movie; }
+    // Battery RAM writes are handed to the saver after every frame
+    void SetBatterySaver(BatterySaver* saver) { m_BatterySaver = saver; }
+    // Frames then run through the session, which owns input and timing of
+    // the shared machine; loading states and the debugger are refused
+    void SetNetplay(RollbackSession* session) { m_Netplay = session; }
+
+    void Start();
+    void Stop();
+
+    void SetInput(U8 buttons) { m_Input.store(buttons, std::memory_order_relaxed); }
+    // Save and load use the slot selected here
+    void SetStateSlot(U32 slot) { m_Slot.store(slot, std::memory_order_relaxed); }
+    void RequestSaveState() { m_Requests.fetch_or(SaveStateRequest, std::memory_order_relaxed); }
+    void RequestLoadState() { m_Requests.fetch_or(LoadStateRequest, std::memory_order_relaxed); }
+
+    // Debugger control; a breakpoint or watchpoint hit also pauses
+    void RequestPause() { m_Requests.fetch_or(PauseRequest, std::memory_order_relaxed); }
+    void RequestResume() { m_Requests.fetch_or(ResumeRequest, std::memory_order_relaxed); }
+    void RequestStep() { m_Requests.fetch_or(StepRequest, std::memory_order_relaxed); }
+    [[nodiscard]] bool IsPaused() const { return m_Paused.load(std::memory_order_relaxed); }
+
+    // 1 = real time, > 1 or Uncapped = fast-forward, < 1 = slow motion
+    void SetSpeed(float multiplier) { m_Speed.store(multiplier, std::memory_order_relaxed); }
+    [[nodiscard]] float AchievedSpeed() const { return m_AchievedSpeed.load(std::memory_order_relaxed); }
+
+    // Consumer side of the framebuffer exchange: false if no new frame
+    bool AcquireFrame() { return m_Frames.Acquire(); }
+    [[nodiscard]] const Framebuffer& Frame() const { return m_Frames.ReadBuffer(); }
+
+private:
+    static constexpr U8 SaveStateRequest = 0x01;
+    static constexpr U8 LoadStateRequest = 0x02;
+    static constexpr U8 PauseRequest = 0x04;
+    static constexpr U8 ResumeRequest = 0x08;
+    static constexpr U8 StepRequest = 0x10;
+
+    void Loop(std::stop_token stop);
+    void HandleRequests();
+    void RunFrame();
+    void ReportBreak();
+    void QueueAudio(bool fastForward);
+
+    GameBoy& m_GameBoy;
+    SaveSlots& m_Slots;
+    std::atomic<U32> m_Slot{0};
+
+    SDL_AudioDeviceID m_AudioDevice;
+    audio::RateControl m_RateControl;
+    bool m_AudioPrimed{false};
+
+    std::atomic<U8> m_Input{};
+    std::atomic<U8> m_Requests{};
+    std::atomic<float> m_Speed{1.0f};
+    std::atomic<float> m_AchievedSpeed{1.0f};
+    std::atomic<bool> m_Paused{false};
+    TripleBuffer<Framebuffer> m_Frames;
+
+    Movie* m_Recording{};
+    const Movie* m_Playback{};
+    Size m_MovieFrame{0};
+    BatterySaver* m_BatterySaver{};
+    RollbackSession* m_Netplay{};
+
+    std::jthread m_Thread;
+};
+
+} // namespace gb
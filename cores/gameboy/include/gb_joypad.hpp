@@ -2,6 +2,7 @@
 
 #include <iosfwd>
 #include <types.hpp>
+#include <hash.hpp>
 
 namespace gb {
 
@@ -23,6 +24,10 @@ public:
         m_Buttons &= ~button;
     }
 
+    // Replaces the whole pressed-button mask (input snapshots, movies)
+    void SetButtons(U8 buttons) { m_Buttons = buttons; }
+    [[nodiscard]] U8 GetButtons() const { return m_Buttons; }
+
     // Called when game writes to 0xFF00
     void Write(U8 value) { m_Select = value; }
 
@@ -49,6 +54,7 @@ public:
     }
 
     void SaveState(std::ostream& out) const;
+    void Hash(hash::Xxh64& hasher) const;
     void LoadState(std::istream& in);
 
 private:
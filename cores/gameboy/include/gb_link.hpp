@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include <types.hpp>
+#include <gb_bus.hpp>
+
+namespace gb {
+
+class GameBoy;
+
+enum class LinkMode {
+    Lockstep,  // Both machines on the calling thread, taking turns
+    Threaded,  // One thread per machine
+};
+
+struct LinkOptions {
+    LinkMode Mode{LinkMode::Lockstep};
+    // Master cycles either machine may run ahead of the other. A transfer
+    // lands on its exact cycle while this plus the longest instruction stays
+    // below the transfer time: 512 cycles for normal speed serial (1024 in
+    // single speed), 16 for CGB fast serial. Slower ones arrive up to this
+    // late. Smaller values synchronize more often.
+    U32 MaxSkew{256};
+};
+
+struct LinkStats {
+    U64 Transfers{0};      // Bytes clocked by either side
+    U64 LateTransfers{0};  // Reached the other side after their last cycle
+    U64 Syncs{0};          // Times a machine looked at the other's clock
+    U64 Waits{0};          // Times a machine waited for the other
+};
+
+// Connects the serial ports of two GameBoys in the same process for as long
+// as it lives. The machines run in slices of at most MaxSkew cycles ahead of
+// each other; a transfer is handed to the other side when its master clock
+// reaches the cycle the transfer ends, and the clocking side waits there for
+// the byte coming back. Lockstep and threaded runs give identical results
+// whenever no transfer is late. The debugger and save states do not see
+// the cable, so use neither while linked.
+class LinkCable {
+public:
+    // Master cycles in one frame
+    static constexpr U64 CyclesPerFrame = 70224;
+
+    LinkCable(GameBoy& first, GameBoy& second, const LinkOptions& options = {});
+    ~LinkCable();
+
+    LinkCable(const LinkCable&) = delete;
+    LinkCable& operator=(const LinkCable&) = delete;
+
+    // Runs both machines until each has run `cycles` more master cycles
+    // (counted from when the cable was connected); set the joypads between
+    // calls. In threaded mode the second machine runs on a worker thread
+    // kept for the life of the cable.
+    void Run(U64 cycles);
+    void RunFrames(U32 frames) { Run(U64{frames} * CyclesPerFrame); }
+
+    [[nodiscard]] U64 Time() const { return m_Target; }
+    [[nodiscard]] LinkStats Stats() const;
+
+private:
+    static constexpr U64 NoTransfer = ~0ull;
+
+    // One direction of the cable: a transfer clocked by one end, answered by
+    // the other. Out is written before Due is published, In before Answered.
+    struct Channel {
+        std::atomic<U64> Due{NoTransfer};
+        U8 Out{};
+        std::atomic<bool> Answered{false};
+        U8 In{};
+    };
+
+    class End : public SerialLink {
+    public:
+        End(LinkCable& cable, GameBoy& gb, Size index);
+        ~End() override;
+
+        void BeginTransfer(U64 due, U8 out) override;
+        U8 CompleteTransfer() override;
+        void Service() override;
+
+        // Cycles run since the cable was connected
+        [[nodiscard]] U64 Now() const;
+        // Runs instructions until Now() reaches `until`
+        void RunTo(U64 until);
+        void RunThreaded(U64 target);
+        // Takes the peer's transfer, if one was started, and serves it now if overdue
+        void Pull();
+        void Publish() { m_Clock.store(Now(), std::memory_order_release); }
+        void Wait();
+
+        LinkCable& m_Cable;
+        GameBoy& m_GameBoy;
+        Size m_Index;
+        U64 m_Base;     // Master clock when connected
+        bool m_Suspended{false};  // Lockstep: waiting inside CompleteTransfer
+        U32 m_SpinLimit;
+        U32 m_Spins{0};  // Waits since the last slice
+        LinkStats m_Stats;
+        alignas(64) std::atomic<U64> m_Clock{0};  // Published Now(), read by the peer's thread
+    };
+
+    [[nodiscard]] End& Peer(const End& end) { return m_Ends[1 - end.m_Index]; }
+    void WorkerLoop(std::stop_token stop);
+
+    LinkOptions m_Options;
+    U64 m_Target{0};
+    std::array<Channel, 2> m_Channels;  // Indexed by the clocking end
+    std::array<End, 2> m_Ends;
+    // Threaded mode: Run() bumps m_Started, the worker bumps m_Done
+    std::atomic<U32> m_Started{0};
+    std::atomic<U32> m_Done{0};
+    std::jthread m_Worker;
+};
+
+struct LinkTestOptions {
+    U32 Frames{600};
+    LinkOptions Link;
+};
+
+// Runs two ROMs (or one ROM twice) linked, in lockstep and on two threads,
+// and checks both runs ended in the same states; reports the speed of each
+S32 RunLinkSelfTest(const std::string& firstRom, const std::string& secondRom, const LinkTestOptions& options);
+
+} // namespace gb
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <array>
+#include <iosfwd>
+#include <memory>
+#include <span>
+
+#include <types.hpp>
+#include <hash.hpp>
+
+namespace gb {
+
+struct RTCRegisters {
+    U8 Seconds{0};   // 0x08: 0-59
+    U8 Minutes{0};   // 0x09: 0-59
+    U8 Hours{0};     // 0x0A: 0-23
+    U8 DaysLow{0};   // 0x0B: lower 8 bits of day counter
+    U8 DaysHigh{0};  // 0x0C: bit 0 = day counter MSB, bit 6 = halt, bit 7 = day carry
+};
+
+// Where the MBC3 RTC gets its time from
+enum class RtcMode { Emulated, WallClock };
+
+// MBC3 real-time clock
+class Rtc {
+public:
+    Rtc();
+
+    [[nodiscard]] U8 Read(U8 reg) const;  // Latched register 0x08-0x0C
+    void Write(U8 reg, U8 value);
+    void Latch(U8 value);                 // Writes to 0x6000-0x7FFF; 0x00 then 0x01 latches
+
+    // Emulated: seconds come from the master clock (4 MiHz cycles),
+    // starting at `epoch` (Unix seconds) now. Wall clock: std::time().
+    // Switching first applies the time elapsed under the old clock.
+    void UseEmulatedClock(const U64& masterClock, S64 epoch);
+    void UseWallClock();
+    [[nodiscard]] RtcMode Mode() const { return m_Clock ? RtcMode::Emulated : RtcMode::WallClock; }
+
+    // VBA-M compatible 48-byte footer of the .sav file
+    static constexpr Size FileSize = 48;
+    void LoadFile(std::istream& in);
+    void SaveFile(std::ostream& out) const;
+
+    void SaveState(std::ostream& out) const;
+    void LoadState(std::istream& in);
+    void Hash(hash::Xxh64& hasher) const;
+
+private:
+    void Update();
+    [[nodiscard]] S64 Now() const;
+    [[nodiscard]] Rtc Synced() const;  // Copy with the elapsed time applied
+    void SaveFields(std::ostream& out) const;
+    void HashFields(hash::Xxh64& hasher) const;
+
+    RTCRegisters m_Live;
+    RTCRegisters m_Latched;
+    S64 m_BaseTimestamp{0};        // Unix timestamp when the registers were last synced
+    bool m_LatchedFlag{false};
+    U8 m_LatchPrev{0xFF};          // Previous latch write value (0x00 → 0x01 triggers latch)
+    const U64* m_Clock{};          // Master clock in emulated mode, null for wall clock
+    U64 m_ClockOrigin{0};          // Master clock value at m_Epoch
+    S64 m_Epoch{0};
+};
+
+// Memory bank controller. Register writes recompute the ROM and RAM
+// windows, so the bus reads them with a pointer plus offset.
+class Mapper {
+public:
+    static constexpr Size RomBankSize = 0x4000;
+    static constexpr Size RamBankSize = 0x2000;
+    static constexpr Size DirtyPageSize = 0x100;
+
+    static std::unique_ptr<Mapper> Create(U8 cartridgeType);
+    virtual ~Mapper() = default;
+    // Copy of the registers; Attach it to the copied ROM and RAM
+    [[nodiscard]] virtual std::unique_ptr<Mapper> Clone() const = 0;
+
+    // `rom` must be a whole number of banks, at least two. Remaps and
+    // rehashes all of RAM on the next Hash().
+    void Attach(std::span<const U8> rom, std::span<U8> ram);
+
+    [[nodiscard]] U8 ReadROM(U16 address) const { return m_RomMap[address >> 14][address & 0x3FFF]; }
+    [[nodiscard]] U8 ReadRAM(U16 address) const {
+        if (m_RamMap) [[likely]] return m_RamMap[address - 0xA000];
+        return ReadUnmapped(address);
+    }
+    void WriteRAM(U16 address, U8 value) {
+        if (m_RamMap) [[likely]] {
+            m_RamMap[address - 0xA000] = value;
+            MarkDirty(static_cast<Size>(m_RamMap - m_Ram.data()) + (address - 0xA000));
+        }
+        else {
+            WriteUnmapped(address, value);
+        }
+    }
+
+    virtual void Write(U16 address, U8 value) = 0;  // 0x0000-0x7FFF
+    [[nodiscard]] U32 RomBank() const { return m_RomBankN; }  // Bank mapped at 0x4000-0x7FFF
+    [[nodiscard]] virtual Rtc* Clock() const { return nullptr; }  // MBC3 with timer only
+
+    // Copies RAM pages written since the last call into `out` (RAM sized,
+    // or empty to only clear them); false if there were none
+    bool TakeDirtyPages(std::span<U8> out);
+    void MarkAllDirty();
+
+    void SaveState(std::ostream& out) const;
+    void LoadState(std::istream& in);  // Attach again afterwards
+    // Registers and RAM, the latter through cached page hashes
+    void Hash(hash::Xxh64& hasher) const;
+
+protected:
+    // Recompute m_RomMap/m_RamMap from the bank registers
+    virtual void Remap() = 0;
+    // RAM accesses with no full bank mapped: disabled, under 8 KB or RTC
+    [[nodiscard]] virtual U8 ReadUnmapped(U16 address) const;
+    virtual void WriteUnmapped(U16 address, U8 value);
+
+    void MapRom(U32 bank0, U32 bankN);
+    void MapRam(U32 bank);  // Only when enabled and the bank is fully backed
+    void UnmapRam() { m_RamMap = nullptr; }
+    void MarkDirty(Size offset) {
+        m_DirtyPages[offset / (DirtyPageSize * 64)] |= 1ull << (offset / DirtyPageSize % 64);
+        m_RamHashes.MarkDirty(offset);
+    }
+
+    std::span<const U8> m_Rom;
+    std::span<U8> m_Ram;
+
+    U16 m_RomBank{1};           // Current ROM bank (MBC5 needs 9 bits)
+    U8 m_RamBank{0};            // Current RAM bank
+    bool m_RamEnabled{false};
+    bool m_BankingMode{false};  // MBC1: 0 = ROM mode, 1 = RAM mode
+
+private:
+    std::array<const U8*, 2> m_RomMap{};
+    U8* m_RamMap{};
+    U32 m_RomBankN{1};
+    std::array<U64, 8> m_DirtyPages{};  // One bit per page, 128 KB max
+    hash::PageHashes<0x20000, DirtyPageSize> m_RamHashes;
+};
+
+} // namespace gb
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <types.hpp>
+
+namespace gb {
+
+// Console model. Hot paths (CPU step, bus access, scanline rendering) are
+// templates on it, so DMG games never test CGB-only state per access or
+// per pixel; GameBoy picks the instantiation once from the cartridge.
+enum class Model : U8 { Dmg, Cgb };
+
+} // namespace gb
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <expected>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <types.hpp>
+
+namespace gb {
+
+class GameBoy;
+
+// Input movie: a snapshot of the machine when recording started (which
+// carries SRAM and RTC registers), the RTC seed, and one joypad byte per
+// frame. Replaying it against the same ROM reproduces the run exactly.
+// A frame is one GameBoy::RunUntilFrame().
+class Movie {
+public:
+    // Snapshots `gb` and switches it to the emulated RTC; add frames as they run
+    static std::expected<Movie, std::string> Record(GameBoy& gb);
+    static std::expected<Movie, std::string> Load(std::string_view path);
+    bool Save(std::string_view path) const;
+
+    // Restores the recorded start state into `gb` (which must run the same ROM)
+    [[nodiscard]] std::expected<void, std::string> Start(GameBoy& gb) const;
+
+    void AddFrame(U8 buttons) { m_Inputs.push_back(buttons); }
+    [[nodiscard]] Size FrameCount() const { return m_Inputs.size(); }
+    [[nodiscard]] U8 Buttons(Size frame) const { return m_Inputs[frame]; }
+
+private:
+    Movie() = default;
+
+    U32 m_RomCrc{0};
+    S64 m_RtcSeed{0};
+    std::vector<U8> m_State;
+    std::vector<U8> m_Inputs;
+};
+
+// Headless replay: reports speed and a hash of the final frame. Replaying a
+// fixed movie this way is the canonical performance benchmark.
+S32 ReplayMovie(const std::string& romPath, const std::string& moviePath);
+
+} // namespace gb
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <types.hpp>
+#include <net.hpp>
+#include <state.hpp>
+
+namespace gb {
+
+class GameBoy;
+
+struct NetplayOptions {
+    U32 InputDelay{2};   // Frames between pressing and the button taking effect
+    U32 MaxRollback{8};  // Frames the game may run ahead of the peer's input
+};
+
+struct NetplayStats {
+    U64 Frames{0};             // Frames advanced, not counting re-runs
+    U64 StalledFrames{0};      // AdvanceFrame calls spent waiting for the peer
+    U64 Rollbacks{0};
+    U64 ResimulatedFrames{0};
+    U32 MaxRollbackDepth{0};
+    U32 LastResimulated{0};          // Frames re-run by the last AdvanceFrame
+    double LastResimulationMs{0.0};  // Restore plus re-runs in the last AdvanceFrame
+    double MaxResimulationMs{0.0};
+    double TotalResimulationMs{0.0};
+    double TotalSnapshotMs{0.0};
+    bool Desynced{false};
+    U32 DesyncFrame{0};
+};
+
+// GGPO-style rollback for two players sharing one GameBoy: both press the
+// same joypad (their buttons are OR'd), as two people on one console would.
+// Each side runs ahead on a prediction of the peer's buttons (the last ones
+// it received), snapshots every frame whose input is not yet known, and when
+// the real input differs, restores the first wrong frame and re-runs up to
+// the present with rendering off. Both sides must start from the same state;
+// they compare state hashes of confirmed frames to detect desyncs.
+class RollbackSession {
+public:
+    static constexpr U32 MaxInputDelay = 16;
+    static constexpr U32 MaxRollbackLimit = 64;
+    // Confirmed frames at multiples of this have their state hash exchanged
+    static constexpr U32 HashInterval = 16;
+
+    RollbackSession(GameBoy& gb, net::Transport& transport, const NetplayOptions& options);
+
+    // Runs the next frame with the local player's buttons. Returns false
+    // without running anything while the peer's input is MaxRollback frames
+    // behind; call again on the next tick.
+    bool AdvanceFrame(U8 buttons);
+    // Exchanges input and corrects mispredictions without running a new
+    // frame, e.g. while waiting for the peer to catch up
+    void Poll();
+
+    [[nodiscard]] U32 Frame() const { return m_Frame; }
+    // Frames before this ran with both players' real input
+    [[nodiscard]] U32 ConfirmedFrame() const { return std::min(m_Frame, m_RemoteCount); }
+    [[nodiscard]] const NetplayStats& Stats() const { return m_Stats; }
+
+private:
+    static constexpr U32 InputWindow = 256;  // Frames of input kept per player
+    static constexpr U32 HashSlots = 8;
+    static constexpr U32 NoFrame = ~0u;
+
+    struct StoredHash {
+        U32 Frame{NoFrame};
+        U64 Hash{0};
+    };
+
+    void Receive();
+    void HandlePacket(std::span<const U8> packet);
+    void SendInput();
+    void Rollback();
+    void SimulateFrame();
+    [[nodiscard]] U8 RemoteInput(U32 frame) const;
+    [[nodiscard]] std::optional<U64> ConfirmedHash(U32 frame) const;
+
+    GameBoy& m_GameBoy;
+    net::Transport& m_Transport;
+    NetplayOptions m_Options;
+
+    U32 m_Frame{0};        // Next frame to run
+    U32 m_LocalCount{0};   // Local input known for frames below this
+    U32 m_RemoteCount{0};  // Peer input received for frames below this
+    U32 m_PeerAck{0};      // The peer has our input for frames below this
+    U32 m_RollbackFrom{NoFrame};  // First frame that ran on a wrong prediction
+    std::array<U8, InputWindow> m_LocalInputs{};
+    std::array<U8, InputWindow> m_RemoteInputs{};
+    std::array<U8, InputWindow> m_UsedRemote{};  // Peer input each frame ran with
+
+    std::vector<std::vector<state::Section>> m_Snapshots;  // State at the start of each unconfirmed frame
+    std::array<StoredHash, HashSlots> m_Hashes{};
+    NetplayStats m_Stats;
+};
+
+struct NetplayTestOptions {
+    U32 Frames{1200};
+    U32 Latency{5};     // Loopback ticks (one per frame)
+    U32 DropEvery{7};   // Lose every n-th packet
+    NetplayOptions Session;
+};
+
+// Runs two sessions of the ROM over a lossy in-process loopback with
+// scripted input, then checks both ended in the state of a plain run with
+// the combined input and reports what rollback cost per frame
+S32 RunNetplaySelfTest(const std::string& romPath, const NetplayTestOptions& options);
+
+} // namespace gb
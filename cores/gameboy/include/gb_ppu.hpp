@@ -4,6 +4,8 @@
 #include <iosfwd>
 #include <optional>
 #include <types.hpp>
+#include <hash.hpp>
+#include <gb_model.hpp>
 
 namespace gb {
 
@@ -23,10 +25,13 @@ public:
     static constexpr S32 DrawingCycles = 172;
     static constexpr S32 HBlankCycles = 204;
     static constexpr S32 VBlankLines = 10;
+    static constexpr S32 CyclesPerFrame = CyclesPerScanline * 154;
 
-    explicit PPU(bool cgbMode = false);
+    // Reads the master clock, which the Bus advances before each Tick
+    explicit PPU(const U64& clock, bool cgbMode = false);
 
-    void Tick(U8 mCycles);
+    template<Model M>
+    void Tick();
 
     [[nodiscard]] std::optional<U8> Read(U16 address) const;
     bool Write(U16 address, U8 value);
@@ -39,20 +44,47 @@ public:
 
     [[nodiscard]] const std::array<U32, ScreenWidth * ScreenHeight>& GetFramebuffer() const { return m_Framebuffer; }
 
+    // Skips pixel output (fast-forward, rollback) while keeping timing and
+    // interrupts identical; the framebuffer keeps its last rendered contents
+    void SetRenderingEnabled(bool enabled) { m_RenderingEnabled = enabled; }
+    [[nodiscard]] bool RenderingEnabled() const { return m_RenderingEnabled; }
+
     [[nodiscard]] U8 GetLY() const { return m_LY; }
     [[nodiscard]] U8 GetLCDC() const { return m_LCDC; }
     [[nodiscard]] U8 GetVBK() const { return m_VBK; }
 
-    [[nodiscard]] U8 ReadVRAM(U16 address) const;
-    void WriteVRAM(U16 address, U8 value);
+    template<Model M>
+    [[nodiscard]] U8 ReadVRAM(U16 address) const
+    {
+        if constexpr (M == Model::Cgb)
+            return m_VRAM[(m_VBK & 1) * 0x2000 + (address & 0x1FFF)];
+        else
+            return m_VRAM[address & 0x1FFF];
+    }
+
+    template<Model M>
+    void WriteVRAM(U16 address, U8 value)
+    {
+        const Size offset = M == Model::Cgb ? (m_VBK & 1) * 0x2000 + (address & 0x1FFF) : address & 0x1FFF;
+        m_VRAM[offset] = value;
+        m_VramHashes.MarkDirty(offset);
+    }
+
     [[nodiscard]] U8 ReadOAM(U16 address) const;
     void WriteOAM(U16 address, U8 value);
 
     void SaveState(std::ostream& out) const;
-    void LoadState(std::istream& in);
+    // SaveState fields except the framebuffer, which is output only;
+    // VRAM through cached page hashes
+    void Hash(hash::Xxh64& hasher) const;
+    // Version 1 stored the line position as a U16
+    void LoadState(std::istream& in, U16 version);
 
 private:
-    U16 m_Cycles{};  // 0-455, position within current scanline
+    const U64& m_Clock;
+    // Master clock at the start of the current scanline, or of the current
+    // frame while the LCD is off; the position is m_Clock - m_LineStart
+    U64 m_LineStart{};
 
     PPUMode m_Mode{PPUMode::OAMScan};
 
@@ -69,6 +101,7 @@ private:
     U8 m_WX{};        // 0xFF4B - Window X
 
     std::array<U8, 0x4000> m_VRAM{};  // 16KB Video RAM (2 banks in CGB)
+    hash::PageHashes<0x4000> m_VramHashes;
     std::array<U8, 0xA0> m_OAM{};     // 160 bytes OAM
 
     // CGB registers and palette RAM
@@ -100,7 +133,9 @@ private:
     bool m_HBlankStart{};
 
     bool m_CgbMode{false};
+    bool m_RenderingEnabled{true};
 
+    template<Model M>
     void DrawScanline();
     [[nodiscard]] static U8 GetColorFromPalette(U8 palette, U8 colorIndex);
     [[nodiscard]] static U32 CgbColorToARGB(U8 low, U8 high);
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <types.hpp>
+
+namespace gb {
+
+class Bus;
+class CPU;
+
+// Guest code profiler: executions and T-cycles per opcode, per CB opcode and
+// per (bank, PC), plus a call tree built from taken CALL/RST/interrupts and
+// RET/RETI. Only compiled into the CPU with the PHOSPHOR_PROFILE CMake option.
+class Profiler {
+public:
+    Profiler();
+
+    void Instruction(U32 bank, U16 pc, U8 opcode, U8 cbOpcode, U32 cycles);
+    void Halted(U32 cycles) { m_HaltedCycles += cycles; }
+    void Interrupt(U16 vector, U32 cycles);
+    void Call(U32 bank, U16 target);
+    void Return();
+
+    // Set by the CPU when it dispatches an interrupt instead of executing
+    void InterruptDispatched() { m_InterruptPending = true; }
+    bool TakeInterrupt() { return std::exchange(m_InterruptPending, false); }
+
+    // Sorted text report: opcodes, CB opcodes and hottest PCs
+    bool WriteReport(const std::filesystem::path& path) const;
+    // One "frame;frame;... cycles" line per call path (flamegraph.pl, speedscope)
+    bool WriteFoldedStacks(const std::filesystem::path& path) const;
+
+private:
+    struct Counter {
+        U64 Count{};
+        U64 Cycles{};
+    };
+
+    struct CallNode {
+        U32 Function;    // bank << 16 | entry address
+        U32 Parent;
+        U64 Cycles{};    // Self time
+        std::unordered_map<U32, U32> Children;
+    };
+
+    // Deeper than this the stack is being manipulated by hand; start over
+    static constexpr Size MaxCallDepth = 256;
+
+    std::array<Counter, 256> m_Opcodes{};
+    std::array<Counter, 256> m_CbOpcodes{};
+    std::unordered_map<U32, Counter> m_Pcs;  // bank << 16 | pc
+    U64 m_HaltedCycles{};
+    U64 m_InterruptCycles{};
+    bool m_InterruptPending{false};
+
+    std::vector<CallNode> m_Nodes;
+    U32 m_Current{0};
+    Size m_Depth{0};
+};
+
+// Samples CPU state around one CPU::Step and reports it to the profiler
+class ProfileScope {
+public:
+    ProfileScope(Profiler* profiler, const CPU& cpu, const Bus& bus);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    Profiler* m_Profiler;
+    const CPU& m_Cpu;
+    const Bus& m_Bus;
+    U64 m_StartCycles{};
+    U32 m_Bank{};
+    U16 m_Pc{};
+    U16 m_Sp{};
+    U8 m_Opcode{};
+    U8 m_CbOpcode{};
+    bool m_WasHalted{};
+};
+
+} // namespace gb
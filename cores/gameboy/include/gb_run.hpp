@@ -1,9 +1,31 @@
 #pragma once
 
+#include <optional>
 #include <string>
+#include <vector>
 #include <types.hpp>
+#include <gb_cartridge.hpp>
+#include <gb_debugger.hpp>
+#include <gb_netplay.hpp>
 
 namespace gb {
-    S32 Run(const std::string& romPath, bool fullscreen);
-    void RunTests(const std::string& testRomsDir);
+    struct RunOptions {
+        bool Fullscreen{false};
+        std::string ChromeTracePath;  // Write host timing spans here on exit
+        std::string TracePath;        // Record every executed instruction here
+        std::string RecordMoviePath;  // Record joypad input as a movie
+        std::string PlayMoviePath;    // Replay a movie's input
+        RtcMode Rtc{RtcMode::Emulated};
+        std::optional<S64> RtcEpoch;  // Unix seconds; host time when unset
+        bool MapSaveFile{false};      // Back battery RAM with an mmap'd .sav
+        // Rollback netplay over UDP when a peer is set; both sides need the
+        // same ROM, save file and RTC epoch
+        std::string NetplayPeer;      // host:port
+        U16 NetplayPort{0};           // Local UDP port
+        NetplayOptions Netplay;
+        std::vector<U16> Breakpoints;
+        std::vector<Watchpoint> Watches;
+    };
+
+    S32 Run(const std::string& romPath, const RunOptions& options);
 }
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <types.hpp>
+#include <state.hpp>
+#include <gb_ppu.hpp>
+
+namespace gb {
+
+class GameBoy;
+
+// Numbered save-state files <base>.ss0 ... <base>.ss9. Save() only
+// snapshots the machine and thumbnail on the calling (emulation) thread;
+// a worker compresses each snapshot and writes it through a temp file +
+// rename, so saving never waits on the disk.
+class SaveSlots {
+public:
+    static constexpr U32 Count = 10;
+    static constexpr U32 ThumbnailWidth = PPU::ScreenWidth / 2;
+    static constexpr U32 ThumbnailHeight = PPU::ScreenHeight / 2;
+
+    // Shown when picking a slot; read without loading the machine state
+    struct Info {
+        S64 Timestamp{0};  // Unix seconds
+        std::vector<U32> Thumbnail;  // ThumbnailWidth x ThumbnailHeight, or empty
+    };
+
+    explicit SaveSlots(std::filesystem::path base);
+    // Finishes queued writes
+    ~SaveSlots();
+
+    SaveSlots(const SaveSlots&) = delete;
+    SaveSlots& operator=(const SaveSlots&) = delete;
+
+    void Save(const GameBoy& gb, U32 slot);
+    // Waits for a queued save of the same slot first
+    bool Load(GameBoy& gb, U32 slot);
+
+    [[nodiscard]] std::filesystem::path SlotPath(U32 slot) const;
+    [[nodiscard]] std::optional<Info> ReadInfo(U32 slot);
+
+private:
+    struct Job {
+        U32 Slot;
+        std::vector<state::Section> Sections;
+    };
+
+    void WriterLoop(std::stop_token stop);
+    void WaitForSlot(U32 slot);
+
+    std::filesystem::path m_Base;
+
+    std::mutex m_Mutex;
+    std::condition_variable_any m_Wake;
+    std::condition_variable m_Written;
+    std::deque<Job> m_Queue;
+    std::optional<U32> m_Writing;  // Slot the worker is writing now
+
+    std::jthread m_Writer;
+};
+
+} // namespace gb
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <types.hpp>
+
+namespace gb {
+
+struct TestOptions {
+    std::string TestRomsDir;
+    std::string Filter;             // Glob over paths relative to TestRomsDir; empty = TestRoms()
+    U64 MaxCycles{200'000'000};     // Emulated budget per test (~48 s of Game Boy time)
+    double TimeoutSeconds{60.0};    // Host wall-clock budget per test
+    U32 Jobs{0};                    // Worker threads, 0 = one per hardware thread
+};
+
+// Runs the test ROMs concurrently and prints the result, wall time and
+// emulated cycles of each. Returns non-zero if any test did not pass.
+S32 RunTests(const TestOptions& options);
+
+struct ScreenshotOptions {
+    std::string ManifestPath;
+    std::string TestRomsDir;        // ROM paths in the manifest are relative to this
+    bool Update{false};             // Rewrite the manifest with the current hashes
+    U32 Jobs{0};
+};
+
+// Runs each manifest ROM headless for its frame count and compares the XXH64
+// of the framebuffer with the golden value. Manifest lines are
+// "<hash|-> <frames> <rom path>"; '#' starts a comment. Returns non-zero on
+// any mismatch (never in update mode) or when a ROM with a golden value
+// fails to load. ROMs run without their .sav, on an RTC starting at 0.
+S32 RunScreenshotTests(const ScreenshotOptions& options);
+
+// Blargg ROMs run when no filter is given, relative to the test ROM directory
+const std::vector<std::string>& TestRoms();
+
+} // namespace gb
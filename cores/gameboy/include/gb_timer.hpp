@@ -3,27 +3,40 @@
 #include <iosfwd>
 #include <optional>
 #include <types.hpp>
+#include <hash.hpp>
 
 namespace gb {
 
+// DIV and TIMA are worked out from the CPU cycle count when read rather than
+// counted every cycle. TIMA is brought up to date at register writes and at
+// the predicted cycle of its next overflow, when the Bus calls
+// InterruptRequested.
 class Timer {
 public:
-    Timer() = default;
-
-    void Tick(U8 mCycles);
+    // Reads the CPU cycle count, which the Bus advances by 4 each M-cycle
+    explicit Timer(const U64& cycles);
 
     [[nodiscard]] std::optional<U8> Read(U16 address) const;
     bool Write(U16 address, U8 value);
 
+    // CPU cycle at or after which the Bus must call InterruptRequested
+    [[nodiscard]] U64 NextEvent() const { return m_NextEvent; }
     [[nodiscard]] bool InterruptRequested();
-    void ResetDiv() { m_Div = 0; }
+    void ResetDiv();
 
     void SaveState(std::ostream& out) const;
+    void Hash(hash::Xxh64& hasher) const;
     void LoadState(std::istream& in);
 
 private:
-    // Internal 16-bit counter - only upper 8 bits are exposed as DIV (0xFF04)
-    U16 m_Div{};
+    static constexpr U64 NoEvent = ~0ull;
+
+    const U64& m_Cycles;
+    // CPU cycle the internal 16-bit counter was last zero; only its upper
+    // 8 bits are exposed as DIV (0xFF04)
+    U64 m_DivStart;
+    U64 m_SyncedAt;  // CPU cycle m_TIMA is current at
+    U64 m_NextEvent{NoEvent};
 
     U8 m_TIMA{};  // 0xFF05 - Timer counter
     U8 m_TMA{};   // 0xFF06 - Timer modulo (reload value)
@@ -31,13 +44,26 @@ private:
 
     bool m_InterruptFlag{};
 
-    // Returns the bit position in m_Div based on TAC clock select
-    // Clock select (TAC bits 1-0) -> bit position in m_Div:
+    [[nodiscard]] U64 Counter() const { return m_Cycles - m_DivStart; }
+    [[nodiscard]] bool Enabled() const { return m_TAC & 0x04; }
+    // Falling edges of the selected bit since m_SyncedAt
+    [[nodiscard]] U64 PendingEdges() const;
+    [[nodiscard]] U8 CurrentTima() const;
+    // Applies the pending edges to TIMA
+    void Sync();
+    void Increment();
+    void Schedule();
+
+    // Returns the bit position in the counter based on TAC clock select
+    // Clock select (TAC bits 1-0) -> bit position in the counter:
     //   00 -> bit 9  (every 256 M-cycles, 4096 Hz)
     //   01 -> bit 3  (every 4 M-cycles, 262144 Hz)
     //   10 -> bit 5  (every 16 M-cycles, 65536 Hz)
     //   11 -> bit 7  (every 64 M-cycles, 16384 Hz)
     [[nodiscard]] U8 GetTimerBit() const;
+    // CPU cycles between TIMA increments: the selected bit falls once per
+    // two of its periods
+    [[nodiscard]] U64 Period() const { return U64{2} << GetTimerBit(); }
 };
 
 } // namespace gb
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <expected>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <types.hpp>
+#include <spsc_ring.hpp>
+
+namespace gb {
+
+// One executed instruction, captured before it runs
+struct TraceRecord {
+    U64 Cycle;      // T-cycles since power-on
+    U16 PC;
+    U16 SP;
+    U16 Bank;       // ROM bank mapped at 0x4000-0x7FFF
+    U8 Opcode;
+    U8 A, F, B, C, D, E, H, L;
+    U8 Reserved;
+};
+static_assert(sizeof(TraceRecord) == 24);
+
+// Streams TraceRecords to disk. Record() only copies into a lock-free ring;
+// a background thread XORs each record with the one before it, splits the
+// chunk into byte planes, compresses it and writes it out. The emulation
+// thread only waits if the writer falls a whole ring behind.
+//
+// File layout: "PHTR", version, record size, then self-contained chunks of
+// [U32 records][U32 compressed size][compressed bytes].
+class TraceRecorder {
+public:
+    static std::expected<std::unique_ptr<TraceRecorder>, std::string> Open(std::string_view path);
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    void Record(const TraceRecord& record);
+    // Flushes everything recorded so far and closes the file; false if a
+    // write failed
+    bool Close();
+
+    [[nodiscard]] U64 RecordCount() const { return m_Recorded; }
+
+private:
+    explicit TraceRecorder(std::ofstream file);
+    void WriterLoop(std::stop_token stop);
+    void WriteChunk(std::vector<TraceRecord>& chunk);
+
+    std::ofstream m_File;
+    SpscRing<TraceRecord> m_Ring;
+    U64 m_Recorded{0};
+    std::jthread m_Writer;
+};
+
+class TraceReader {
+public:
+    static std::expected<TraceReader, std::string> Open(std::string_view path);
+
+    // False at end of file or on a corrupt chunk (see Error())
+    bool Next(TraceRecord& record);
+    [[nodiscard]] const std::string& Error() const { return m_Error; }
+
+private:
+    TraceReader() = default;
+    bool ReadChunk();
+
+    std::ifstream m_File;
+    std::vector<TraceRecord> m_Chunk;
+    Size m_Position{0};
+    std::string m_Error;
+};
+
+// Compares two traces and reports the first divergent record with some
+// context. Returns 0 if they are identical.
+S32 DiffTraces(const std::string& pathA, const std::string& pathB);
+
+} // namespace gb
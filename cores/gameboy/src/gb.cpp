@@ -1,67 +1,249 @@
 #include <gb.hpp>
+#include <algorithm>
+#include <array>
+#include <ctime>
 #include <fstream>
 #include <print>
+#include <spanstream>
+#include <sstream>
 #include <state.hpp>
 
 namespace gb {
 
+namespace {
+    constexpr U32 CpuSection = state::SectionId("CPU ");
+    constexpr U32 BusSection = state::SectionId("BUS ");
+    constexpr U32 TimerSection = state::SectionId("TIMR");
+    constexpr U32 PpuSection = state::SectionId("PPU ");
+    constexpr U32 ApuSection = state::SectionId("APU ");
+    constexpr U32 CartridgeSection = state::SectionId("CART");
+    constexpr U32 ClockSection = state::SectionId("CLK ");
+
+    // Load order. The clock goes first so the RTC rebases on the restored
+    // time; it is the one optional section, as older files lack it.
+    constexpr std::array SectionOrder{ClockSection, CpuSection, BusSection, TimerSection, PpuSection, ApuSection, CartridgeSection};
+
+    // Layout version of every section; a component whose SaveState changes
+    // gets its own constant and keeps reading the older versions
+    constexpr U16 SectionVersion = 1;
+    // 2: the line position widened to U32 to hold LCD-off frame positions
+    constexpr U16 PpuSectionVersion = 2;
+
+    constexpr U16 LatestVersion(U32 id)
+    {
+        return id == PpuSection ? PpuSectionVersion : SectionVersion;
+    }
+
+    // Payload bytes a section of `version` holds, given its latest size
+    constexpr Size PayloadSize(U32 id, U16 version, Size latest)
+    {
+        // PPU version 1 stored the line position as a U16
+        return id == PpuSection && version < 2 ? latest - (sizeof(U32) - sizeof(U16)) : latest;
+    }
+
+    template<typename T>
+    state::Section CaptureSection(U32 id, const T& component)
+    {
+        std::ostringstream out;
+        component.SaveState(out);
+        const std::string bytes = std::move(out).str();
+        return {id, LatestVersion(id), {bytes.begin(), bytes.end()}};
+    }
+}
+
 GameBoy::GameBoy(Cartridge&& cart)
     : m_Cartridge{std::move(cart)}
-    , m_CgbMode{m_Cartridge.IsCgbMode()}
-    , m_Timer{}
-    , m_PPU{m_CgbMode}
-    , m_APU{}
-    , m_Bus{m_Cartridge, m_Timer, m_PPU, m_APU, m_CgbMode}
-    , m_CPU{m_Bus, m_CgbMode}
+    , m_Model{m_Cartridge.IsCgbMode() ? Model::Cgb : Model::Dmg}
+    , m_Timer{m_CpuCycles}
+    , m_PPU{m_MasterClock, IsCgbMode()}
+    , m_APU{m_MasterClock}
+    , m_Bus{m_Cartridge, m_Timer, m_PPU, m_APU, m_MasterClock, m_CpuCycles, IsCgbMode()}
+    , m_CPU{m_Bus, IsCgbMode()}
+    , m_Debugger{m_Bus}
 {
+    m_CPU.SetDebugger(&m_Debugger);
+    UseEmulatedRTC(static_cast<S64>(std::time(nullptr)));
+    for (const auto& section : CaptureState())
+        m_SectionSizes.push_back(section.Data.size());
+#ifdef PHOSPHOR_PROFILE
+    m_CPU.SetProfiler(&m_Profiler);
+#endif
 }
 
 U32 GameBoy::Step()
 {
-    m_Bus.ResetCycleCount();
-    m_CPU.Step();
-    return m_Bus.GetCycleCount();
+    const U32 cycles = m_Model == Model::Cgb ? StepAs<Model::Cgb>() : StepAs<Model::Dmg>();
+    m_APU.Tick();
+    return cycles;
 }
 
-bool GameBoy::SaveState(std::string_view path) const
+U32 GameBoy::RunUntilFrame()
 {
-    std::ofstream file{std::string(path), std::ios::binary};
-    if (!file) return false;
+    return static_cast<U32>(RunUntil([this] { return m_PPU.FrameReady(); }, MaxFrameCycles));
+}
 
-    state::Write(file, state::Magic);
-    state::Write(file, state::Version);
+U64 GameBoy::RunCycles(U64 cycles)
+{
+    return RunUntil([] { return false; }, cycles);
+}
 
-    m_CPU.SaveState(file);
-    m_Bus.SaveState(file);
-    m_Timer.SaveState(file);
-    m_PPU.SaveState(file);
-    m_APU.SaveState(file);
-    m_Cartridge.SaveState(file);
+void GameBoy::TraceInstruction()
+{
+    // Halted steps execute nothing; skip them to keep traces comparable
+    if (m_CPU.IsHalted())
+        return;
+
+    const U16 pc = m_CPU.PC;
+    const bool banked = pc >= 0x4000 && pc < 0x8000;
+    m_Tracer->Record({
+        .Cycle = m_Bus.GetCpuCycles(),
+        .PC = pc,
+        .SP = m_CPU.SP,
+        .Bank = static_cast<U16>(banked ? m_Cartridge.RomBank() : 0),
+        .Opcode = m_Bus.Read(pc),
+        .A = m_CPU.A, .F = m_CPU.Flags,
+        .B = m_CPU.B, .C = m_CPU.C,
+        .D = m_CPU.D, .E = m_CPU.E,
+        .H = m_CPU.H, .L = m_CPU.L,
+        .Reserved = 0,
+    });
+}
 
-    return file.good();
+bool GameBoy::SaveState(std::string_view path) const
+{
+    std::ofstream file{std::string(path), std::ios::binary};
+    if (!file) return false;
+    return SaveState(file);
 }
 
 bool GameBoy::LoadState(std::string_view path)
 {
     std::ifstream file{std::string(path), std::ios::binary};
     if (!file) return false;
+    return LoadState(file);
+}
 
+std::vector<state::Section> GameBoy::CaptureState() const
+{
+    std::vector<state::Section> sections;
+    sections.reserve(SectionOrder.size());
+    std::ostringstream clock;
+    state::Write(clock, m_Bus.GetMasterClock());
+    state::Write(clock, m_Bus.GetCpuCycles());
+    const std::string clockBytes = std::move(clock).str();
+    sections.push_back({ClockSection, SectionVersion, {clockBytes.begin(), clockBytes.end()}});
+    sections.push_back(CaptureSection(CpuSection, m_CPU));
+    sections.push_back(CaptureSection(BusSection, m_Bus));
+    sections.push_back(CaptureSection(TimerSection, m_Timer));
+    sections.push_back(CaptureSection(PpuSection, m_PPU));
+    sections.push_back(CaptureSection(ApuSection, m_APU));
+    sections.push_back(CaptureSection(CartridgeSection, m_Cartridge));
+    return sections;
+}
+
+U64 GameBoy::StateHash() const
+{
+    hash::Xxh64 hasher;
+    hasher.Add(m_Model, m_Bus.GetMasterClock());
+    m_CPU.Hash(hasher);
+    m_Bus.Hash(hasher);
+    m_Timer.Hash(hasher);
+    m_PPU.Hash(hasher);
+    m_APU.Hash(hasher);
+    m_Cartridge.Hash(hasher);
+    return hasher.Digest();
+}
+
+bool GameBoy::SaveState(std::ostream& out) const
+{
+    return state::WriteSections(out, CaptureState());
+}
+
+bool GameBoy::LoadState(std::istream& in)
+{
     U32 magic = 0;
     U8 version = 0;
-    state::Read(file, magic);
-    state::Read(file, version);
+    state::Read(in, magic);
+    state::Read(in, version);
 
-    if (magic != state::Magic || version != state::Version)
+    if (magic != state::Magic)
+        return false;
+    if (version == state::LegacyVersion)
+        return LoadLegacyState(in);
+    if (version != state::Version)
+        return false;
+
+    auto sections = state::ReadSections(in, SectionOrder);
+    if (!sections)
+    {
+        std::println(stderr, "{}", sections.error());
+        return false;
+    }
+    return RestoreState(*sections);
+}
+
+bool GameBoy::RestoreState(std::span<const state::Section> sections)
+{
+    // Everything is checked before anything is applied, so a bad snapshot
+    // leaves the machine as it was: missing sections, unknown versions and
+    // payloads of another length than their component reads are refused
+    std::array<const state::Section*, SectionOrder.size()> found{};
+    for (const auto& section : sections)
+    {
+        const auto slot = static_cast<Size>(std::ranges::find(SectionOrder, section.Id) - SectionOrder.begin());
+        if (slot == SectionOrder.size())
+            continue;
+        if (section.Version > LatestVersion(section.Id)
+            || section.Data.size() != PayloadSize(section.Id, section.Version, m_SectionSizes[slot]))
+            return false;
+        found[slot] = &section;
+    }
+    if (std::ranges::find(found.begin() + 1, found.end(), nullptr) != found.end())
         return false;
 
-    m_CPU.LoadState(file);
-    m_Bus.LoadState(file);
-    m_Timer.LoadState(file);
-    m_PPU.LoadState(file);
-    m_APU.LoadState(file);
-    m_Cartridge.LoadState(file);
+    bool good = true;
+    auto open = [&](Size slot) {
+        return std::ispanstream{std::span{reinterpret_cast<const char*>(found[slot]->Data.data()), found[slot]->Data.size()}};
+    };
+    auto load = [&](Size slot, auto& component) {
+        auto stream = open(slot);
+        component.LoadState(stream);
+        good = good && !stream.fail();
+    };
+    if (found[0])
+    {
+        auto stream = open(0);
+        U64 masterClock = 0;
+        U64 cpuCycles = 0;
+        state::Read(stream, masterClock);
+        state::Read(stream, cpuCycles);
+        m_Bus.SetMasterClock(masterClock);
+        m_Bus.SetCpuCycles(cpuCycles);
+        good = !stream.fail();
+    }
+    load(1, m_CPU);
+    load(2, m_Bus);
+    load(3, m_Timer);
+    {
+        auto stream = open(4);
+        m_PPU.LoadState(stream, found[4]->Version);
+        good = good && !stream.fail();
+    }
+    load(5, m_APU);
+    load(6, m_Cartridge);
+    return good;
+}
+
+bool GameBoy::LoadLegacyState(std::istream& in)
+{
+    m_CPU.LoadState(in);
+    m_Bus.LoadState(in);
+    m_Timer.LoadState(in);
+    m_PPU.LoadState(in, 1);
+    m_APU.LoadState(in);
+    m_Cartridge.LoadState(in);
 
-    return file.good();
+    return in.good();
 }
 
 } // namespace gb
@@ -1,7 +1,9 @@
 #include <gb_apu.hpp>
+#include <algorithm>
 #include <ostream>
 #include <istream>
 #include <state.hpp>
+#include <instrument.hpp>
 
 namespace gb {
 
@@ -266,31 +268,66 @@ U8 NoiseChannel::GetOutput() const {
 // APU
 // ============================================================================
 
-APU::APU() {
+APU::APU(const U64& clock)
+    : m_Clock{clock}
+    , m_Time{clock}
+    , m_NextFrameSequencer{clock + CyclesPerFrameSequencer}
+    , m_NextSample{clock << SampleTimerShift}
+{
     m_NR52 = 0xF1;  // Power on with sound enabled
+    SetResampleRatio(1.0);
 }
 
-void APU::Tick(U8 cycles) {
-    if (!(m_NR52 & 0x80))
-        return;
-
-    for (U8 i = 0; i < cycles; i++) {
-        TickChannels();
+void APU::SetResampleRatio(double ratio) {
+    const double period = static_cast<double>(CPUFrequency) * SampleTimerStep / (SampleRate * ratio);
+    const S32 previous = m_SamplePeriod;
+    m_SamplePeriod = static_cast<S32>(period + 0.5);
+    // Keep the progress towards the next sample
+    m_NextSample += m_SamplePeriod - previous;
+}
 
-        m_FrameSequencerTimer++;
-        if (m_FrameSequencerTimer >= CyclesPerFrameSequencer) {
-            m_FrameSequencerTimer -= CyclesPerFrameSequencer;
+void APU::Tick() {
+    if (m_Time == m_Clock)
+        return;
+    if (!(m_NR52 & 0x80)) {
+        // Powered off: the timers hold still
+        const U64 elapsed = m_Clock - m_Time;
+        m_NextFrameSequencer += elapsed;
+        m_NextSample += elapsed << SampleTimerShift;
+        m_Time = m_Clock;
+        return;
+    }
+    PHOSPHOR_SPAN(instrument::Zone::Synthesis);
+
+    const U64 until = m_Clock;
+    while (m_Time < until) {
+        // Channels run alone up to the next frame sequencer step or sample
+        const U64 sampleDue = (m_NextSample + SampleTimerStep - 1) >> SampleTimerShift;
+        const U64 next = std::min({until, m_NextFrameSequencer, std::max(sampleDue, m_Time + 1)});
+        for (U64 cycles = next - m_Time; cycles != 0; --cycles)
+            TickChannels();
+        m_Time = next;
+
+        if (m_Time >= m_NextFrameSequencer) {
+            m_NextFrameSequencer += CyclesPerFrameSequencer;
             TickFrameSequencer();
         }
 
-        m_SampleTimer++;
-        if (m_SampleTimer >= CyclesPerSample) {
-            m_SampleTimer -= CyclesPerSample;
+        if ((m_Time << SampleTimerShift) >= m_NextSample) {
+            m_NextSample += m_SamplePeriod;
             GenerateSample();
         }
     }
 }
 
+S32 APU::FrameSequencerTimer() const {
+    return CyclesPerFrameSequencer - static_cast<S32>(m_NextFrameSequencer - m_Time);
+}
+
+S32 APU::SampleTimer() const {
+    return m_SamplePeriod - static_cast<S32>(m_NextSample - (m_Time << SampleTimerShift));
+}
+
 void APU::TickChannels() {
     // Channel 1 (Square with sweep)
     if (m_Channel1.frequencyTimer > 0)
@@ -503,6 +540,13 @@ void LoadSquareChannel(std::istream& in, SquareChannel& ch) {
     state::Read(in, ch.sweepNegate);
 }
 
+void HashSquareChannel(hash::Xxh64& hasher, const SquareChannel& ch) {
+    hasher.Add(ch.sweep, ch.lengthDuty, ch.envelope, ch.freqLow, ch.freqHigh);
+    hasher.Add(ch.enabled, ch.dacEnabled, ch.frequencyTimer, ch.dutyPosition, ch.lengthCounter);
+    hasher.Add(ch.periodTimer, ch.currentVolume, ch.envelopeRunning);
+    hasher.Add(ch.sweepEnabled, ch.sweepFrequency, ch.sweepTimer, ch.sweepNegate);
+}
+
 } // anonymous namespace
 
 bool APU::Write(U16 address, U8 value) {
@@ -671,9 +715,25 @@ void APU::SaveState(std::ostream& out) const
     state::Write(out, m_NR50);
     state::Write(out, m_NR51);
     state::Write(out, m_NR52);
-    state::Write(out, m_FrameSequencerTimer);
+    state::Write(out, FrameSequencerTimer());
     state::Write(out, m_FrameSequencerStep);
-    state::Write(out, m_SampleTimer);
+    state::Write(out, SampleTimer());
+}
+
+void APU::Hash(hash::Xxh64& hasher) const
+{
+    HashSquareChannel(hasher, m_Channel1);
+    HashSquareChannel(hasher, m_Channel2);
+
+    hasher.Add(m_Channel3.dacEnable, m_Channel3.length, m_Channel3.volume, m_Channel3.freqLow, m_Channel3.freqHigh);
+    hasher.Add(m_Channel3.waveRAM, m_Channel3.enabled, m_Channel3.frequencyTimer, m_Channel3.positionCounter);
+    hasher.Add(m_Channel3.lengthCounter, m_Channel3.sampleBuffer);
+
+    hasher.Add(m_Channel4.length, m_Channel4.envelope, m_Channel4.polynomial, m_Channel4.control);
+    hasher.Add(m_Channel4.enabled, m_Channel4.dacEnabled, m_Channel4.frequencyTimer, m_Channel4.lengthCounter);
+    hasher.Add(m_Channel4.periodTimer, m_Channel4.currentVolume, m_Channel4.envelopeRunning, m_Channel4.lfsr);
+
+    hasher.Add(m_NR50, m_NR51, m_NR52, FrameSequencerTimer(), m_FrameSequencerStep, SampleTimer());
 }
 
 void APU::LoadState(std::istream& in)
@@ -712,10 +772,16 @@ void APU::LoadState(std::istream& in)
     state::Read(in, m_NR50);
     state::Read(in, m_NR51);
     state::Read(in, m_NR52);
-    state::Read(in, m_FrameSequencerTimer);
+    S32 frameSequencerTimer = 0;
+    S32 sampleTimer = 0;
+    state::Read(in, frameSequencerTimer);
     state::Read(in, m_FrameSequencerStep);
-    state::Read(in, m_SampleTimer);
+    state::Read(in, sampleTimer);
 
+    // Rebuild the deadlines from the restored clock
+    m_Time = m_Clock;
+    m_NextFrameSequencer = m_Time + static_cast<U64>(CyclesPerFrameSequencer - frameSequencerTimer);
+    m_NextSample = (m_Time << SampleTimerShift) + static_cast<U64>(static_cast<S64>(m_SamplePeriod) - sampleTimer);
     m_SampleIndex = 0;
 }
 
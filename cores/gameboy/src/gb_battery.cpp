@@ -0,0 +1,77 @@
+#include <gb_battery.hpp>
+#include <print>
+
+#include <file.hpp>
+#include <gb_cartridge.hpp>
+#include <instrument.hpp>
+
+namespace gb {
+
+BatterySaver::BatterySaver(Cartridge& cart)
+    : m_Cartridge{cart}
+    , m_Path{cart.SaveImagePath()}
+    , m_Mapped{cart.IsSaveMapped()}
+    , m_Image{cart.SaveImage()}
+{
+    // Start from a clean slate; earlier writes are already in the image
+    (void)m_Cartridge.CollectSave(m_Image);
+    m_Writer = std::jthread{[this](std::stop_token stop) { WriterLoop(stop); }};
+}
+
+BatterySaver::~BatterySaver()
+{
+    // Anything still pending is left to the final Cartridge::SaveRAM()
+    m_Writer.request_stop();
+    m_Wake.notify_all();
+}
+
+void BatterySaver::Collect()
+{
+    // Only contended while the writer snapshots the image
+    std::unique_lock lock{m_Mutex};
+    if (!m_Cartridge.CollectSave(m_Image))
+        return;
+
+    const auto now = Clock::now();
+    if (!m_Dirty)
+        m_FirstWrite = now;
+    m_Dirty = true;
+    m_LastWrite = now;
+    lock.unlock();
+    m_Wake.notify_one();
+}
+
+void BatterySaver::WriterLoop(std::stop_token stop)
+{
+    instrument::SetThreadName("Battery save");
+
+    std::vector<U8> image;
+    std::unique_lock lock{m_Mutex};
+    while (!stop.stop_requested())
+    {
+        if (!m_Dirty)
+        {
+            m_Wake.wait(lock, stop, [this] { return m_Dirty; });
+            continue;
+        }
+
+        const auto due = std::min(m_LastWrite + QuietPeriod, m_FirstWrite + MaxDelay);
+        if (Clock::now() < due)
+        {
+            // Further writes push the deadline out; re-check after waking
+            m_Wake.wait_until(lock, stop, due, [] { return false; });
+            continue;
+        }
+
+        image = m_Image;
+        m_Dirty = false;
+        lock.unlock();
+        if (m_Mapped && !m_Cartridge.SyncSave())
+            std::println(stderr, "Failed to sync save file: {}", m_Cartridge.SavePath().string());
+        if (!image.empty() && !file::WriteAtomic(m_Path, image))
+            std::println(stderr, "Failed to write save file: {}", m_Path.string());
+        lock.lock();
+    }
+}
+
+} // namespace gb
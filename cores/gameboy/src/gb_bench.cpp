@@ -0,0 +1,330 @@
+#include <gb_bench.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <initializer_list>
+#include <print>
+#include <vector>
+
+#include <gb.hpp>
+#include <gb_tests.hpp>
+
+namespace gb {
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using Seconds = std::chrono::duration<double>;
+
+    // Workloads run for a fixed cycle budget rather than until FrameReady,
+    // so LCD-off programs are measured the same way as everything else
+    constexpr U64 CyclesPerFrame = 70224;
+    constexpr U32 WarmupFrames = 30;
+    constexpr S32 Repeats = 3;
+
+    constexpr double NativeMHz = 4.194304;
+
+    // Minimal assembler for the generated workloads: a 32KB ROM-only image
+    // with a valid header that jumps to 0x0150
+    class RomBuilder {
+    public:
+        explicit RomBuilder(std::string_view title)
+            : m_Rom(0x8000, 0x00)
+        {
+            constexpr std::array<U8, 48> logo = {
+                0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B,
+                0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+                0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E,
+                0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+                0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC,
+                0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E
+            };
+
+            Org(0x0100);
+            Emit({0x00, 0xC3, 0x50, 0x01});  // NOP; JP $0150
+            std::copy(logo.begin(), logo.end(), m_Rom.begin() + 0x0104);
+            for (Size i = 0; i < title.size() && i < 16; ++i)
+                m_Rom[0x0134 + i] = static_cast<U8>(title[i]);
+            Org(0x0150);
+        }
+
+        void Org(U16 address) { m_Pc = address; }
+        [[nodiscard]] U16 Here() const { return m_Pc; }
+
+        void Emit(std::initializer_list<U8> bytes)
+        {
+            for (U8 byte : bytes)
+                m_Rom[m_Pc++] = byte;
+        }
+
+        // JR / JR cc back to an earlier label
+        void Jr(U8 opcode, U16 target)
+        {
+            const S32 offset = static_cast<S32>(target) - static_cast<S32>(m_Pc + 2);
+            Emit({opcode, static_cast<U8>(static_cast<S8>(offset))});
+        }
+
+        std::vector<U8> Finish()
+        {
+            U8 checksum = 0;
+            for (U16 address = 0x0134; address <= 0x014C; ++address)
+                checksum = static_cast<U8>(checksum - m_Rom[address] - 1);
+            m_Rom[0x014D] = checksum;
+            return std::move(m_Rom);
+        }
+
+    private:
+        std::vector<U8> m_Rom;
+        U16 m_Pc{0};
+    };
+
+    constexpr U8 JrNz = 0x20;
+    constexpr U8 Jr = 0x18;
+
+    // ALU, memory, stack and CB ops in a tight loop with the LCD off
+    std::vector<U8> CpuBoundRom()
+    {
+        RomBuilder rom{"BENCH CPU"};
+        rom.Emit({0xF3, 0x31, 0xFE, 0xFF});  // DI; LD SP,$FFFE
+        rom.Emit({0xAF, 0xE0, 0x40});        // LCD off
+
+        const U16 loop = rom.Here();
+        rom.Emit({0x21, 0x00, 0xC0});        // LD HL,$C000
+        rom.Emit({0x06, 0x00});              // LD B,0 (256 iterations)
+        const U16 inner = rom.Here();
+        rom.Emit({0x7E, 0x80, 0x07, 0x22});  // LD A,(HL); ADD A,B; RLCA; LD (HL+),A
+        rom.Emit({0xA9, 0x4F, 0xCB, 0x31});  // XOR C; LD C,A; SWAP C
+        rom.Emit({0xC5, 0xCD, 0x00, 0x02});  // PUSH BC; CALL $0200
+        rom.Emit({0xC1, 0x05});              // POP BC; DEC B
+        rom.Jr(JrNz, inner);
+        rom.Jr(Jr, loop);
+
+        rom.Org(0x0200);
+        rom.Emit({0x13, 0x7A, 0xB3});        // INC DE; LD A,D; OR E
+        rom.Emit({0xCB, 0x3F, 0xC9});        // SRL A; RET
+        return rom.Finish();
+    }
+
+    // BG, window and 40 8x16 sprites on every frame; the CPU sits in HALT
+    // apart from a VBlank handler that scrolls the background
+    std::vector<U8> PpuBoundRom()
+    {
+        RomBuilder rom{"BENCH PPU"};
+        rom.Org(0x0040);
+        rom.Emit({0xF0, 0x43, 0x3C, 0xE0, 0x43, 0xD9});  // SCX++; RETI
+
+        rom.Org(0x0150);
+        rom.Emit({0xF3, 0x31, 0xFE, 0xFF});  // DI; LD SP,$FFFE
+        rom.Emit({0xAF, 0xE0, 0x40});        // LCD off so VRAM and OAM are writable
+
+        // Tiles and both maps: $8000-$9FFF = L ^ H
+        rom.Emit({0x21, 0x00, 0x80, 0x01, 0x00, 0x20});
+        const U16 fill = rom.Here();
+        rom.Emit({0x7D, 0xAC, 0x22, 0x0B, 0x78, 0xB1});
+        rom.Jr(JrNz, fill);
+
+        // OAM: Y = 3n + 16, X = 4n, tile = n, flips from n
+        rom.Emit({0x21, 0x00, 0xFE, 0x06, 0x28});
+        const U16 oam = rom.Here();
+        rom.Emit({0x78, 0x87, 0x80, 0xC6, 0x10, 0x22});
+        rom.Emit({0x78, 0x87, 0x87, 0x22});
+        rom.Emit({0x78, 0x22});
+        rom.Emit({0x78, 0xE6, 0x60, 0x22});
+        rom.Emit({0x05});
+        rom.Jr(JrNz, oam);
+
+        rom.Emit({0x3E, 0xE4, 0xE0, 0x47, 0xE0, 0x48, 0xE0, 0x49});  // BGP, OBP0, OBP1
+        rom.Emit({0x3E, 0x28, 0xE0, 0x4A, 0x3E, 0x57, 0xE0, 0x4B});  // WY = 40, WX = 87
+        rom.Emit({0x3E, 0x01, 0xE0, 0xFF, 0xAF, 0xE0, 0x0F});        // IE = VBlank, IF = 0
+        rom.Emit({0x3E, 0xF7, 0xE0, 0x40, 0xFB});                    // LCD on, everything enabled; EI
+
+        const U16 halt = rom.Here();
+        rom.Emit({0x76});
+        rom.Jr(Jr, halt);
+        return rom.Finish();
+    }
+
+    // All four channels running, retriggered with new frequencies every VBlank
+    std::vector<U8> ApuBoundRom()
+    {
+        RomBuilder rom{"BENCH APU"};
+        rom.Org(0x0040);
+        rom.Emit({0xC3, 0x00, 0x02});        // JP $0200
+
+        rom.Org(0x0150);
+        rom.Emit({0xF3, 0x31, 0xFE, 0xFF});  // DI; LD SP,$FFFE
+        rom.Emit({0x3E, 0x80, 0xE0, 0x26});  // NR52: power on
+        rom.Emit({0x3E, 0x77, 0xE0, 0x24});  // NR50: full volume
+        rom.Emit({0x3E, 0xFF, 0xE0, 0x25});  // NR51: all channels both sides
+        rom.Emit({0x3E, 0x15, 0xE0, 0x10, 0x3E, 0x80, 0xE0, 0x11, 0x3E, 0xF3, 0xE0, 0x12});  // CH1
+        rom.Emit({0x3E, 0x40, 0xE0, 0x16, 0x3E, 0xF1, 0xE0, 0x17});                          // CH2
+
+        // Wave RAM with the DAC off
+        rom.Emit({0xAF, 0xE0, 0x1A, 0x21, 0x30, 0xFF, 0x06, 0x10});
+        const U16 wave = rom.Here();
+        rom.Emit({0x78, 0xCB, 0x37, 0xB0, 0x22, 0x05});  // LD A,B; SWAP A; OR B; LD (HL+),A; DEC B
+        rom.Jr(JrNz, wave);
+        rom.Emit({0x3E, 0x80, 0xE0, 0x1A, 0x3E, 0x20, 0xE0, 0x1C});  // CH3 DAC on, 100%
+        rom.Emit({0x3E, 0xF2, 0xE0, 0x21, 0x3E, 0x45, 0xE0, 0x22});  // CH4
+
+        rom.Emit({0x3E, 0x01, 0xE0, 0xFF, 0xAF, 0xE0, 0x0F});  // IE = VBlank, IF = 0
+        rom.Emit({0x3E, 0x80, 0xE0, 0x40, 0xFB});              // LCD on, nothing drawn; EI
+
+        const U16 halt = rom.Here();
+        rom.Emit({0x76});
+        rom.Jr(Jr, halt);
+
+        // VBlank: step the shared frequency and retrigger every channel
+        rom.Org(0x0200);
+        rom.Emit({0xF5, 0xF0, 0x80, 0xC6, 0x25, 0xE0, 0x80});  // PUSH AF; HRAM counter += $25
+        rom.Emit({0xE0, 0x13, 0xE0, 0x18, 0xE0, 0x1D});        // NR13, NR23, NR33
+        rom.Emit({0x3E, 0x87, 0xE0, 0x14, 0xE0, 0x19, 0xE0, 0x1E});
+        rom.Emit({0x3E, 0x80, 0xE0, 0x23});
+        rom.Emit({0xF1, 0xD9});                                // POP AF; RETI
+        return rom.Finish();
+    }
+
+    struct Workload {
+        std::string Name;
+        Cartridge Cart;
+    };
+
+    struct BenchResult {
+        std::string Name;
+        U32 Frames{};
+        double Seconds{};
+        U64 Cycles{};
+        U64 Instructions{};
+    };
+
+    U64 RunCycles(GameBoy& gb, U64 budget, U64& instructions)
+    {
+        const U64 cycles = gb.RunUntil([&] {
+            if (!gb.GetCPU().IsHalted())
+                ++instructions;
+            return false;
+        }, budget);
+        // Mirror the frontend so sample generation stays in the measurement
+        gb.GetAPU().ClearBuffer();
+        return cycles;
+    }
+
+    BenchResult Measure(const Workload& workload, U32 frames)
+    {
+        BenchResult best{workload.Name, frames};
+
+        for (S32 run = 0; run < Repeats; ++run)
+        {
+            GameBoy gb{Cartridge{workload.Cart}};
+            U64 instructions = 0;
+            for (U32 frame = 0; frame < WarmupFrames; ++frame)
+                RunCycles(gb, CyclesPerFrame, instructions);
+
+            instructions = 0;
+            U64 cycles = 0;
+            const auto start = Clock::now();
+            for (U32 frame = 0; frame < frames; ++frame)
+                cycles += RunCycles(gb, CyclesPerFrame, instructions);
+            const double seconds = Seconds{Clock::now() - start}.count();
+
+            if (run == 0 || seconds < best.Seconds)
+            {
+                best.Seconds = seconds;
+                best.Cycles = cycles;
+                best.Instructions = instructions;
+            }
+        }
+        return best;
+    }
+
+    std::string JsonEscape(std::string_view text)
+    {
+        std::string escaped;
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                escaped.push_back('\\');
+            escaped.push_back(c);
+        }
+        return escaped;
+    }
+}
+
+S32 RunBenchmarks(const BenchOptions& options)
+{
+    std::vector<Workload> workloads;
+
+    const std::pair<const char*, std::vector<U8>(*)()> synthetic[] = {
+        {"synthetic/cpu", CpuBoundRom},
+        {"synthetic/ppu", PpuBoundRom},
+        {"synthetic/apu", ApuBoundRom},
+    };
+    for (const auto& [name, build] : synthetic)
+    {
+        auto cart = Cartridge::FromData(build());
+        if (!cart)
+        {
+            std::println(stderr, "{}: {}", name, cart.error());
+            return 1;
+        }
+        workloads.push_back({name, std::move(*cart)});
+    }
+
+    for (const auto& test : TestRoms())
+    {
+        auto cart = Cartridge::Load((std::filesystem::path(options.TestRomsDir) / test).string());
+        if (!cart)
+        {
+            if (!options.Json)
+                std::println("{}: SKIP", test);
+            continue;
+        }
+        workloads.push_back({test, std::move(*cart)});
+    }
+
+    if (!options.Json)
+        std::println("{:<48} {:>12} {:>9} {:>9} {:>12}", "Workload", "ns/frame", "MHz", "speed", "Minstr/s");
+
+    std::vector<BenchResult> results;
+    for (const auto& workload : workloads)
+    {
+        const auto& result = results.emplace_back(Measure(workload, options.Frames));
+        if (options.Json)
+            continue;
+
+        const double mhz = static_cast<double>(result.Cycles) / result.Seconds / 1e6;
+        std::println("{:<48} {:>12.0f} {:>9.2f} {:>8.1f}x {:>12.2f}",
+            result.Name,
+            result.Seconds * 1e9 / result.Frames,
+            mhz,
+            mhz / NativeMHz,
+            static_cast<double>(result.Instructions) / result.Seconds / 1e6);
+    }
+
+    if (options.Json)
+    {
+        std::println("{{");
+        std::println("  \"frames\": {},", options.Frames);
+        std::println("  \"repeats\": {},", Repeats);
+        std::println("  \"workloads\": [");
+        for (Size i = 0; i < results.size(); ++i)
+        {
+            const auto& result = results[i];
+            std::println("    {{\"name\": \"{}\", \"seconds\": {:.6f}, \"ns_per_frame\": {:.1f}, "
+                "\"mhz\": {:.3f}, \"instructions_per_second\": {:.0f}, \"cycles\": {}, \"instructions\": {}}}{}",
+                JsonEscape(result.Name),
+                result.Seconds,
+                result.Seconds * 1e9 / result.Frames,
+                static_cast<double>(result.Cycles) / result.Seconds / 1e6,
+                static_cast<double>(result.Instructions) / result.Seconds,
+                result.Cycles,
+                result.Instructions,
+                i + 1 < results.size() ? "," : "");
+        }
+        std::println("  ]");
+        std::println("}}");
+    }
+
+    return 0;
+}
+
+} // namespace gb
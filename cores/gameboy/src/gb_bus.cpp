@@ -8,31 +8,39 @@
 
 namespace gb {
 
-Bus::Bus(Cartridge& cart, Timer& timer, PPU& ppu, APU& apu, bool cgbMode)
+Bus::Bus(Cartridge& cart, Timer& timer, PPU& ppu, APU& apu, U64& masterClock, U64& cpuCycles, bool cgbMode)
     : m_Cartridge{cart}
     , m_Timer{timer}
     , m_PPU{ppu}
     , m_APU{apu}
+    , m_MasterClock{masterClock}
+    , m_CpuCycles{cpuCycles}
     , m_CgbMode{cgbMode}
 {
 }
 
+template<Model M>
 void Bus::Tick()
 {
-    m_CycleCount += 4;
+    constexpr bool cgb = M == Model::Cgb;
+    m_CpuCycles += 4;
 
-    m_Timer.Tick(4);  // Timer always runs at CPU speed
-    if (m_Timer.InterruptRequested())
+    // Timer always runs at CPU speed; it needs a look only when TIMA
+    // overflows or a write raised its interrupt
+    if (m_CpuCycles >= m_Timer.NextEvent() && m_Timer.InterruptRequested()) [[unlikely]]
         m_IoRegisters[0x0F] |= 0x04;  // Timer interrupt = bit 2
 
-    const U8 ppuCycles = m_DoubleSpeed ? 2 : 4;  // PPU stays at 4MHz
-    m_PPU.Tick(ppuCycles);
+    const U8 ppuCycles = (cgb && m_DoubleSpeed) ? 2 : 4;  // PPU stays at 4MHz
+    m_MasterClock += ppuCycles;
+    m_PPU.Tick<M>();
     if (m_PPU.VBlankInterruptRequested())
         m_IoRegisters[0x0F] |= 0x01;  // VBlank interrupt = bit 0
     if (m_PPU.StatInterruptRequested())
         m_IoRegisters[0x0F] |= 0x02;  // STAT interrupt = bit 1
 
-    m_APU.Tick(ppuCycles);  // APU stays at 4MHz
+    // A transfer clocked by the linked peer reaches this side
+    if (m_MasterClock >= m_LinkDue) [[unlikely]]
+        m_Link->Service();
 
     // Serial transfer: count down and fire interrupt when done
     if (m_SerialTransferring)
@@ -40,7 +48,7 @@ void Bus::Tick()
         if (m_SerialCycles <= 4)
         {
             m_SerialTransferring = false;
-            m_IoRegisters[0x01] = 0xFF;           // SB = 0xFF (no device connected)
+            m_IoRegisters[0x01] = m_Link ? m_Link->CompleteTransfer() : 0xFF;  // 0xFF: no device connected
             m_IoRegisters[0x02] &= 0x7F;          // Clear bit 7 of SC (transfer complete)
             m_IoRegisters[0x0F] |= 0x08;          // Serial interrupt = bit 3
         }
@@ -53,10 +61,10 @@ void Bus::Tick()
     // CGB HBlank DMA: transfer 16 bytes when HBlank starts
     // Always consume the flag to prevent stale triggers
     const bool hblankStarted = m_PPU.HBlankStarted();
-    if (m_HdmaActive && hblankStarted)
+    if (cgb && m_HdmaActive && hblankStarted)
     {
         for (U16 i = 0; i < 16; i++)
-            m_PPU.WriteVRAM(m_HdmaDst + i, Read(static_cast<U16>(m_HdmaSrc + i)));
+            m_PPU.WriteVRAM<M>(m_HdmaDst + i, Read<M>(static_cast<U16>(m_HdmaSrc + i)));
         m_HdmaSrc += 16;
         m_HdmaDst += 16;
         if (m_HdmaLength == 0)
@@ -71,25 +79,27 @@ void Bus::Tick()
     }
 }
 
+template<Model M>
 U8 Bus::Read(U16 address) const {
+    constexpr bool cgb = M == Model::Cgb;
 
     if (address <= 0x7FFF) {
         return m_Cartridge.Read(address);
     }
     if (address <= 0x9FFF) {
-        return m_PPU.ReadVRAM(address - 0x8000);
+        return m_PPU.ReadVRAM<M>(address - 0x8000);
     }
     if (address <= 0xBFFF) {
         return m_Cartridge.ReadRAM(address);
     }
     if (address <= 0xDFFF) {
-        if (m_CgbMode && address >= 0xD000)
+        if (cgb && address >= 0xD000)
             return m_WorkRam[m_WramBank * 0x1000 + (address - 0xD000)];
         return m_WorkRam[address - 0xC000];
     }
     if (address <= 0xFDFF) {
         U16 mirrored = address - 0x2000;
-        if (m_CgbMode && mirrored >= 0xD000)
+        if (cgb && mirrored >= 0xD000)
             return m_WorkRam[m_WramBank * 0x1000 + (mirrored - 0xD000)];
         return m_WorkRam[mirrored - 0xC000];
     }
@@ -102,11 +112,13 @@ U8 Bus::Read(U16 address) const {
     if (address <= 0xFF7F) {
         if (address == 0xFF00) return m_Joypad.Read();
         if (address == 0xFF0F) return m_IoRegisters[0x0F] | 0xE0;  // IF: bits 5-7 always read as 1
-        if (address == 0xFF70 && m_CgbMode) return m_WramBank | 0xF8;
-        if (address == 0xFF55 && m_CgbMode) return m_HdmaLength | (m_HdmaActive ? 0x00 : 0x80);
-        if (address == 0xFF4D && m_CgbMode) return (m_DoubleSpeed ? 0x80 : 0x00) | (m_SpeedSwitch ? 0x01 : 0x00) | 0x7E;
+        if (address == 0xFF70 && cgb) return m_WramBank | 0xF8;
+        if (address == 0xFF55 && cgb) return m_HdmaLength | (m_HdmaActive ? 0x00 : 0x80);
+        if (address == 0xFF4D && cgb) return (m_DoubleSpeed ? 0x80 : 0x00) | (m_SpeedSwitch ? 0x01 : 0x00) | 0x7E;
         if (auto v = m_Timer.Read(address)) return *v;
         if (auto v = m_PPU.Read(address)) return *v;
+        if (address >= ApuFirst && address <= ApuLast)
+            m_APU.Tick();  // Catch up before the channel status or wave RAM is seen
         if (auto v = m_APU.Read(address)) return *v;
         return m_IoRegisters[address - 0xFF00];
     }
@@ -116,7 +128,9 @@ U8 Bus::Read(U16 address) const {
     return m_InterruptEnable;
 }
 
+template<Model M>
 void Bus::Write(U16 address, U8 value) {
+    constexpr bool cgb = M == Model::Cgb;
     // Serial: handle SC (0xFF02) writes
     if (address == 0xFF02)
     {
@@ -126,13 +140,10 @@ void Bus::Write(U16 address, U8 value) {
         if ((value & 0x81) == 0x81)
         {
             const char c = static_cast<char>(m_IoRegisters[0x01]);
-            m_SerialBuffer += c;
-            if (m_SerialBuffer.find("Passed") != std::string::npos)
-                m_TestResult = TestResult::Passed;
-            else if (m_SerialBuffer.find("Failed") != std::string::npos)
-                m_TestResult = TestResult::Failed;
-            if (m_SerialBuffer.size() > 100)
-                m_SerialBuffer = m_SerialBuffer.substr(50);
+            if (m_SerialPassed.Feed(c))
+                SetTestResult(TestResult::Passed);
+            if (m_SerialFailed.Feed(c))
+                SetTestResult(TestResult::Failed);
         }
 
         // Start transfer if bit 7 (start) and bit 0 (internal clock) are set
@@ -140,7 +151,14 @@ void Bus::Write(U16 address, U8 value) {
         {
             m_SerialTransferring = true;
             // CGB fast serial (bit 1): 32 T-cycles; normal: 1024 T-cycles
-            m_SerialCycles = (m_CgbMode && (value & 0x02)) ? 32 : 1024;
+            m_SerialCycles = (cgb && (value & 0x02)) ? 32 : 1024;
+            if (m_Link)
+            {
+                // Counted down from the next M-cycle on, which advances the
+                // master clock at PPU speed
+                const U64 step = (cgb && m_DoubleSpeed) ? 2 : 4;
+                m_Link->BeginTransfer(m_MasterClock + m_SerialCycles / 4 * step, m_IoRegisters[0x01]);
+            }
         }
         return;
     }
@@ -149,26 +167,19 @@ void Bus::Write(U16 address, U8 value) {
         return;
     }
     if (address <= 0x9FFF) {
-        m_PPU.WriteVRAM(address - 0x8000, value);
+        m_PPU.WriteVRAM<M>(address - 0x8000, value);
         return;
     }
     if (address <= 0xBFFF) {
         m_Cartridge.WriteRAM(address, value);
         return;
     }
-    if (address <= 0xDFFF) {
-        if (m_CgbMode && address >= 0xD000)
-            m_WorkRam[m_WramBank * 0x1000 + (address - 0xD000)] = value;
-        else
-            m_WorkRam[address - 0xC000] = value;
-        return;
-    }
     if (address <= 0xFDFF) {
-        U16 mirrored = address - 0x2000;
-        if (m_CgbMode && mirrored >= 0xD000)
-            m_WorkRam[m_WramBank * 0x1000 + (mirrored - 0xD000)] = value;
-        else
-            m_WorkRam[mirrored - 0xC000] = value;
+        // 0xE000-0xFDFF mirrors 0xC000-0xDDFF
+        const U16 wram = address >= 0xE000 ? address - 0x2000 : address;
+        const Size offset = cgb && wram >= 0xD000 ? m_WramBank * 0x1000 + (wram - 0xD000) : wram - 0xC000;
+        m_WorkRam[offset] = value;
+        m_WorkRamHashes.MarkDirty(offset);
         return;
     }
     if (address <= 0xFE9F) {
@@ -180,7 +191,7 @@ void Bus::Write(U16 address, U8 value) {
     }
     if (address <= 0xFF7F) {
         if (address == 0xFF00) { m_Joypad.Write(value); return; }
-        if (address == 0xFF70 && m_CgbMode) {
+        if (address == 0xFF70 && cgb) {
             m_WramBank = value & 0x07;
             if (m_WramBank == 0) m_WramBank = 1;
             m_IoRegisters[0x70] = value;
@@ -190,12 +201,12 @@ void Bus::Write(U16 address, U8 value) {
             // OAM DMA Transfer: copy 160 bytes from (value * 0x100) to OAM
             U16 src = static_cast<U16>(value) << 8;
             for (U16 i = 0; i < 160; i++) {
-                m_PPU.WriteOAM(i, Read(static_cast<U16>(src + i)));
+                m_PPU.WriteOAM(i, Read<M>(static_cast<U16>(src + i)));
             }
             m_IoRegisters[0x46] = value;
             return;
         }
-        if (m_CgbMode) {
+        if constexpr (cgb) {
             if (address == 0xFF4D) { m_SpeedSwitch = value & 0x01; return; }
             if (address == 0xFF51) { m_HdmaSrc = (m_HdmaSrc & 0x00FF) | (static_cast<U16>(value) << 8); return; }
             if (address == 0xFF52) { m_HdmaSrc = (m_HdmaSrc & 0xFF00) | (value & 0xF0); return; }
@@ -219,7 +230,7 @@ void Bus::Write(U16 address, U8 value) {
                     m_HdmaMode = false;
                     U16 length = (static_cast<U16>(m_HdmaLength) + 1) * 16;
                     for (U16 i = 0; i < length; i++) {
-                        m_PPU.WriteVRAM(m_HdmaDst + i, Read(static_cast<U16>(m_HdmaSrc + i)));
+                        m_PPU.WriteVRAM<M>(m_HdmaDst + i, Read<M>(static_cast<U16>(m_HdmaSrc + i)));
                     }
                     m_HdmaSrc += length;
                     m_HdmaDst += length;
@@ -230,6 +241,8 @@ void Bus::Write(U16 address, U8 value) {
         }
         if (m_Timer.Write(address, value)) return;
         if (m_PPU.Write(address, value)) return;
+        if (address >= ApuFirst && address <= ApuLast)
+            m_APU.Tick();  // Catch up so the write lands on its cycle
         if (m_APU.Write(address, value)) return;
         m_IoRegisters[address - 0xFF00] = value;
         return;
@@ -248,6 +261,18 @@ void Bus::PerformSpeedSwitch()
     m_Timer.ResetDiv();
 }
 
+U8 Bus::ShiftExternal(U8 in)
+{
+    // Only SC with transfer requested (bit 7) and external clock (bit 0 clear) shifts
+    if ((m_IoRegisters[0x02] & 0x81) != 0x80)
+        return 0xFF;
+    const U8 out = m_IoRegisters[0x01];
+    m_IoRegisters[0x01] = in;
+    m_IoRegisters[0x02] &= 0x7F;  // Transfer complete
+    m_IoRegisters[0x0F] |= 0x08;  // Serial interrupt = bit 3
+    return out;
+}
+
 void Bus::SaveState(std::ostream& out) const
 {
     state::Write(out, m_WorkRam);
@@ -269,9 +294,19 @@ void Bus::SaveState(std::ostream& out) const
     state::Write(out, m_SerialCycles);
 }
 
+void Bus::Hash(hash::Xxh64& hasher) const
+{
+    hasher.Add(m_WorkRamHashes.Digest(m_WorkRam), m_IoRegisters, m_HighRam, m_InterruptEnable);
+    m_Joypad.Hash(hasher);
+    hasher.Add(m_WramBank, m_DoubleSpeed, m_SpeedSwitch);
+    hasher.Add(m_HdmaSrc, m_HdmaDst, m_HdmaLength, m_HdmaActive, m_HdmaMode);
+    hasher.Add(m_SerialTransferring, m_SerialCycles);
+}
+
 void Bus::LoadState(std::istream& in)
 {
     state::Read(in, m_WorkRam);
+    m_WorkRamHashes.MarkAllDirty();
     state::Read(in, m_IoRegisters);
     state::Read(in, m_HighRam);
     state::Read(in, m_InterruptEnable);
@@ -290,4 +325,11 @@ void Bus::LoadState(std::istream& in)
     state::Read(in, m_SerialCycles);
 }
 
+template void Bus::Tick<Model::Dmg>();
+template void Bus::Tick<Model::Cgb>();
+template U8 Bus::Read<Model::Dmg>(U16 address) const;
+template U8 Bus::Read<Model::Cgb>(U16 address) const;
+template void Bus::Write<Model::Dmg>(U16 address, U8 value);
+template void Bus::Write<Model::Cgb>(U16 address, U8 value);
+
 } // namespace gb
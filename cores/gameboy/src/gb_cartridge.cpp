@@ -1,10 +1,12 @@
 #include <gb_cartridge.hpp>
 
-#include <ctime>
+#include <algorithm>
 #include <fstream>
 #include <format>
 #include <ostream>
 #include <istream>
+#include <sstream>
+#include <file.hpp>
 #include <state.hpp>
 
 namespace gb {
@@ -26,6 +28,7 @@ namespace {
     constexpr U16 VersionOffset = 0x014C;
     constexpr U16 HeaderChecksumOffset = 0x014D;
     constexpr U16 GlobalChecksumOffset = 0x014E;
+    constexpr Size MinRomSize = 0x0150;  // Must at least cover the header
 
     constexpr std::array<U8, 48> ValidNintendoLogo = {
         0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B,
@@ -38,6 +41,17 @@ namespace {
 }
 
 std::expected<Cartridge, std::string> Cartridge::Load(std::string_view path) {
+    auto cart = LoadRom(path);
+    if (!cart) {
+        return cart;
+    }
+
+    cart->m_SavePath = std::filesystem::path(path).replace_extension(".sav");
+    cart->LoadSaveRAM();
+    return cart;
+}
+
+std::expected<Cartridge, std::string> Cartridge::LoadRom(std::string_view path) {
     std::ifstream file{std::string(path), std::ios::binary};
 
     if (!file) {
@@ -48,20 +62,46 @@ std::expected<Cartridge, std::string> Cartridge::Load(std::string_view path) {
     const auto size = file.tellg();
     file.seekg(0, std::ios::beg);
 
-    Cartridge cart;
-    cart.m_Data.resize(size);
+    std::vector<U8> data(static_cast<Size>(size));
 
-    if (!file.read(reinterpret_cast<char*>(cart.m_Data.data()), size)) {
+    if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
         return std::unexpected(std::format("Failed to read ROM: {}", path));
     }
 
-    cart.m_SavePath = std::filesystem::path(path).replace_extension(".sav");
+    auto cart = FromData(std::move(data));
+    if (!cart) {
+        return std::unexpected(std::format("{}: {}", cart.error(), path));
+    }
+    return cart;
+}
+
+std::expected<Cartridge, std::string> Cartridge::FromData(std::vector<U8> data) {
+    if (data.size() < MinRomSize) {
+        return std::unexpected(std::format("ROM too small ({} bytes)", data.size()));
+    }
+
+    Cartridge cart;
+    cart.m_RomSize = data.size();
+    // Whole banks, so mapped windows never run past the end
+    const Size banks = std::max<Size>((data.size() + Mapper::RomBankSize - 1) / Mapper::RomBankSize, 2);
+    data.resize(banks * Mapper::RomBankSize, 0xFF);
+    cart.m_Data = std::move(data);
     cart.ParseHeader();
     cart.InitMBC();
-    cart.LoadSaveRAM();
     return cart;
 }
 
+Cartridge::Cartridge(const Cartridge& other)
+    : m_Data{other.m_Data}
+    , m_RomSize{other.m_RomSize}
+    , m_RAM(other.Ram().begin(), other.Ram().end())
+    , m_Header{other.m_Header}
+    , m_SavePath{other.m_SavePath}
+    , m_Mapper{other.m_Mapper->Clone()}
+    , m_HasBattery{other.m_HasBattery} {
+    m_Mapper->Attach(m_Data, m_RAM);
+}
+
 void Cartridge::ParseHeader() {
     for (Size i = 0; i < 4; ++i) {
         m_Header.EntryPoint[i] = m_Data[EntryPointOffset + i];
@@ -102,13 +142,7 @@ void Cartridge::ParseHeader() {
 }
 
 void Cartridge::InitMBC() {
-    switch (m_Header.CartridgeType) {
-        case 0x00: m_MBCType = MBCType::None; break;
-        case 0x01: case 0x02: case 0x03: m_MBCType = MBCType::MBC1; break;
-        case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13: m_MBCType = MBCType::MBC3; break;
-        case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E: m_MBCType = MBCType::MBC5; break;
-        default: m_MBCType = MBCType::None; break;
-    }
+    m_Mapper = Mapper::Create(m_Header.CartridgeType);
 
     switch (m_Header.CartridgeType) {
         case 0x03:                  // MBC1+RAM+BATTERY
@@ -125,11 +159,6 @@ void Cartridge::InitMBC() {
             break;
     }
 
-    m_HasRTC = (m_Header.CartridgeType == 0x0F || m_Header.CartridgeType == 0x10);
-    if (m_HasRTC) {
-        m_RTCBaseTimestamp = std::time(nullptr);
-    }
-
     Size ramSize = 0;
     switch (m_Header.RamSize) {
         case 0x00: ramSize = 0; break;
@@ -141,392 +170,195 @@ void Cartridge::InitMBC() {
         default: ramSize = 0; break;
     }
     m_RAM.resize(ramSize, 0);
+    m_Mapper->Attach(m_Data, Ram());
 }
 
-U8 Cartridge::Read(U16 address) const {
-    if (m_MBCType == MBCType::None) {
-        if (address < m_Data.size()) {
-            return m_Data[address];
-        }
-        return 0xFF;
-    }
-
-    // ROM Bank 0 (0x0000-0x3FFF)
-    if (address <= 0x3FFF) {
-        if (m_MBCType == MBCType::MBC1 && m_BankingMode && m_Data.size() > 0x100000) {
-            // MBC1 Mode 1 with >1MB ROM: upper bits affect bank 0 area
-            U32 bankOffset = (static_cast<U32>(m_RamBank) << 5) * 0x4000;
-            U32 fullAddress = bankOffset + address;
-            if (fullAddress < m_Data.size()) {
-                return m_Data[fullAddress];
-            }
-            return 0xFF;
-        }
-        return m_Data[address];
-    }
-
-    // ROM Bank N (0x4000-0x7FFF)
-    if (address <= 0x7FFF) {
-        U32 bank = m_RomBank;
-
-        if (m_MBCType == MBCType::MBC1 && m_Data.size() > 0x100000) {
-            // MBC1 with >1MB ROM: include upper 2 bits
-            bank |= (static_cast<U32>(m_RamBank) << 5);
-        }
-
-        U32 bankOffset = bank * 0x4000;
-        U32 fullAddress = bankOffset + (address - 0x4000);
-
-        // Wrap around if address exceeds ROM size
-        if (fullAddress >= m_Data.size()) {
-            fullAddress %= m_Data.size();
-        }
+bool Cartridge::ValidateLogo() const {
+    return m_Header.NintendoLogo == ValidNintendoLogo;
+}
 
-        return m_Data[fullAddress];
+bool Cartridge::ValidateHeaderChecksum() const {
+    U8 checksum = 0;
+    for (U16 address = 0x0134; address <= 0x014C; ++address) {
+        checksum = checksum - m_Data[address] - 1;
     }
-
-    return 0xFF;
+    return checksum == m_Header.HeaderChecksum;
 }
 
-void Cartridge::Write(U16 address, U8 value) {
-    if (m_MBCType == MBCType::None) {
-        return; // No MBC, writes to ROM area are ignored
+void Cartridge::UseEmulatedClock(const U64& masterClock, S64 epoch) {
+    if (Rtc* rtc = m_Mapper->Clock()) {
+        rtc->UseEmulatedClock(masterClock, epoch);
     }
+}
 
-    if (m_MBCType == MBCType::MBC1) {
-        // MBC1 register writes
-        if (address <= 0x1FFF) {
-            m_RamEnabled = (value & 0x0F) == 0x0A;
-        }
-        else if (address <= 0x3FFF) {
-            U16 bank = value & 0x1F;
-            if (bank == 0) bank = 1;
-            m_RomBank = bank;
-        }
-        else if (address <= 0x5FFF) {
-            m_RamBank = value & 0x03;
-        }
-        else if (address <= 0x7FFF) {
-            m_BankingMode = (value & 0x01) != 0;
-        }
-    }
-    else if (m_MBCType == MBCType::MBC3) {
-        // MBC3 register writes
-        if (address <= 0x1FFF) {
-            m_RamEnabled = (value & 0x0F) == 0x0A;
-        }
-        else if (address <= 0x3FFF) {
-            // ROM Bank Number (7 bits, 0x00-0x7F)
-            U16 bank = value & 0x7F;
-            if (bank == 0) bank = 1;
-            m_RomBank = bank;
-        }
-        else if (address <= 0x5FFF) {
-            // RAM Bank Number (0x00-0x03) or RTC Register Select (0x08-0x0C)
-            m_RamBank = value;
-        }
-        else if (address <= 0x7FFF) {
-            if (m_HasRTC && m_RTCLatchPrev == 0x00 && value == 0x01) {
-                UpdateRTCRegisters();
-                m_LatchedRTC = m_RTC;
-            }
-            m_RTCLatchPrev = value;
-        }
-    }
-    else if (m_MBCType == MBCType::MBC5) {
-        // MBC5 register writes
-        if (address <= 0x1FFF) {
-            m_RamEnabled = (value & 0x0F) == 0x0A;
-        }
-        else if (address <= 0x2FFF) {
-            // ROM Bank Number - Low 8 bits
-            m_RomBank = (m_RomBank & 0x100) | value;
-        }
-        else if (address <= 0x3FFF) {
-            // ROM Bank Number - High bit
-            m_RomBank = (m_RomBank & 0xFF) | (static_cast<U16>(value & 0x01) << 8);
-        }
-        else if (address <= 0x5FFF) {
-            // RAM Bank Number (0x00-0x0F)
-            m_RamBank = value & 0x0F;
-        }
+void Cartridge::UseWallClock() {
+    if (Rtc* rtc = m_Mapper->Clock()) {
+        rtc->UseWallClock();
     }
 }
 
-U8 Cartridge::ReadRAM(U16 address) const {
-    if (!m_RamEnabled || m_RAM.empty()) {
-        return 0xFF;
-    }
+RtcMode Cartridge::GetRtcMode() const {
+    const Rtc* rtc = m_Mapper->Clock();
+    return rtc ? rtc->Mode() : RtcMode::Emulated;
+}
 
-    if (m_MBCType == MBCType::MBC3 && m_RamBank >= 0x08 && m_RamBank <= 0x0C) {
-        if (!m_HasRTC) return 0xFF;
-        switch (m_RamBank) {
-            case 0x08: return m_LatchedRTC.Seconds;
-            case 0x09: return m_LatchedRTC.Minutes;
-            case 0x0A: return m_LatchedRTC.Hours;
-            case 0x0B: return m_LatchedRTC.DaysLow;
-            case 0x0C: return m_LatchedRTC.DaysHigh;
-            default:   return 0xFF;
-        }
-    }
+void Cartridge::SetSavePath(std::filesystem::path path) {
+    m_SavePath = std::move(path);
+    LoadSaveRAM();
+}
 
-    U32 offset = address - 0xA000;
-    U8 ramBank = m_RamBank;
+void Cartridge::LoadSaveRAM() {
+    if (!m_HasBattery) return;
 
-    if (m_MBCType == MBCType::MBC1) {
-        // MBC1: RAM banking only in Mode 1
-        if (m_BankingMode && m_RAM.size() > 0x2000) {
-            offset += static_cast<U32>(ramBank & 0x03) * 0x2000;
-        }
-    }
-    else if (m_MBCType == MBCType::MBC3) {
-        // MBC3: 4 RAM banks (0x00-0x03)
-        if (m_RAM.size() > 0x2000) {
-            offset += static_cast<U32>(ramBank & 0x03) * 0x2000;
-        }
-    }
-    else if (m_MBCType == MBCType::MBC5) {
-        // MBC5: up to 16 RAM banks
-        if (m_RAM.size() > 0x2000) {
-            offset += static_cast<U32>(ramBank & 0x0F) * 0x2000;
-        }
-    }
+    std::ifstream file{m_SavePath, std::ios::binary};
+    if (!file) return;
 
-    if (offset >= m_RAM.size()) {
-        return 0xFF;
-    }
+    file.seekg(0, std::ios::end);
+    const auto fileSize = static_cast<Size>(file.tellg());
+    file.seekg(0, std::ios::beg);
 
-    return m_RAM[offset];
-}
+    Rtc* rtc = m_Mapper->Clock();
+    Size expectedSize = m_RAM.size() + (rtc ? Rtc::FileSize : 0);
+    if (fileSize != expectedSize && fileSize != m_RAM.size()) return;
 
-void Cartridge::WriteRAM(U16 address, U8 value) {
-    if (!m_RamEnabled) {
-        return;
+    if (!m_RAM.empty()) {
+        file.read(reinterpret_cast<char*>(m_RAM.data()), static_cast<std::streamsize>(m_RAM.size()));
+        m_Mapper->Attach(m_Data, Ram());  // Drops cached RAM page hashes
     }
 
-    if (m_MBCType == MBCType::MBC3 && m_RamBank >= 0x08 && m_RamBank <= 0x0C) {
-        if (!m_HasRTC) return;
-        // Sync before writing so we don't lose elapsed time
-        UpdateRTCRegisters();
-        switch (m_RamBank) {
-            case 0x08: m_RTC.Seconds = value & 0x3F; break;
-            case 0x09: m_RTC.Minutes = value & 0x3F; break;
-            case 0x0A: m_RTC.Hours = value & 0x1F; break;
-            case 0x0B: m_RTC.DaysLow = value; break;
-            case 0x0C: m_RTC.DaysHigh = value & 0xC1; break;
-        }
-        // Reset base timestamp to now with current register values
-        m_RTCBaseTimestamp = std::time(nullptr);
-        return;
+    if (rtc && fileSize >= m_RAM.size() + Rtc::FileSize) {
+        rtc->LoadFile(file);
     }
+}
 
-    if (m_RAM.empty()) {
-        return;
+std::expected<void, std::string> Cartridge::MapSaveFile() {
+    if (m_RamFile) return {};
+    if (!m_HasBattery || m_RAM.empty()) {
+        return std::unexpected(std::string{"Cartridge has no battery-backed RAM"});
+    }
+    if (m_SavePath.empty()) {
+        return std::unexpected(std::string{"Cartridge has no save file"});
     }
 
-    U32 offset = address - 0xA000;
-    U8 ramBank = m_RamBank;
+    // LoadSaveRAM() has already read a matching file (and a legacy RTC
+    // footer, which mapping at RAM size cuts off); anything else is replaced
+    std::error_code error;
+    const auto fileSize = std::filesystem::file_size(m_SavePath, error);
+    const bool matches = !error && (fileSize == m_RAM.size() || fileSize == m_RAM.size() + Rtc::FileSize);
 
-    if (m_MBCType == MBCType::MBC1) {
-        if (m_BankingMode && m_RAM.size() > 0x2000) {
-            offset += static_cast<U32>(ramBank & 0x03) * 0x2000;
-        }
+    auto mapped = file::MappedFile::Open(m_SavePath, m_RAM.size());
+    if (!mapped) {
+        return std::unexpected(mapped.error());
     }
-    else if (m_MBCType == MBCType::MBC3) {
-        if (m_RAM.size() > 0x2000) {
-            offset += static_cast<U32>(ramBank & 0x03) * 0x2000;
-        }
+    if (!matches) {
+        std::ranges::copy(m_RAM, mapped->Data().begin());
     }
-    else if (m_MBCType == MBCType::MBC5) {
-        if (m_RAM.size() > 0x2000) {
-            offset += static_cast<U32>(ramBank & 0x0F) * 0x2000;
+
+    if (Rtc* rtc = m_Mapper->Clock()) {
+        std::ifstream footer{RtcPath(), std::ios::binary};
+        if (footer && std::filesystem::file_size(RtcPath(), error) == Rtc::FileSize) {
+            rtc->LoadFile(footer);
         }
     }
 
-    if (offset < m_RAM.size()) {
-        m_RAM[offset] = value;
-    }
-}
+    m_RamFile = std::move(*mapped);
+    m_RAM.clear();
+    m_RAM.shrink_to_fit();
+    m_Mapper->Attach(m_Data, Ram());
 
-void Cartridge::UpdateRTCRegisters() {
-    if (!m_HasRTC) return;
-
-    // If halted (bit 6 of DaysHigh), don't advance
-    if (m_RTC.DaysHigh & 0x40) return;
-
-    S64 now = std::time(nullptr);
-    S64 elapsed = now - m_RTCBaseTimestamp;
-    if (elapsed <= 0) return;
-
-    m_RTCBaseTimestamp = now;
-
-    // Convert current registers to total seconds
-    U16 days = (static_cast<U16>(m_RTC.DaysHigh & 0x01) << 8) | m_RTC.DaysLow;
-    S64 totalSeconds = static_cast<S64>(days) * 86400
-                     + static_cast<S64>(m_RTC.Hours) * 3600
-                     + static_cast<S64>(m_RTC.Minutes) * 60
-                     + m_RTC.Seconds
-                     + elapsed;
-
-    m_RTC.Seconds = static_cast<U8>(totalSeconds % 60);
-    totalSeconds /= 60;
-    m_RTC.Minutes = static_cast<U8>(totalSeconds % 60);
-    totalSeconds /= 60;
-    m_RTC.Hours = static_cast<U8>(totalSeconds % 24);
-    totalSeconds /= 24;
-
-    days = static_cast<U16>(totalSeconds);
-    m_RTC.DaysLow = static_cast<U8>(days & 0xFF);
-    m_RTC.DaysHigh = (m_RTC.DaysHigh & 0xC0) | ((days >> 8) & 0x01);
-
-    // Day counter overflow (>511 days)
-    if (days > 511) {
-        m_RTC.DaysHigh |= 0x80;  // Set carry flag
-        days &= 0x1FF;
-        m_RTC.DaysLow = static_cast<U8>(days & 0xFF);
-        m_RTC.DaysHigh = (m_RTC.DaysHigh & 0xC0) | ((days >> 8) & 0x01);
+    // Keep a legacy footer that the mapping cut off
+    if (m_Mapper->Clock()) {
+        (void)file::WriteAtomic(RtcPath(), SaveImage());
     }
+    return {};
 }
 
-bool Cartridge::ValidateLogo() const {
-    return m_Header.NintendoLogo == ValidNintendoLogo;
+bool Cartridge::SyncSave() const {
+    return !m_RamFile || m_RamFile->Sync();
 }
 
-bool Cartridge::ValidateHeaderChecksum() const {
-    U8 checksum = 0;
-    for (U16 address = 0x0134; address <= 0x014C; ++address) {
-        checksum = checksum - m_Data[address] - 1;
-    }
-    return checksum == m_Header.HeaderChecksum;
+std::filesystem::path Cartridge::RtcPath() const {
+    return std::filesystem::path{m_SavePath}.replace_extension(".rtc");
 }
 
-void Cartridge::SetSavePath(std::filesystem::path path) {
-    m_SavePath = std::move(path);
-    LoadSaveRAM();
+std::filesystem::path Cartridge::SaveImagePath() const {
+    return m_RamFile ? RtcPath() : m_SavePath;
 }
 
-void Cartridge::LoadSaveRAM() {
-    if (!m_HasBattery) return;
-
-    std::ifstream file{m_SavePath, std::ios::binary};
-    if (!file) return;
-
-    file.seekg(0, std::ios::end);
-    const auto fileSize = static_cast<Size>(file.tellg());
-    file.seekg(0, std::ios::beg);
-
-    Size expectedSize = m_RAM.size() + (m_HasRTC ? 48 : 0);
-    if (fileSize != expectedSize && fileSize != m_RAM.size()) return;
+void Cartridge::SaveRAM() const {
+    if (!m_HasBattery || m_SavePath.empty() || (Ram().empty() && !m_Mapper->Clock())) return;
 
-    if (!m_RAM.empty()) {
-        file.read(reinterpret_cast<char*>(m_RAM.data()), static_cast<std::streamsize>(m_RAM.size()));
+    (void)SyncSave();
+    const std::vector<U8> image = SaveImage();
+    if (!image.empty()) {
+        (void)file::WriteAtomic(SaveImagePath(), image);
     }
+}
 
-    // Load RTC state (VBA-M format: 5×4 current + 5×4 latched + 8 timestamp = 48 bytes)
-    if (m_HasRTC && fileSize >= m_RAM.size() + 48) {
-        auto readU32 = [&]() -> U32 {
-            U32 v = 0;
-            file.read(reinterpret_cast<char*>(&v), 4);
-            return v;
-        };
-
-        m_RTC.Seconds  = static_cast<U8>(readU32());
-        m_RTC.Minutes  = static_cast<U8>(readU32());
-        m_RTC.Hours    = static_cast<U8>(readU32());
-        m_RTC.DaysLow  = static_cast<U8>(readU32());
-        m_RTC.DaysHigh = static_cast<U8>(readU32());
-
-        m_LatchedRTC.Seconds  = static_cast<U8>(readU32());
-        m_LatchedRTC.Minutes  = static_cast<U8>(readU32());
-        m_LatchedRTC.Hours    = static_cast<U8>(readU32());
-        m_LatchedRTC.DaysLow  = static_cast<U8>(readU32());
-        m_LatchedRTC.DaysHigh = static_cast<U8>(readU32());
-
-        S64 savedTimestamp = 0;
-        file.read(reinterpret_cast<char*>(&savedTimestamp), 8);
-        m_RTCBaseTimestamp = savedTimestamp;
+std::vector<U8> Cartridge::SaveImage() const {
+    std::vector<U8> image;
+    if (!m_RamFile) {
+        image = m_RAM;
     }
+    WriteRtcFooter(image);
+    return image;
 }
 
-void Cartridge::SaveRAM() const {
-    if (!m_HasBattery || (m_RAM.empty() && !m_HasRTC)) return;
+bool Cartridge::CollectSave(std::vector<U8>& image) {
+    // A mapped .sav needs no copy, only the news that it changed
+    const std::span<U8> ram = m_RamFile ? std::span<U8>{} : std::span<U8>{image};
+    if (!m_Mapper->TakeDirtyPages(ram)) return false;
+    WriteRtcFooter(image);
+    return true;
+}
 
-    std::ofstream file{m_SavePath, std::ios::binary};
-    if (!file) return;
+void Cartridge::WriteRtcFooter(std::vector<U8>& image) const {
+    const Rtc* rtc = m_Mapper->Clock();
+    if (!rtc) return;
 
-    if (!m_RAM.empty()) {
-        file.write(reinterpret_cast<const char*>(m_RAM.data()), static_cast<std::streamsize>(m_RAM.size()));
-    }
+    std::ostringstream footer;
+    rtc->SaveFile(footer);
+    const std::string bytes = std::move(footer).str();
+    image.resize(m_RamFile ? 0 : m_RAM.size());
+    image.insert(image.end(), bytes.begin(), bytes.end());
+}
+
+void Cartridge::SaveState(std::ostream& out) const {
+    m_Mapper->SaveState(out);
+    // Same layout as state::Write for a vector
+    const std::span<const U8> ram = Ram();
+    state::Write(out, static_cast<U32>(ram.size()));
+    out.write(reinterpret_cast<const char*>(ram.data()), static_cast<std::streamsize>(ram.size()));
 
-    // Save RTC state (VBA-M format)
-    if (m_HasRTC) {
-        auto writeU32 = [&](U32 v) {
-            file.write(reinterpret_cast<const char*>(&v), 4);
-        };
-
-        writeU32(m_RTC.Seconds);
-        writeU32(m_RTC.Minutes);
-        writeU32(m_RTC.Hours);
-        writeU32(m_RTC.DaysLow);
-        writeU32(m_RTC.DaysHigh);
-
-        writeU32(m_LatchedRTC.Seconds);
-        writeU32(m_LatchedRTC.Minutes);
-        writeU32(m_LatchedRTC.Hours);
-        writeU32(m_LatchedRTC.DaysLow);
-        writeU32(m_LatchedRTC.DaysHigh);
-
-        S64 timestamp = std::time(nullptr);
-        file.write(reinterpret_cast<const char*>(&timestamp), 8);
+    if (const Rtc* rtc = m_Mapper->Clock()) {
+        rtc->SaveState(out);
     }
 }
 
-void Cartridge::SaveState(std::ostream& out) const {
-    state::Write(out, m_RomBank);
-    state::Write(out, m_RamBank);
-    state::Write(out, m_RamEnabled);
-    state::Write(out, m_BankingMode);
-    state::Write(out, m_RAM);
-
-    if (m_HasRTC) {
-        state::Write(out, m_RTC.Seconds);
-        state::Write(out, m_RTC.Minutes);
-        state::Write(out, m_RTC.Hours);
-        state::Write(out, m_RTC.DaysLow);
-        state::Write(out, m_RTC.DaysHigh);
-        state::Write(out, m_LatchedRTC.Seconds);
-        state::Write(out, m_LatchedRTC.Minutes);
-        state::Write(out, m_LatchedRTC.Hours);
-        state::Write(out, m_LatchedRTC.DaysLow);
-        state::Write(out, m_LatchedRTC.DaysHigh);
-        state::Write(out, m_RTCBaseTimestamp);
-        state::Write(out, m_RTCLatched);
-        state::Write(out, m_RTCLatchPrev);
+void Cartridge::Hash(hash::Xxh64& hasher) const {
+    m_Mapper->Hash(hasher);
+    if (const Rtc* rtc = m_Mapper->Clock()) {
+        rtc->Hash(hasher);
     }
 }
 
 void Cartridge::LoadState(std::istream& in) {
-    state::Read(in, m_RomBank);
-    state::Read(in, m_RamBank);
-    state::Read(in, m_RamEnabled);
-    state::Read(in, m_BankingMode);
-    state::Read(in, m_RAM);
-
-    if (m_HasRTC) {
-        state::Read(in, m_RTC.Seconds);
-        state::Read(in, m_RTC.Minutes);
-        state::Read(in, m_RTC.Hours);
-        state::Read(in, m_RTC.DaysLow);
-        state::Read(in, m_RTC.DaysHigh);
-        state::Read(in, m_LatchedRTC.Seconds);
-        state::Read(in, m_LatchedRTC.Minutes);
-        state::Read(in, m_LatchedRTC.Hours);
-        state::Read(in, m_LatchedRTC.DaysLow);
-        state::Read(in, m_LatchedRTC.DaysHigh);
-        state::Read(in, m_RTCBaseTimestamp);
-        state::Read(in, m_RTCLatched);
-        state::Read(in, m_RTCLatchPrev);
+    m_Mapper->LoadState(in);
+    std::vector<U8> ram;
+    state::Read(in, ram);
+    if (!m_RamFile) {
+        m_RAM = std::move(ram);
+    }
+    else if (ram.size() == m_RamFile->Data().size()) {
+        std::ranges::copy(ram, m_RamFile->Data().begin());
+    }
+
+    if (Rtc* rtc = m_Mapper->Clock()) {
+        rtc->LoadState(in);
     }
+    // RAM may have been reallocated
+    m_Mapper->Attach(m_Data, Ram());
+    m_Mapper->MarkAllDirty();
 }
 
 } // namespace gb
@@ -8,7 +8,6 @@ namespace gb {
 
 CPU::CPU(Bus& bus, bool cgbMode)
     : m_Bus{bus}
-    , m_CgbMode{cgbMode}
     , AF{cgbMode ? U16{0x1180} : U16{0x01B0}}
     , BC{cgbMode ? U16{0x0000} : U16{0x0013}}
     , DE{cgbMode ? U16{0xFF56} : U16{0x00D8}}
@@ -18,26 +17,35 @@ CPU::CPU(Bus& bus, bool cgbMode)
 {
 }
 
+template<Model M>
 void CPU::Tick()
 {
-    m_Bus.Tick();
+    m_Bus.Tick<M>();
 }
 
+template<Model M>
 U8 CPU::BusRead(U16 address)
 {
-    m_Bus.Tick();
-    return m_Bus.Read(address);
+    m_Bus.Tick<M>();
+    const U8 value = m_Bus.Read<M>(address);
+    if (m_Bus.WatchFlags(address) & Bus::WatchRead) [[unlikely]]
+        m_Debugger->OnAccess(address, value, Bus::WatchRead);
+    return value;
 }
 
+template<Model M>
 void CPU::BusWrite(U16 address, U8 value)
 {
-    m_Bus.Tick();
-    m_Bus.Write(address, value);
+    m_Bus.Tick<M>();
+    m_Bus.Write<M>(address, value);
+    if (m_Bus.WatchFlags(address) & Bus::WatchWrite) [[unlikely]]
+        m_Debugger->OnAccess(address, value, Bus::WatchWrite);
 }
 
+template<Model M>
 U8 CPU::Fetch()
 {
-    U8 value = BusRead(PC);
+    U8 value = BusRead<M>(PC);
     if (m_HaltBug)
         m_HaltBug = false;  // Don't increment PC this time
     else
@@ -45,17 +53,32 @@ U8 CPU::Fetch()
     return value;
 }
 
+void CPU::CheckTestSignature()
+{
+    // Mooneye: Fibonacci numbers in B..L on success, 0x42 everywhere on failure
+    if (B == 3 && C == 5 && D == 8 && E == 13 && H == 21 && L == 34)
+        m_Bus.SetTestResult(TestResult::Passed);
+    else if (B == 0x42 && C == 0x42 && D == 0x42 && E == 0x42 && H == 0x42 && L == 0x42)
+        m_Bus.SetTestResult(TestResult::Failed);
+}
+
+template<Model M>
 U16 CPU::Fetch16()
 {
-    U16 value = Fetch();
-    value |= static_cast<U16>(Fetch()) << 8;
+    U16 value = Fetch<M>();
+    value |= static_cast<U16>(Fetch<M>()) << 8;
     return value;
 }
 
+template<Model M>
 void CPU::Step()
 {
+#ifdef PHOSPHOR_PROFILE
+    const ProfileScope profile{m_Profiler, *this, m_Bus};
+#endif
+
     if (m_Halted) {
-        Tick();  // 1 M-cycle while halted
+        Tick<M>();  // 1 M-cycle while halted
         if (m_Bus.ReadIF() & m_Bus.ReadIE() & 0x1F)
             m_Halted = false;
         else
@@ -78,39 +101,42 @@ void CPU::Step()
             IME = false;
             m_HaltBug = false;  // Interrupt dispatch overrides halt bug
             // Interrupt dispatch: 5 M-cycles
-            Tick();  // M1: internal - recognize interrupt
-            Tick();  // M2: internal - prepare SP
-            BusWrite(--SP, PC >> 8);      // M3: push PC high
-            BusWrite(--SP, PC & 0xFF);    // M4: push PC low
+            Tick<M>();  // M1: internal - recognize interrupt
+            Tick<M>();  // M2: internal - prepare SP
+            BusWrite<M>(--SP, PC >> 8);      // M3: push PC high
+            BusWrite<M>(--SP, PC & 0xFF);    // M4: push PC low
             // M5: internal - set PC, clear IF bit
             if (pending & 0x01) { PC = 0x0040; m_Bus.SetIF(IF & ~0x01); }
             else if (pending & 0x02) { PC = 0x0048; m_Bus.SetIF(IF & ~0x02); }
             else if (pending & 0x04) { PC = 0x0050; m_Bus.SetIF(IF & ~0x04); }
             else if (pending & 0x08) { PC = 0x0058; m_Bus.SetIF(IF & ~0x08); }
             else if (pending & 0x10) { PC = 0x0060; m_Bus.SetIF(IF & ~0x10); }
-            Tick();  // M5: internal
+            Tick<M>();  // M5: internal
+#ifdef PHOSPHOR_PROFILE
+            if (m_Profiler) m_Profiler->InterruptDispatched();
+#endif
             return;
         }
     }
 
-    const U8 opcode = Fetch();  // M1: fetch opcode (1 M-cycle)
+    const U8 opcode = Fetch<M>();  // M1: fetch opcode (1 M-cycle)
 
     switch (opcode)
     {
     case 0x00: // NOP (1M: fetch)
         return;
     case 0x10: // STOP (2M: fetch + fetch 0x00)
-        Fetch();
-        if (m_CgbMode && m_Bus.IsSpeedSwitchArmed())
+        Fetch<M>();
+        if (M == Model::Cgb && m_Bus.IsSpeedSwitchArmed())
         {
             m_Bus.PerformSpeedSwitch();
             // Speed switch takes ~2050 M-cycles
             for (S32 i = 0; i < 2050; i++)
-                Tick();
+                Tick<M>();
         }
         return;
     case 0x02: // LD [BC], A (2M: fetch + write)
-        BusWrite(BC, A);
+        BusWrite<M>(BC, A);
         return;
     case 0x07: // RLCA (1M: fetch)
         {
@@ -121,13 +147,13 @@ void CPU::Step()
         return;
     case 0x08: // LD [a16], SP (5M: fetch + fetch lo + fetch hi + write lo + write hi)
         {
-            const U16 address = Fetch16();
-            BusWrite(address, SP & 0xFF);
-            BusWrite(address + 1, SP >> 8);
+            const U16 address = Fetch16<M>();
+            BusWrite<M>(address, SP & 0xFF);
+            BusWrite<M>(address + 1, SP >> 8);
         }
         return;
     case 0x0A: // LD A, [BC] (2M: fetch + read)
-        A = BusRead(BC);
+        A = BusRead<M>(BC);
         return;
     case 0x0F: // RRCA (1M: fetch)
         {
@@ -137,7 +163,7 @@ void CPU::Step()
         }
         return;
     case 0x12: // LD [DE], A (2M: fetch + write)
-        BusWrite(DE, A);
+        BusWrite<M>(DE, A);
         return;
     case 0x17: // RLA (1M: fetch)
         {
@@ -149,13 +175,13 @@ void CPU::Step()
         return;
     case 0x18: // JR e8 (3M: fetch + fetch offset + internal)
         {
-            const S8 offset = static_cast<S8>(Fetch());
+            const S8 offset = static_cast<S8>(Fetch<M>());
             PC += offset;
-            Tick();  // internal
+            Tick<M>();  // internal
         }
         return;
     case 0x1A: // LD A, [DE] (2M: fetch + read)
-        A = BusRead(DE);
+        A = BusRead<M>(DE);
         return;
     case 0x1F: // RRA (1M: fetch)
         {
@@ -166,7 +192,7 @@ void CPU::Step()
         }
         return;
     case 0x22: // LD [HL+], A (2M: fetch + write)
-        BusWrite(HL++, A);
+        BusWrite<M>(HL++, A);
         return;
     case 0x27: // DAA (1M: fetch)
         {
@@ -190,20 +216,20 @@ void CPU::Step()
         }
         return;
     case 0x2A: // LD A, [HL+] (2M: fetch + read)
-        A = BusRead(HL++);
+        A = BusRead<M>(HL++);
         return;
     case 0x2F: // CPL (1M: fetch)
         A = ~A;
         Flags = (Flags & 0x90) | 0x60;
         return;
     case 0x32: // LD [HL-], A (2M: fetch + write)
-        BusWrite(HL--, A);
+        BusWrite<M>(HL--, A);
         return;
     case 0x37: // SCF (1M: fetch)
         Flags = (Flags & 0x80) | 0x10;
         return;
     case 0x3A: // LD A, [HL-] (2M: fetch + read)
-        A = BusRead(HL--);
+        A = BusRead<M>(HL--);
         return;
     case 0x3F: // CCF (1M: fetch)
         Flags = (Flags & 0x90) ^ 0x10;
@@ -220,58 +246,58 @@ void CPU::Step()
         return;
     case 0xC3: // JP a16 (4M: fetch + fetch lo + fetch hi + internal)
         {
-            const U16 address = Fetch16();
+            const U16 address = Fetch16<M>();
             PC = address;
-            Tick();  // internal
+            Tick<M>();  // internal
         }
         return;
     case 0xCB: // CB prefix
-        ExecuteCB();
+        ExecuteCB<M>();
         return;
     case 0xC9: // RET (4M: fetch + read lo + read hi + internal)
         {
-            const U8 lo = BusRead(SP++);
-            const U8 hi = BusRead(SP++);
+            const U8 lo = BusRead<M>(SP++);
+            const U8 hi = BusRead<M>(SP++);
             PC = (hi << 8) | lo;
-            Tick();  // internal
+            Tick<M>();  // internal
         }
         return;
     case 0xD9: // RETI (4M: fetch + read lo + read hi + internal)
         {
-            const U8 lo = BusRead(SP++);
-            const U8 hi = BusRead(SP++);
+            const U8 lo = BusRead<M>(SP++);
+            const U8 hi = BusRead<M>(SP++);
             PC = (hi << 8) | lo;
             IME = true;
-            Tick();  // internal
+            Tick<M>();  // internal
         }
         return;
     case 0xCD: // CALL a16 (6M: fetch + fetch lo + fetch hi + internal + write hi + write lo)
         {
-            const U16 address = Fetch16();
-            Tick();  // internal
-            BusWrite(--SP, PC >> 8);
-            BusWrite(--SP, PC & 0xFF);
+            const U16 address = Fetch16<M>();
+            Tick<M>();  // internal
+            BusWrite<M>(--SP, PC >> 8);
+            BusWrite<M>(--SP, PC & 0xFF);
             PC = address;
         }
         return;
     case 0xE0: // LDH [a8], A (3M: fetch + fetch a8 + write)
         {
-            const U8 offset = Fetch();
-            BusWrite(0xFF00 + offset, A);
+            const U8 offset = Fetch<M>();
+            BusWrite<M>(0xFF00 + offset, A);
         }
         return;
     case 0xE2: // LDH [C], A (2M: fetch + write)
-        BusWrite(0xFF00 + C, A);
+        BusWrite<M>(0xFF00 + C, A);
         return;
     case 0xE8: // ADD SP, e8 (4M: fetch + fetch imm + internal + internal)
         {
-            const S8 offset = static_cast<S8>(Fetch());
+            const S8 offset = static_cast<S8>(Fetch<M>());
             const U16 result = SP + offset;
             Flags = ((SP & 0x0F) + (offset & 0x0F) > 0x0F ? 0x20 : 0)
                   | ((SP & 0xFF) + (offset & 0xFF) > 0xFF ? 0x10 : 0);
             SP = result;
-            Tick();  // internal
-            Tick();  // internal
+            Tick<M>();  // internal
+            Tick<M>();  // internal
         }
         return;
     case 0xE9: // JP HL (1M: fetch)
@@ -279,45 +305,48 @@ void CPU::Step()
         return;
     case 0xEA: // LD [a16] A (4M: fetch + fetch lo + fetch hi + write)
         {
-            const U16 address = Fetch16();
-            BusWrite(address, A);
+            const U16 address = Fetch16<M>();
+            BusWrite<M>(address, A);
         }
         return;
     case 0xF0: // LDH A, [a8] (3M: fetch + fetch a8 + read)
         {
-            const U8 offset = Fetch();
-            A = BusRead(0xFF00 + offset);
+            const U8 offset = Fetch<M>();
+            A = BusRead<M>(0xFF00 + offset);
         }
         return;
     case 0xF2: // LDH A, [C] (2M: fetch + read)
-        A = BusRead(0xFF00 + C);
+        A = BusRead<M>(0xFF00 + C);
         return;
     case 0xF3: // DI (1M: fetch)
         IME = false;
         return;
     case 0xF8: // LD HL, SP+e8 (3M: fetch + fetch imm + internal)
         {
-            const S8 offset = static_cast<S8>(Fetch());
+            const S8 offset = static_cast<S8>(Fetch<M>());
             const U16 result = SP + offset;
             Flags = ((SP & 0x0F) + (offset & 0x0F) > 0x0F ? 0x20 : 0)
                   | ((SP & 0xFF) + (offset & 0xFF) > 0xFF ? 0x10 : 0);
             HL = result;
-            Tick();  // internal
+            Tick<M>();  // internal
         }
         return;
     case 0xF9: // LD SP, HL (2M: fetch + internal)
         SP = HL;
-        Tick();  // internal
+        Tick<M>();  // internal
         return;
     case 0xFA: // LD A, [a16] (4M: fetch + fetch lo + fetch hi + read)
         {
-            const U16 address = Fetch16();
-            A = BusRead(address);
+            const U16 address = Fetch16<M>();
+            A = BusRead<M>(address);
         }
         return;
     case 0xFB: // EI (1M: fetch)
         m_EIDelay = 1;
         return;
+    case 0x40: // LD B, B (1M: fetch) - software breakpoint in mooneye test ROMs
+        CheckTestSignature();
+        return;
     default:
         // LD r,r': opcodes 0x40-0x7F (except 0x76 = HALT)
         if (opcode >= 0x40 && opcode <= 0x7F && opcode != 0x76)
@@ -328,12 +357,12 @@ void CPU::Step()
             // Handle [HL] explicitly for proper timing
             U8 value;
             if (src == 6)
-                value = BusRead(HL);  // 1 extra M-cycle for read
+                value = BusRead<M>(HL);  // 1 extra M-cycle for read
             else
                 value = GetReg(src);
 
             if (dest == 6)
-                BusWrite(HL, value);  // 1 extra M-cycle for write
+                BusWrite<M>(HL, value);  // 1 extra M-cycle for write
             else
                 SetReg(dest, value);
 
@@ -346,10 +375,10 @@ void CPU::Step()
             const U8 reg = (opcode >> 3) & 0x07;
             if (reg == 6) // [HL] (3M: fetch + read + write)
             {
-                U8 value = BusRead(HL);
+                U8 value = BusRead<M>(HL);
                 ++value;
                 Flags = (Flags & 0x10) | (value == 0 ? 0x80 : 0) | ((value & 0x0F) == 0 ? 0x20 : 0);
-                BusWrite(HL, value);
+                BusWrite<M>(HL, value);
             }
             else // register (1M: fetch)
             {
@@ -365,10 +394,10 @@ void CPU::Step()
             const U8 reg = (opcode >> 3) & 0x07;
             if (reg == 6) // [HL] (3M: fetch + read + write)
             {
-                U8 value = BusRead(HL);
+                U8 value = BusRead<M>(HL);
                 --value;
                 Flags = (Flags & 0x10) | 0x40 | (value == 0 ? 0x80 : 0) | ((value & 0x0F) == 0x0F ? 0x20 : 0);
-                BusWrite(HL, value);
+                BusWrite<M>(HL, value);
             }
             else // register (1M: fetch)
             {
@@ -384,9 +413,9 @@ void CPU::Step()
         if ((opcode & 0xC7) == 0x06)
         {
             const U8 reg = (opcode >> 3) & 0x07;
-            const U8 value = Fetch();
+            const U8 value = Fetch<M>();
             if (reg == 6)
-                BusWrite(HL, value);
+                BusWrite<M>(HL, value);
             else
                 SetReg(reg, value);
             return;
@@ -397,7 +426,7 @@ void CPU::Step()
         {
             const U8 op = (opcode >> 3) & 0x07;
             const U8 src = opcode & 0x07;
-            const U8 value = (src == 6) ? BusRead(HL) : GetReg(src);
+            const U8 value = (src == 6) ? BusRead<M>(HL) : GetReg(src);
             switch (op)
             {
             case 0: Add(value); break;
@@ -416,7 +445,7 @@ void CPU::Step()
         if ((opcode & 0xC7) == 0xC6)
         {
             const U8 op = (opcode >> 3) & 0x07;
-            const U8 value = Fetch();
+            const U8 value = Fetch<M>();
             switch (op)
             {
             case 0: Add(value); break;
@@ -435,8 +464,8 @@ void CPU::Step()
         if ((opcode & 0xCF) == 0xC1)
         {
             const U8 pair = (opcode >> 4) & 0x03;
-            const U8 lo = BusRead(SP++);
-            const U8 hi = BusRead(SP++);
+            const U8 lo = BusRead<M>(SP++);
+            const U8 hi = BusRead<M>(SP++);
             SetReg16(pair, (hi << 8) | lo);
             return;
         }
@@ -445,9 +474,9 @@ void CPU::Step()
         {
             const U8 pair = (opcode >> 4) & 0x03;
             const U16 value = GetReg16(pair);
-            Tick();  // internal
-            BusWrite(--SP, value >> 8);
-            BusWrite(--SP, value & 0xFF);
+            Tick<M>();  // internal
+            BusWrite<M>(--SP, value >> 8);
+            BusWrite<M>(--SP, value & 0xFF);
             return;
         }
 
@@ -461,7 +490,7 @@ void CPU::Step()
                   | ((HL & 0x0FFF) + (value & 0x0FFF) > 0x0FFF ? 0x20 : 0)
                   | (result > 0xFFFF ? 0x10 : 0);
             HL = static_cast<U16>(result);
-            Tick();  // internal
+            Tick<M>();  // internal
             return;
         }
 
@@ -469,7 +498,7 @@ void CPU::Step()
         if ((opcode & 0xCF) == 0x01)
         {
             const U8 pair = (opcode >> 4) & 0x03;
-            const U16 value = Fetch16();
+            const U16 value = Fetch16<M>();
             if (pair == 3)
                 SP = value;
             else
@@ -482,7 +511,7 @@ void CPU::Step()
         {
             const U8 pair = (opcode >> 4) & 0x03;
             ++(pair == 3 ? SP : GetReg16Ref(pair));
-            Tick();  // internal
+            Tick<M>();  // internal
             return;
         }
 
@@ -491,7 +520,7 @@ void CPU::Step()
         {
             const U8 pair = (opcode >> 4) & 0x03;
             --(pair == 3 ? SP : GetReg16Ref(pair));
-            Tick();  // internal
+            Tick<M>();  // internal
             return;
         }
 
@@ -499,11 +528,11 @@ void CPU::Step()
         if ((opcode & 0xE7) == 0x20)
         {
             const U8 cc = (opcode >> 3) & 0x03;
-            const S8 offset = static_cast<S8>(Fetch());
+            const S8 offset = static_cast<S8>(Fetch<M>());
             if (CheckCondition(cc))
             {
                 PC += offset;
-                Tick();  // internal (branch taken)
+                Tick<M>();  // internal (branch taken)
             }
             return;
         }
@@ -512,13 +541,13 @@ void CPU::Step()
         if ((opcode & 0xE7) == 0xC0)
         {
             const U8 cc = (opcode >> 3) & 0x03;
-            Tick();  // internal (condition eval)
+            Tick<M>();  // internal (condition eval)
             if (CheckCondition(cc))
             {
-                const U8 lo = BusRead(SP++);
-                const U8 hi = BusRead(SP++);
+                const U8 lo = BusRead<M>(SP++);
+                const U8 hi = BusRead<M>(SP++);
                 PC = (hi << 8) | lo;
-                Tick();  // internal
+                Tick<M>();  // internal
             }
             return;
         }
@@ -527,11 +556,11 @@ void CPU::Step()
         if ((opcode & 0xE7) == 0xC2)
         {
             const U8 cc = (opcode >> 3) & 0x03;
-            const U16 address = Fetch16();
+            const U16 address = Fetch16<M>();
             if (CheckCondition(cc))
             {
                 PC = address;
-                Tick();  // internal (branch taken)
+                Tick<M>();  // internal (branch taken)
             }
             return;
         }
@@ -540,12 +569,12 @@ void CPU::Step()
         if ((opcode & 0xE7) == 0xC4)
         {
             const U8 cc = (opcode >> 3) & 0x03;
-            const U16 address = Fetch16();
+            const U16 address = Fetch16<M>();
             if (CheckCondition(cc))
             {
-                Tick();  // internal
-                BusWrite(--SP, PC >> 8);
-                BusWrite(--SP, PC & 0xFF);
+                Tick<M>();  // internal
+                BusWrite<M>(--SP, PC >> 8);
+                BusWrite<M>(--SP, PC & 0xFF);
                 PC = address;
             }
             return;
@@ -555,9 +584,9 @@ void CPU::Step()
         if ((opcode & 0xC7) == 0xC7)
         {
             const U8 target = opcode & 0x38;
-            Tick();  // internal
-            BusWrite(--SP, PC >> 8);
-            BusWrite(--SP, PC & 0xFF);
+            Tick<M>();  // internal
+            BusWrite<M>(--SP, PC >> 8);
+            BusWrite<M>(--SP, PC & 0xFF);
             PC = target;
             return;
         }
@@ -753,9 +782,10 @@ bool CPU::CheckCondition(U8 cc) const
     }
 }
 
+template<Model M>
 void CPU::ExecuteCB()
 {
-    const U8 opcode = Fetch();  // M2: fetch CB opcode
+    const U8 opcode = Fetch<M>();  // M2: fetch CB opcode
     const U8 reg = opcode & 0x07;
     const U8 bit = (opcode >> 3) & 0x07;
     const U8 op = (opcode >> 6) & 0x03;
@@ -764,7 +794,7 @@ void CPU::ExecuteCB()
     // Read the value: from register or [HL] with ticked read
     U8 value;
     if (isHL)
-        value = BusRead(HL);  // M3: read [HL]
+        value = BusRead<M>(HL);  // M3: read [HL]
     else
         value = GetReg(reg);
 
@@ -831,7 +861,7 @@ void CPU::ExecuteCB()
         }
         // Write back
         if (isHL)
-            BusWrite(HL, value);  // M4: write [HL]
+            BusWrite<M>(HL, value);  // M4: write [HL]
         else
             SetReg(reg, value);
         break;
@@ -844,7 +874,7 @@ void CPU::ExecuteCB()
     case 2: // RES
         value &= ~(1 << bit);
         if (isHL)
-            BusWrite(HL, value);
+            BusWrite<M>(HL, value);
         else
             SetReg(reg, value);
         break;
@@ -852,7 +882,7 @@ void CPU::ExecuteCB()
     case 3: // SET
         value |= (1 << bit);
         if (isHL)
-            BusWrite(HL, value);
+            BusWrite<M>(HL, value);
         else
             SetReg(reg, value);
         break;
@@ -873,6 +903,11 @@ void CPU::SaveState(std::ostream& out) const
     state::Write(out, m_HaltBug);
 }
 
+void CPU::Hash(hash::Xxh64& hasher) const
+{
+    hasher.Add(AF, BC, DE, HL, SP, PC, IME, m_EIDelay, m_Halted, m_HaltBug);
+}
+
 void CPU::LoadState(std::istream& in)
 {
     state::Read(in, AF);
@@ -887,4 +922,7 @@ void CPU::LoadState(std::istream& in)
     state::Read(in, m_HaltBug);
 }
 
+template void CPU::Step<Model::Dmg>();
+template void CPU::Step<Model::Cgb>();
+
 } // namespace gb
@@ -0,0 +1,148 @@
+#include <gb_debugger.hpp>
+#include <gb_bus.hpp>
+
+namespace gb {
+
+void Debugger::AddBreakpoint(U16 pc)
+{
+    if (IsBreakpoint(pc))
+        return;
+    m_Breakpoints[pc >> 6] |= U64{1} << (pc & 63);
+    ++m_BreakpointCount;
+    UpdateArmed();
+}
+
+void Debugger::RemoveBreakpoint(U16 pc)
+{
+    if (!IsBreakpoint(pc))
+        return;
+    m_Breakpoints[pc >> 6] &= ~(U64{1} << (pc & 63));
+    --m_BreakpointCount;
+    UpdateArmed();
+}
+
+void Debugger::AddWatch(const Watchpoint& watch)
+{
+    const U8 flags = watch.Flags & (Bus::WatchRead | Bus::WatchWrite);
+    if (flags == 0)
+        return;
+    if (m_Watches[watch.Address] == 0)
+        ++m_WatchCount;
+    m_Watches[watch.Address] |= flags;
+    RefreshPage(static_cast<U8>(watch.Address >> 8));
+    UpdateArmed();
+}
+
+void Debugger::RemoveWatch(U16 address)
+{
+    if (m_Watches[address] == 0)
+        return;
+    m_Watches[address] = 0;
+    --m_WatchCount;
+    RefreshPage(static_cast<U8>(address >> 8));
+    UpdateArmed();
+}
+
+void Debugger::ClearAll()
+{
+    m_Breakpoints.fill(0);
+    m_Watches.fill(0);
+    m_BreakpointCount = 0;
+    m_WatchCount = 0;
+    for (U32 page = 0; page < 0x100; ++page)
+        m_Bus.SetWatchPage(static_cast<U8>(page), 0);
+    UpdateArmed();
+}
+
+bool Debugger::BeforeInstruction(U16 pc, bool halted)
+{
+    m_InstructionPC = pc;
+    if (m_Stopped)
+        return true;
+
+    if (m_PauseRequested)
+    {
+        m_PauseRequested = false;
+        Stop({BreakReason::Pause, pc, pc, 0});
+        return true;
+    }
+    if (m_StepPending)
+    {
+        // Let this instruction run and stop before the next one
+        m_StepPending = false;
+        m_PauseRequested = true;
+    }
+
+    // A halted CPU sits on the next instruction without running it
+    if (halted)
+        return false;
+    if (m_SkipBreakpoint)
+    {
+        m_SkipBreakpoint = false;
+        UpdateArmed();
+        return false;
+    }
+    if (IsBreakpoint(pc))
+    {
+        Stop({BreakReason::Breakpoint, pc, pc, 0});
+        return true;
+    }
+    return false;
+}
+
+void Debugger::OnAccess(U16 address, U8 value, U8 kind)
+{
+    if (!(m_Watches[address] & kind) || m_Stopped)
+        return;
+    // The access completes; the CPU stops once the instruction finishes
+    const auto reason = kind == Bus::WatchRead ? BreakReason::ReadWatch : BreakReason::WriteWatch;
+    Stop({reason, m_InstructionPC, address, value});
+}
+
+void Debugger::Pause()
+{
+    m_PauseRequested = true;
+    UpdateArmed();
+}
+
+void Debugger::Resume()
+{
+    if (!m_Stopped)
+        return;
+    m_Stopped = false;
+    m_SkipBreakpoint = true;
+    UpdateArmed();
+}
+
+void Debugger::StepInstruction()
+{
+    if (!m_Stopped)
+        return;
+    Resume();
+    m_StepPending = true;
+    UpdateArmed();
+}
+
+void Debugger::Stop(const BreakEvent& event)
+{
+    m_Event = event;
+    m_Stopped = true;
+    UpdateArmed();
+}
+
+void Debugger::RefreshPage(U8 page)
+{
+    U8 flags = 0;
+    const U32 base = static_cast<U32>(page) << 8;
+    for (U32 offset = 0; offset < 0x100; ++offset)
+        flags |= m_Watches[base + offset];
+    m_Bus.SetWatchPage(page, flags);
+}
+
+void Debugger::UpdateArmed()
+{
+    m_Armed = m_BreakpointCount > 0 || m_WatchCount > 0 || m_Stopped
+        || m_PauseRequested || m_StepPending || m_SkipBreakpoint;
+}
+
+} // namespace gb
@@ -0,0 +1,286 @@
+#include <gb_emu_thread.hpp>
+#include <chrono>
+#include <print>
+
+#include <gb.hpp>
+#include <gb_apu.hpp>
+#include <gb_battery.hpp>
+#include <gb_movie.hpp>
+#include <gb_netplay.hpp>
+#include <gb_save_slots.hpp>
+#include <instrument.hpp>
+
+namespace gb {
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using Seconds = std::chrono::duration<double>;
+
+    // 154 lines * 456 cycles at 4.194304 MHz: ~59.73 Hz
+    constexpr Seconds FrameDuration{70224.0 / APU::CPUFrequency};
+
+    // Falling further behind than this (debugger, suspend) drops time instead of catching up
+    constexpr S32 MaxFramesBehind = 4;
+
+    // Fast-forward renders and publishes at most this often; other frames skip the PPU output
+    constexpr Seconds PublishInterval{1.0 / 60.0};
+
+    constexpr Seconds SpeedMeterInterval{0.5};
+
+    // How often a paused thread looks for resume/step requests
+    constexpr std::chrono::milliseconds PausePollInterval{5};
+
+    const char* BreakReasonName(BreakReason reason)
+    {
+        switch (reason)
+        {
+        case BreakReason::Breakpoint: return "Breakpoint";
+        case BreakReason::ReadWatch:  return "Read watchpoint";
+        case BreakReason::WriteWatch: return "Write watchpoint";
+        case BreakReason::Pause:      return "Paused";
+        }
+        return "?";
+    }
+}
+
+EmuThread::EmuThread(GameBoy& gb, SaveSlots& slots, SDL_AudioDeviceID audioDevice, Size audioTargetSamples)
+    : m_GameBoy{gb}
+    , m_Slots{slots}
+    , m_AudioDevice{audioDevice}
+    , m_RateControl{audioTargetSamples}
+{
+}
+
+EmuThread::~EmuThread()
+{
+    Stop();
+}
+
+void EmuThread::Start()
+{
+    m_Input.store(m_GameBoy.GetBus().GetJoypad().GetButtons(), std::memory_order_relaxed);
+    m_Thread = std::jthread{[this](std::stop_token stop) { Loop(stop); }};
+}
+
+void EmuThread::Stop()
+{
+    if (!m_Thread.joinable())
+        return;
+    m_Thread.request_stop();
+    m_Thread.join();
+}
+
+void EmuThread::Loop(std::stop_token stop)
+{
+    instrument::SetThreadName("Emulation");
+
+    auto deadline = Clock::now();
+    auto lastPublish = deadline;
+    auto meterStart = deadline;
+    U32 meterFrames = 0;
+    float previousSpeed = 1.0f;
+
+    while (!stop.stop_requested())
+    {
+        const float speed = m_Speed.load(std::memory_order_relaxed);
+        const bool fastForward = speed == Uncapped || speed > 1.0f;
+        if (speed != previousSpeed)
+        {
+            // Re-anchor pacing so a speed change neither sprints nor stalls to catch up
+            deadline = Clock::now();
+            previousSpeed = speed;
+        }
+
+        // In fast-forward, intermediate frames are neither rendered nor presented
+        const bool present = !fastForward || Clock::now() - lastPublish >= PublishInterval;
+
+        HandleRequests();
+        if (m_GameBoy.GetDebugger().Stopped())
+        {
+            std::this_thread::sleep_for(PausePollInterval);
+            deadline = Clock::now();
+            continue;
+        }
+
+        m_GameBoy.SetRenderingEnabled(present);
+        RunFrame();
+        if (m_GameBoy.GetDebugger().Stopped())
+        {
+            // Show the partly drawn frame the debugger stopped in
+            ReportBreak();
+            m_Frames.WriteBuffer() = m_GameBoy.GetPPU().GetFramebuffer();
+            m_Frames.Publish();
+            continue;
+        }
+        if (m_BatterySaver)
+            m_BatterySaver->Collect();
+
+        if (speed == 1.0f || (fastForward && present))
+            QueueAudio(fastForward);
+        else
+            m_GameBoy.GetAPU().ClearBuffer();  // Slow motion and skipped frames are muted
+        instrument::EndFrame(instrument::Track::Emulation);
+
+        if (present)
+        {
+            m_Frames.WriteBuffer() = m_GameBoy.GetPPU().GetFramebuffer();
+            m_Frames.Publish();
+            lastPublish = Clock::now();
+        }
+
+        ++meterFrames;
+        const auto now = Clock::now();
+        if (now - meterStart >= SpeedMeterInterval)
+        {
+            const Seconds emulated = FrameDuration * meterFrames;
+            m_AchievedSpeed.store(static_cast<float>(emulated / Seconds{now - meterStart}), std::memory_order_relaxed);
+            meterFrames = 0;
+            meterStart = now;
+        }
+
+        if (speed == Uncapped)
+        {
+            deadline = now;
+            continue;
+        }
+
+        deadline += std::chrono::duration_cast<Clock::duration>(FrameDuration / speed);
+        if (now - deadline > FrameDuration * MaxFramesBehind)
+            deadline = now;
+        else if (deadline > now)
+            std::this_thread::sleep_until(deadline);
+    }
+}
+
+void EmuThread::HandleRequests()
+{
+    const U8 requests = m_Requests.exchange(0, std::memory_order_relaxed);
+    const U32 slot = m_Slot.load(std::memory_order_relaxed);
+
+    // The slot writer reports when the file is on disk
+    if (requests & SaveStateRequest)
+        m_Slots.Save(m_GameBoy, slot);
+    if ((requests & LoadStateRequest) && (m_Recording || m_Playback))
+        std::println("Load state is disabled while a movie is recording or playing");
+    else if ((requests & LoadStateRequest) && m_Netplay)
+        std::println("Load state is disabled during netplay");
+    else if (requests & LoadStateRequest)
+    {
+        if (m_Slots.Load(m_GameBoy, slot))
+            std::println("State loaded from slot {}", slot);
+        else
+            std::println("Load state failed");
+    }
+
+    // Stopping mid-frame would leave the peers running different frames
+    if (m_Netplay)
+    {
+        if (requests & (PauseRequest | StepRequest))
+            std::println("The debugger is disabled during netplay");
+        return;
+    }
+
+    auto& debugger = m_GameBoy.GetDebugger();
+    if (requests & PauseRequest)
+        debugger.Pause();
+    if (requests & ResumeRequest)
+    {
+        debugger.Resume();
+        m_Paused.store(false, std::memory_order_relaxed);
+    }
+    if (requests & StepRequest)
+        debugger.StepInstruction();
+}
+
+void EmuThread::ReportBreak()
+{
+    const auto& event = m_GameBoy.GetDebugger().LastBreak();
+    const U16 pc = m_GameBoy.GetCPU().PC;
+    if (event.Reason == BreakReason::ReadWatch || event.Reason == BreakReason::WriteWatch)
+        std::println("{} at {:04X}: [{:04X}] = {:02X}", BreakReasonName(event.Reason), event.PC, event.Address, event.Value);
+    else
+        std::println("{} at {:04X}", BreakReasonName(event.Reason), event.PC);
+    std::println("  next {:04X}  AF={:04X} BC={:04X} DE={:04X} HL={:04X} SP={:04X}", pc,
+        m_GameBoy.GetCPU().AF, m_GameBoy.GetCPU().BC, m_GameBoy.GetCPU().DE,
+        m_GameBoy.GetCPU().HL, m_GameBoy.GetCPU().SP);
+    m_Paused.store(true, std::memory_order_relaxed);
+}
+
+void EmuThread::RunFrame()
+{
+    PHOSPHOR_SPAN(instrument::Zone::Emulate);
+    U8 buttons = m_Input.load(std::memory_order_relaxed);
+    if (m_Playback)
+    {
+        if (m_MovieFrame < m_Playback->FrameCount())
+            buttons = m_Playback->Buttons(m_MovieFrame++);
+        else
+        {
+            std::println("Movie finished after {} frames", m_MovieFrame);
+            m_Playback = nullptr;
+        }
+    }
+    if (m_Recording)
+        m_Recording->AddFrame(buttons);
+    if (m_Netplay)
+    {
+        // While the peer lags too far behind nothing runs; the next tick retries
+        m_Netplay->AdvanceFrame(buttons);
+        return;
+    }
+
+    m_GameBoy.GetBus().GetJoypad().SetButtons(buttons);
+    m_GameBoy.RunUntilFrame();
+}
+
+void EmuThread::QueueAudio(bool fastForward)
+{
+    PHOSPHOR_SPAN(instrument::Zone::QueueAudio);
+    auto& apu = m_GameBoy.GetAPU();
+    if (m_AudioDevice == 0 || apu.GetSampleCount() == 0)
+    {
+        apu.ClearBuffer();
+        return;
+    }
+
+    // SDL_QueueAudio locks the device internally, so queueing from here is safe
+    Size queued = SDL_GetQueuedAudioSize(m_AudioDevice) / sizeof(float);
+
+    if (fastForward)
+    {
+        // Snippets of presented frames only top the queue up; never build latency
+        if (queued < m_RateControl.TargetSamples())
+            SDL_QueueAudio(m_AudioDevice, apu.GetAudioBuffer().data(),
+                static_cast<U32>(apu.GetSampleCount() * sizeof(float)));
+        apu.ClearBuffer();
+        return;
+    }
+
+    if (m_AudioPrimed && queued == 0)
+    {
+        // Underrun: pause and re-prime rather than crackle at an empty queue
+        SDL_PauseAudioDevice(m_AudioDevice, 1);
+        m_AudioPrimed = false;
+        m_RateControl.Reset();
+    }
+    else if (queued > m_RateControl.TargetSamples() * 4)
+    {
+        // Latency guard after a long stall; the rate control and priming
+        // below must see the emptied queue
+        SDL_ClearQueuedAudio(m_AudioDevice);
+        queued = SDL_GetQueuedAudioSize(m_AudioDevice) / sizeof(float);
+    }
+
+    apu.SetResampleRatio(m_RateControl.Update(queued));
+    SDL_QueueAudio(m_AudioDevice, apu.GetAudioBuffer().data(),
+        static_cast<U32>(apu.GetSampleCount() * sizeof(float)));
+
+    if (!m_AudioPrimed && queued + apu.GetSampleCount() >= m_RateControl.TargetSamples())
+    {
+        SDL_PauseAudioDevice(m_AudioDevice, 0);
+        m_AudioPrimed = true;
+    }
+    apu.ClearBuffer();
+}
+
+} // namespace gb
@@ -11,6 +11,11 @@ void Joypad::SaveState(std::ostream& out) const
     state::Write(out, m_Buttons);
 }
 
+void Joypad::Hash(hash::Xxh64& hasher) const
+{
+    hasher.Add(m_Select, m_Buttons);
+}
+
 void Joypad::LoadState(std::istream& in)
 {
     state::Read(in, m_Select);
@@ -0,0 +1,307 @@
+#include <gb_link.hpp>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <print>
+
+#include <gb.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+namespace gb {
+
+namespace {
+    // Published by an end that reached the target and only serves the peer
+    constexpr U64 Finished = ~0ull;
+    // The peer usually moves on within a microsecond; spin that long before
+    // giving up the core, unless there is only one
+    constexpr U32 SpinsBeforeYield = 256;
+
+    void CpuRelax()
+    {
+#if defined(__x86_64__) || defined(_M_X64)
+        _mm_pause();
+#endif
+    }
+}
+
+LinkCable::End::End(LinkCable& cable, GameBoy& gb, Size index)
+    : m_Cable{cable}
+    , m_GameBoy{gb}
+    , m_Index{index}
+    , m_Base{gb.GetBus().GetMasterClock()}
+    , m_SpinLimit{std::thread::hardware_concurrency() > 1 ? SpinsBeforeYield : 0}
+{
+    gb.GetBus().SetLink(this);
+}
+
+LinkCable::End::~End()
+{
+    m_GameBoy.GetBus().SetLink(nullptr);
+}
+
+U64 LinkCable::End::Now() const
+{
+    return m_GameBoy.GetBus().GetMasterClock() - m_Base;
+}
+
+void LinkCable::End::BeginTransfer(U64 due, U8 out)
+{
+    auto& channel = m_Cable.m_Channels[m_Index];
+    channel.Out = out;
+    channel.Answered.store(false, std::memory_order_relaxed);
+    channel.Due.store(due - m_Base, std::memory_order_release);
+    ++m_Stats.Transfers;
+}
+
+U8 LinkCable::End::CompleteTransfer()
+{
+    auto& channel = m_Cable.m_Channels[m_Index];
+    if (!channel.Answered.load(std::memory_order_acquire))
+    {
+        End& peer = m_Cable.Peer(*this);
+        if (m_Cable.m_Options.Mode == LinkMode::Threaded)
+        {
+            while (!channel.Answered.load(std::memory_order_acquire))
+                Wait();
+        }
+        else if (peer.m_Suspended)
+        {
+            // The peer is waiting on this side in turn; it answers from
+            // where it stands
+            ++m_Stats.LateTransfers;
+            peer.Service();
+        }
+        else
+        {
+            // Bring the peer up to the cycle the byte lands on
+            m_Suspended = true;
+            peer.Pull();
+            peer.m_GameBoy.RunUntil([&] { return channel.Answered.load(std::memory_order_acquire); });
+            m_Suspended = false;
+        }
+    }
+    return channel.In;
+}
+
+void LinkCable::End::Service()
+{
+    auto& channel = m_Cable.m_Channels[1 - m_Index];
+    const U64 due = channel.Due.load(std::memory_order_acquire);
+    m_GameBoy.GetBus().ClearLinkDue();
+    if (due == NoTransfer)
+        return;
+    // Ticks land on the due cycle unless the transfer was seen too late
+    if (Now() >= due + 4)
+        ++m_Stats.LateTransfers;
+    channel.In = m_GameBoy.GetBus().ShiftExternal(channel.Out);
+    channel.Due.store(NoTransfer, std::memory_order_relaxed);
+    channel.Answered.store(true, std::memory_order_release);
+}
+
+void LinkCable::End::Pull()
+{
+    const U64 due = m_Cable.m_Channels[1 - m_Index].Due.load(std::memory_order_acquire);
+    if (due == NoTransfer)
+        return;
+    if (due <= Now())
+        Service();
+    else
+        m_GameBoy.GetBus().SetLinkDue(due + m_Base);
+}
+
+void LinkCable::End::Wait()
+{
+    Publish();
+    Pull();
+    ++m_Stats.Waits;
+    if (m_Spins < m_SpinLimit)
+    {
+        ++m_Spins;
+        CpuRelax();
+    }
+    else
+        std::this_thread::yield();
+}
+
+void LinkCable::End::RunTo(U64 until)
+{
+    m_GameBoy.RunUntil([&] { return Now() >= until; });
+}
+
+void LinkCable::End::RunThreaded(U64 target)
+{
+    auto& peerClock = m_Cable.Peer(*this).m_Clock;
+    const U64 skew = m_Cable.m_Options.MaxSkew;
+    while (Now() < target)
+    {
+        Publish();
+        const U64 peer = peerClock.load(std::memory_order_acquire);
+        ++m_Stats.Syncs;
+        Pull();
+        const U64 horizon = peer >= target ? target : std::min(target, peer + skew);
+        if (Now() >= horizon)
+            Wait();
+        else
+        {
+            // Half slices keep the clock the peer sees fresh enough for
+            // both to run at once
+            m_Spins = 0;
+            RunTo(std::min(horizon, Now() + skew / 2));
+        }
+    }
+
+    // The peer's last instruction may end in a transfer past the target;
+    // run on to answer it, as lockstep does
+    m_Clock.store(Finished, std::memory_order_release);
+    const auto& incoming = m_Cable.m_Channels[1 - m_Index].Due;
+    while (peerClock.load(std::memory_order_acquire) != Finished)
+    {
+        Pull();
+        const U64 due = incoming.load(std::memory_order_acquire);
+        if (due != NoTransfer)
+        {
+            RunTo(due);
+            // Waiting on a transfer of our own republishes the clock
+            m_Clock.store(Finished, std::memory_order_release);
+        }
+        else
+            std::this_thread::yield();
+    }
+}
+
+LinkCable::LinkCable(GameBoy& first, GameBoy& second, const LinkOptions& options)
+    : m_Options{options}
+    , m_Ends{End{*this, first, 0}, End{*this, second, 1}}
+{
+    // A slice must make progress even when both clocks are equal
+    m_Options.MaxSkew = std::max(m_Options.MaxSkew, 4u);
+    if (m_Options.Mode == LinkMode::Threaded)
+        m_Worker = std::jthread{[this](std::stop_token stop) { WorkerLoop(stop); }};
+}
+
+LinkCable::~LinkCable()
+{
+    if (!m_Worker.joinable())
+        return;
+    m_Worker.request_stop();
+    m_Started.fetch_add(1, std::memory_order_release);
+    m_Started.notify_one();
+    m_Worker.join();
+}
+
+void LinkCable::WorkerLoop(std::stop_token stop)
+{
+    U32 runs = 0;
+    while (true)
+    {
+        m_Started.wait(runs, std::memory_order_acquire);
+        if (stop.stop_requested())
+            return;
+        ++runs;
+        m_Ends[1].RunThreaded(m_Target);
+        m_Done.store(runs, std::memory_order_release);
+        m_Done.notify_one();
+    }
+}
+
+void LinkCable::Run(U64 cycles)
+{
+    m_Target += cycles;
+    auto& [first, second] = m_Ends;
+
+    if (m_Options.Mode == LinkMode::Threaded)
+    {
+        first.Publish();
+        second.Publish();
+        const U32 run = m_Started.fetch_add(1, std::memory_order_release) + 1;
+        m_Started.notify_one();
+        first.RunThreaded(m_Target);
+        // The worker may still be serving this side; wait until it lets go
+        for (U32 done = m_Done.load(std::memory_order_acquire); done != run; done = m_Done.load(std::memory_order_acquire))
+            m_Done.wait(done, std::memory_order_acquire);
+        return;
+    }
+
+    // The machine behind runs until it is MaxSkew ahead of the other
+    while (first.Now() < m_Target || second.Now() < m_Target)
+    {
+        End& behind = first.Now() <= second.Now() ? first : second;
+        ++behind.m_Stats.Syncs;
+        behind.Pull();
+        behind.RunTo(std::min(m_Target, Peer(behind).Now() + m_Options.MaxSkew));
+    }
+}
+
+LinkStats LinkCable::Stats() const
+{
+    LinkStats total;
+    for (const auto& end : m_Ends)
+    {
+        total.Transfers += end.m_Stats.Transfers;
+        total.LateTransfers += end.m_Stats.LateTransfers;
+        total.Syncs += end.m_Stats.Syncs;
+        total.Waits += end.m_Stats.Waits;
+    }
+    return total;
+}
+
+S32 RunLinkSelfTest(const std::string& firstRom, const std::string& secondRom, const LinkTestOptions& options)
+{
+    constexpr std::array modes{LinkMode::Lockstep, LinkMode::Threaded};
+    const S64 epoch = static_cast<S64>(std::time(nullptr));
+
+    std::println("Link self-test: {} frames, max skew {} cycles", options.Frames, options.Link.MaxSkew);
+    std::println("{:<10} {:>9} {:>10} {:>10} {:>6} {:>9} {:>9}   {:<16} {:<16}",
+        "Mode", "Seconds", "Frames/s", "Transfers", "Late", "Syncs", "Waits", "First", "Second");
+
+    std::array<std::array<U64, 2>, modes.size()> hashes{};
+    bool late = false;
+    for (Size mode = 0; mode < modes.size(); ++mode)
+    {
+        std::array<std::unique_ptr<GameBoy>, 2> machines;
+        for (Size i = 0; i < machines.size(); ++i)
+        {
+            auto cart = Cartridge::Load(i == 0 ? firstRom : secondRom);
+            if (!cart)
+            {
+                std::println(stderr, "Failed to load ROM: {}", cart.error());
+                return 1;
+            }
+            machines[i] = std::make_unique<GameBoy>(std::move(*cart));
+            machines[i]->UseEmulatedRTC(epoch);
+            machines[i]->SetRenderingEnabled(false);
+        }
+
+        LinkOptions link = options.Link;
+        link.Mode = modes[mode];
+        LinkCable cable{*machines[0], *machines[1], link};
+        const auto start = std::chrono::steady_clock::now();
+        // A frame per call keeps the APU buffers small, as a frontend would
+        for (U32 frame = 0; frame < options.Frames; ++frame)
+        {
+            cable.RunFrames(1);
+            for (auto& machine : machines)
+                machine->GetAPU().ClearBuffer();
+        }
+        const double seconds = std::chrono::duration<double>{std::chrono::steady_clock::now() - start}.count();
+
+        const LinkStats stats = cable.Stats();
+        late = late || stats.LateTransfers != 0;
+        hashes[mode] = {machines[0]->StateHash(), machines[1]->StateHash()};
+        std::println("{:<10} {:>9.3f} {:>10.1f} {:>10} {:>6} {:>9} {:>9}   {:016x} {:016x}",
+            modes[mode] == LinkMode::Lockstep ? "Lockstep" : "Threaded", seconds, options.Frames / seconds,
+            stats.Transfers, stats.LateTransfers, stats.Syncs, stats.Waits, hashes[mode][0], hashes[mode][1]);
+    }
+
+    const bool pass = std::ranges::all_of(hashes, [&](const auto& pair) { return pair == hashes[0]; });
+    if (late)
+        std::println("Some transfers were late: lower --link-skew to make runs exact");
+    std::println("{}", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+} // namespace gb
@@ -0,0 +1,451 @@
+#include <gb_mapper.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <ctime>
+#include <istream>
+#include <ostream>
+#include <utility>
+#include <state.hpp>
+
+namespace gb {
+
+namespace {
+    constexpr U64 RtcCyclesPerSecond = 4194304;  // Master clock, unaffected by CGB double speed
+
+    // ROM only: two fixed banks, RAM never enabled
+    class NoMbc final : public Mapper {
+    public:
+        [[nodiscard]] std::unique_ptr<Mapper> Clone() const override { return std::make_unique<NoMbc>(*this); }
+        void Write(U16, U8) override {}
+
+    protected:
+        void Remap() override {
+            MapRom(0, 1);
+            MapRam(0);
+        }
+    };
+
+    class Mbc1 final : public Mapper {
+    public:
+        [[nodiscard]] std::unique_ptr<Mapper> Clone() const override { return std::make_unique<Mbc1>(*this); }
+        void Write(U16 address, U8 value) override {
+            if (address <= 0x1FFF) {
+                m_RamEnabled = (value & 0x0F) == 0x0A;
+            }
+            else if (address <= 0x3FFF) {
+                U16 bank = value & 0x1F;
+                if (bank == 0) bank = 1;
+                m_RomBank = bank;
+            }
+            else if (address <= 0x5FFF) {
+                m_RamBank = value & 0x03;
+            }
+            else {
+                m_BankingMode = (value & 0x01) != 0;
+            }
+            Remap();
+        }
+
+    protected:
+        void Remap() override {
+            // >1MB ROMs route the RAM bank register to ROM bank bits 5-6,
+            // which also reach the 0x0000 window in mode 1
+            const bool large = m_Rom.size() > 0x100000;
+            const U32 high = large ? static_cast<U32>(m_RamBank) << 5 : 0;
+            MapRom(m_BankingMode ? high : 0, m_RomBank | high);
+            // RAM banking only in mode 1
+            MapRam(m_BankingMode && m_Ram.size() > RamBankSize ? m_RamBank & 0x03 : 0);
+        }
+    };
+
+    class Mbc3 final : public Mapper {
+    public:
+        explicit Mbc3(bool hasRtc) {
+            if (hasRtc) m_Rtc = std::make_unique<Rtc>();
+        }
+
+        Mbc3(const Mbc3& other)
+            : Mapper{other}
+            , m_Rtc{other.m_Rtc ? std::make_unique<Rtc>(*other.m_Rtc) : nullptr} {}
+
+        [[nodiscard]] std::unique_ptr<Mapper> Clone() const override { return std::make_unique<Mbc3>(*this); }
+
+        void Write(U16 address, U8 value) override {
+            if (address <= 0x1FFF) {
+                m_RamEnabled = (value & 0x0F) == 0x0A;
+            }
+            else if (address <= 0x3FFF) {
+                // ROM Bank Number (7 bits, 0x00-0x7F)
+                U16 bank = value & 0x7F;
+                if (bank == 0) bank = 1;
+                m_RomBank = bank;
+            }
+            else if (address <= 0x5FFF) {
+                // RAM Bank Number (0x00-0x03) or RTC Register Select (0x08-0x0C)
+                m_RamBank = value;
+            }
+            else {
+                if (m_Rtc) m_Rtc->Latch(value);
+                return;
+            }
+            Remap();
+        }
+
+        [[nodiscard]] Rtc* Clock() const override { return m_Rtc.get(); }
+
+    protected:
+        void Remap() override {
+            MapRom(0, m_RomBank);
+            if (RtcSelected())
+                UnmapRam();
+            else
+                MapRam(m_Ram.size() > RamBankSize ? m_RamBank & 0x03 : 0);
+        }
+
+        [[nodiscard]] U8 ReadUnmapped(U16 address) const override {
+            if (!RtcSelected()) return Mapper::ReadUnmapped(address);
+            if (!m_RamEnabled || !m_Rtc) return 0xFF;
+            return m_Rtc->Read(m_RamBank);
+        }
+
+        void WriteUnmapped(U16 address, U8 value) override {
+            if (!RtcSelected()) {
+                Mapper::WriteUnmapped(address, value);
+                return;
+            }
+            if (m_RamEnabled && m_Rtc) m_Rtc->Write(m_RamBank, value);
+        }
+
+    private:
+        [[nodiscard]] bool RtcSelected() const { return m_RamBank >= 0x08 && m_RamBank <= 0x0C; }
+
+        std::unique_ptr<Rtc> m_Rtc;
+    };
+
+    class Mbc5 final : public Mapper {
+    public:
+        [[nodiscard]] std::unique_ptr<Mapper> Clone() const override { return std::make_unique<Mbc5>(*this); }
+        void Write(U16 address, U8 value) override {
+            if (address <= 0x1FFF) {
+                m_RamEnabled = (value & 0x0F) == 0x0A;
+            }
+            else if (address <= 0x2FFF) {
+                // ROM Bank Number - Low 8 bits
+                m_RomBank = (m_RomBank & 0x100) | value;
+            }
+            else if (address <= 0x3FFF) {
+                // ROM Bank Number - High bit
+                m_RomBank = (m_RomBank & 0xFF) | (static_cast<U16>(value & 0x01) << 8);
+            }
+            else if (address <= 0x5FFF) {
+                // RAM Bank Number (0x00-0x0F)
+                m_RamBank = value & 0x0F;
+            }
+            else {
+                return;
+            }
+            Remap();
+        }
+
+    protected:
+        void Remap() override {
+            MapRom(0, m_RomBank);
+            MapRam(m_Ram.size() > RamBankSize ? m_RamBank & 0x0F : 0);
+        }
+    };
+}
+
+std::unique_ptr<Mapper> Mapper::Create(U8 cartridgeType) {
+    switch (cartridgeType) {
+        case 0x01: case 0x02: case 0x03:
+            return std::make_unique<Mbc1>();
+        case 0x0F: case 0x10:  // MBC3+TIMER
+            return std::make_unique<Mbc3>(true);
+        case 0x11: case 0x12: case 0x13:
+            return std::make_unique<Mbc3>(false);
+        case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E:
+            return std::make_unique<Mbc5>();
+        default:
+            return std::make_unique<NoMbc>();
+    }
+}
+
+void Mapper::Attach(std::span<const U8> rom, std::span<U8> ram) {
+    m_Rom = rom;
+    m_Ram = ram;
+    m_RamHashes.MarkAllDirty();
+    Remap();
+}
+
+void Mapper::MapRom(U32 bank0, U32 bankN) {
+    // Out-of-range banks wrap around the ROM
+    const U32 banks = static_cast<U32>(m_Rom.size() / RomBankSize);
+    bank0 %= banks;
+    bankN %= banks;
+    m_RomMap[0] = m_Rom.data() + bank0 * RomBankSize;
+    m_RomMap[1] = m_Rom.data() + bankN * RomBankSize;
+    m_RomBankN = bankN;
+}
+
+void Mapper::MapRam(U32 bank) {
+    const Size offset = static_cast<Size>(bank) * RamBankSize;
+    const bool backed = offset + RamBankSize <= m_Ram.size();
+    m_RamMap = m_RamEnabled && backed ? m_Ram.data() + offset : nullptr;
+}
+
+U8 Mapper::ReadUnmapped(U16 address) const {
+    const U32 offset = address - 0xA000;
+    if (!m_RamEnabled || m_Ram.size() >= RamBankSize || offset >= m_Ram.size()) {
+        return 0xFF;
+    }
+    return m_Ram[offset];
+}
+
+void Mapper::WriteUnmapped(U16 address, U8 value) {
+    const U32 offset = address - 0xA000;
+    if (m_RamEnabled && m_Ram.size() < RamBankSize && offset < m_Ram.size()) {
+        m_Ram[offset] = value;
+        MarkDirty(offset);
+    }
+}
+
+bool Mapper::TakeDirtyPages(std::span<U8> out) {
+    bool any = false;
+    for (Size word = 0; word < m_DirtyPages.size(); ++word) {
+        for (U64 bits = std::exchange(m_DirtyPages[word], 0); bits != 0; bits &= bits - 1) {
+            const Size offset = (word * 64 + static_cast<Size>(std::countr_zero(bits))) * DirtyPageSize;
+            const Size length = std::min(DirtyPageSize, m_Ram.size() - offset);
+            if (!out.empty()) std::memcpy(out.data() + offset, m_Ram.data() + offset, length);
+            any = true;
+        }
+    }
+    return any;
+}
+
+void Mapper::MarkAllDirty() {
+    for (Size offset = 0; offset < m_Ram.size(); offset += DirtyPageSize) {
+        MarkDirty(offset);
+    }
+}
+
+void Mapper::SaveState(std::ostream& out) const {
+    state::Write(out, m_RomBank);
+    state::Write(out, m_RamBank);
+    state::Write(out, m_RamEnabled);
+    state::Write(out, m_BankingMode);
+}
+
+void Mapper::LoadState(std::istream& in) {
+    state::Read(in, m_RomBank);
+    state::Read(in, m_RamBank);
+    state::Read(in, m_RamEnabled);
+    state::Read(in, m_BankingMode);
+}
+
+void Mapper::Hash(hash::Xxh64& hasher) const {
+    hasher.Add(m_RomBank, m_RamBank, m_RamEnabled, m_BankingMode, m_RamHashes.Digest(m_Ram));
+}
+
+Rtc::Rtc() {
+    m_BaseTimestamp = Now();
+}
+
+U8 Rtc::Read(U8 reg) const {
+    switch (reg) {
+        case 0x08: return m_Latched.Seconds;
+        case 0x09: return m_Latched.Minutes;
+        case 0x0A: return m_Latched.Hours;
+        case 0x0B: return m_Latched.DaysLow;
+        case 0x0C: return m_Latched.DaysHigh;
+        default:   return 0xFF;
+    }
+}
+
+void Rtc::Write(U8 reg, U8 value) {
+    // Sync before writing so we don't lose elapsed time
+    Update();
+    switch (reg) {
+        case 0x08: m_Live.Seconds = value & 0x3F; break;
+        case 0x09: m_Live.Minutes = value & 0x3F; break;
+        case 0x0A: m_Live.Hours = value & 0x1F; break;
+        case 0x0B: m_Live.DaysLow = value; break;
+        case 0x0C: m_Live.DaysHigh = value & 0xC1; break;
+    }
+    // Reset base timestamp to now with current register values
+    m_BaseTimestamp = Now();
+}
+
+void Rtc::Latch(U8 value) {
+    if (m_LatchPrev == 0x00 && value == 0x01) {
+        Update();
+        m_Latched = m_Live;
+    }
+    m_LatchPrev = value;
+}
+
+void Rtc::Update() {
+    // If halted (bit 6 of DaysHigh), don't advance
+    if (m_Live.DaysHigh & 0x40) return;
+
+    S64 now = Now();
+    S64 elapsed = now - m_BaseTimestamp;
+    if (elapsed <= 0) return;
+
+    m_BaseTimestamp = now;
+
+    // Convert current registers to total seconds
+    U16 days = (static_cast<U16>(m_Live.DaysHigh & 0x01) << 8) | m_Live.DaysLow;
+    S64 totalSeconds = static_cast<S64>(days) * 86400
+                     + static_cast<S64>(m_Live.Hours) * 3600
+                     + static_cast<S64>(m_Live.Minutes) * 60
+                     + m_Live.Seconds
+                     + elapsed;
+
+    m_Live.Seconds = static_cast<U8>(totalSeconds % 60);
+    totalSeconds /= 60;
+    m_Live.Minutes = static_cast<U8>(totalSeconds % 60);
+    totalSeconds /= 60;
+    m_Live.Hours = static_cast<U8>(totalSeconds % 24);
+    totalSeconds /= 24;
+
+    days = static_cast<U16>(totalSeconds);
+    m_Live.DaysLow = static_cast<U8>(days & 0xFF);
+    m_Live.DaysHigh = (m_Live.DaysHigh & 0xC0) | ((days >> 8) & 0x01);
+
+    // Day counter overflow (>511 days)
+    if (days > 511) {
+        m_Live.DaysHigh |= 0x80;  // Set carry flag
+        days &= 0x1FF;
+        m_Live.DaysLow = static_cast<U8>(days & 0xFF);
+        m_Live.DaysHigh = (m_Live.DaysHigh & 0xC0) | ((days >> 8) & 0x01);
+    }
+}
+
+S64 Rtc::Now() const {
+    if (!m_Clock)
+        return static_cast<S64>(std::time(nullptr));
+    return m_Epoch + static_cast<S64>((*m_Clock - m_ClockOrigin) / RtcCyclesPerSecond);
+}
+
+void Rtc::UseEmulatedClock(const U64& masterClock, S64 epoch) {
+    Update();
+    m_Clock = &masterClock;
+    m_ClockOrigin = masterClock;
+    m_Epoch = epoch;
+    m_BaseTimestamp = Now();
+}
+
+void Rtc::UseWallClock() {
+    Update();
+    m_Clock = nullptr;
+    m_BaseTimestamp = Now();
+}
+
+// VBA-M format: 5×4 current + 5×4 latched + 8 timestamp = 48 bytes
+void Rtc::LoadFile(std::istream& in) {
+    auto readU32 = [&]() -> U32 {
+        U32 v = 0;
+        in.read(reinterpret_cast<char*>(&v), 4);
+        return v;
+    };
+
+    m_Live.Seconds  = static_cast<U8>(readU32());
+    m_Live.Minutes  = static_cast<U8>(readU32());
+    m_Live.Hours    = static_cast<U8>(readU32());
+    m_Live.DaysLow  = static_cast<U8>(readU32());
+    m_Live.DaysHigh = static_cast<U8>(readU32());
+
+    m_Latched.Seconds  = static_cast<U8>(readU32());
+    m_Latched.Minutes  = static_cast<U8>(readU32());
+    m_Latched.Hours    = static_cast<U8>(readU32());
+    m_Latched.DaysLow  = static_cast<U8>(readU32());
+    m_Latched.DaysHigh = static_cast<U8>(readU32());
+
+    S64 savedTimestamp = 0;
+    in.read(reinterpret_cast<char*>(&savedTimestamp), 8);
+    m_BaseTimestamp = savedTimestamp;
+}
+
+void Rtc::SaveFile(std::ostream& out) const {
+    auto writeU32 = [&](U32 v) {
+        out.write(reinterpret_cast<const char*>(&v), 4);
+    };
+
+    writeU32(m_Live.Seconds);
+    writeU32(m_Live.Minutes);
+    writeU32(m_Live.Hours);
+    writeU32(m_Live.DaysLow);
+    writeU32(m_Live.DaysHigh);
+
+    writeU32(m_Latched.Seconds);
+    writeU32(m_Latched.Minutes);
+    writeU32(m_Latched.Hours);
+    writeU32(m_Latched.DaysLow);
+    writeU32(m_Latched.DaysHigh);
+
+    S64 timestamp = Now();
+    out.write(reinterpret_cast<const char*>(&timestamp), 8);
+}
+
+Rtc Rtc::Synced() const {
+    Rtc synced{*this};
+    synced.Update();
+    return synced;
+}
+
+void Rtc::SaveState(std::ostream& out) const {
+    // Elapsed time is applied lazily; writing it out makes equal states
+    // serialize equally however recently the game read the clock
+    const Rtc synced = Synced();
+    synced.SaveFields(out);
+}
+
+void Rtc::SaveFields(std::ostream& out) const {
+    state::Write(out, m_Live.Seconds);
+    state::Write(out, m_Live.Minutes);
+    state::Write(out, m_Live.Hours);
+    state::Write(out, m_Live.DaysLow);
+    state::Write(out, m_Live.DaysHigh);
+    state::Write(out, m_Latched.Seconds);
+    state::Write(out, m_Latched.Minutes);
+    state::Write(out, m_Latched.Hours);
+    state::Write(out, m_Latched.DaysLow);
+    state::Write(out, m_Latched.DaysHigh);
+    state::Write(out, m_BaseTimestamp);
+    state::Write(out, m_LatchedFlag);
+    state::Write(out, m_LatchPrev);
+}
+
+void Rtc::Hash(hash::Xxh64& hasher) const {
+    const Rtc synced = Synced();
+    synced.HashFields(hasher);
+}
+
+void Rtc::HashFields(hash::Xxh64& hasher) const {
+    hasher.Add(m_Live.Seconds, m_Live.Minutes, m_Live.Hours, m_Live.DaysLow, m_Live.DaysHigh);
+    hasher.Add(m_Latched.Seconds, m_Latched.Minutes, m_Latched.Hours, m_Latched.DaysLow, m_Latched.DaysHigh);
+    hasher.Add(m_BaseTimestamp, m_LatchedFlag, m_LatchPrev);
+}
+
+void Rtc::LoadState(std::istream& in) {
+    state::Read(in, m_Live.Seconds);
+    state::Read(in, m_Live.Minutes);
+    state::Read(in, m_Live.Hours);
+    state::Read(in, m_Live.DaysLow);
+    state::Read(in, m_Live.DaysHigh);
+    state::Read(in, m_Latched.Seconds);
+    state::Read(in, m_Latched.Minutes);
+    state::Read(in, m_Latched.Hours);
+    state::Read(in, m_Latched.DaysLow);
+    state::Read(in, m_Latched.DaysHigh);
+    state::Read(in, m_BaseTimestamp);
+    state::Read(in, m_LatchedFlag);
+    state::Read(in, m_LatchPrev);
+    // Emulated time doesn't pass while a state sits on disk
+    if (m_Clock)
+        m_BaseTimestamp = Now();
+}
+
+} // namespace gb
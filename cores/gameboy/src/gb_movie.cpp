@@ -0,0 +1,161 @@
+#include <gb_movie.hpp>
+#include <chrono>
+#include <ctime>
+#include <format>
+#include <fstream>
+#include <print>
+#include <span>
+#include <sstream>
+
+#include <gb.hpp>
+#include <compress.hpp>
+#include <hash.hpp>
+#include <state.hpp>
+
+namespace gb {
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using Seconds = std::chrono::duration<double>;
+
+    constexpr U32 Magic = 0x564D4850;  // "PHMV"
+    constexpr U8 Version = 1;
+
+    // Frames are ~59.73 Hz: 70224 cycles at 4.194304 MHz
+    constexpr double FrameRate = APU::CPUFrequency / 70224.0;
+
+    U32 RomCrc(GameBoy& gb)
+    {
+        const auto& rom = gb.GetBus().GetCartridge().Data();
+        return hash::Crc32(rom.data(), rom.size());
+    }
+}
+
+std::expected<Movie, std::string> Movie::Record(GameBoy& gb)
+{
+    Movie movie;
+    movie.m_RomCrc = RomCrc(gb);
+    movie.m_RtcSeed = static_cast<S64>(std::time(nullptr));
+    gb.UseEmulatedRTC(movie.m_RtcSeed);
+
+    std::ostringstream snapshot{std::ios::binary};
+    if (!gb.SaveState(snapshot))
+        return std::unexpected("Cannot snapshot the machine for recording");
+    const auto bytes = std::move(snapshot).str();
+    movie.m_State.assign(bytes.begin(), bytes.end());
+    return movie;
+}
+
+std::expected<Movie, std::string> Movie::Load(std::string_view path)
+{
+    std::ifstream file{std::string(path), std::ios::binary};
+    if (!file)
+        return std::unexpected(std::format("Cannot open movie: {}", path));
+
+    U32 magic = 0;
+    U8 version = 0;
+    state::Read(file, magic);
+    state::Read(file, version);
+    if (!file || magic != Magic)
+        return std::unexpected(std::format("Not a movie file: {}", path));
+    if (version != Version)
+        return std::unexpected(std::format("Unsupported movie version {} in {}", version, path));
+
+    // Every size below comes from the file; none is allocated unchecked
+    const auto start = file.tellg();
+    file.seekg(0, std::ios::end);
+    const auto fileSize = static_cast<Size>(file.tellg());
+    file.seekg(start);
+
+    Movie movie;
+    U32 stateSize = 0;
+    U32 frames = 0;
+    std::vector<U8> compressedState;
+    std::vector<U8> compressedInputs;
+    state::Read(file, movie.m_RomCrc);
+    state::Read(file, movie.m_RtcSeed);
+    state::Read(file, stateSize);
+    state::Read(file, compressedState, fileSize);
+    state::Read(file, frames);
+    state::Read(file, compressedInputs, fileSize);
+    if (!file || stateSize > state::MaxRawSize || frames > compress::DecompressBound(compressedInputs.size()))
+        return std::unexpected(std::format("Corrupt movie: {}", path));
+
+    movie.m_State.resize(stateSize);
+    movie.m_Inputs.resize(frames);
+    if (!compress::Decompress(compressedState, movie.m_State)
+        || !compress::Decompress(compressedInputs, movie.m_Inputs))
+        return std::unexpected(std::format("Corrupt movie: {}", path));
+    return movie;
+}
+
+bool Movie::Save(std::string_view path) const
+{
+    std::ofstream file{std::string(path), std::ios::binary};
+    if (!file) return false;
+
+    state::Write(file, Magic);
+    state::Write(file, Version);
+    state::Write(file, m_RomCrc);
+    state::Write(file, m_RtcSeed);
+    state::Write(file, static_cast<U32>(m_State.size()));
+    state::Write(file, compress::Compress(m_State));
+    state::Write(file, static_cast<U32>(m_Inputs.size()));
+    state::Write(file, compress::Compress(m_Inputs));
+    return file.good();
+}
+
+std::expected<void, std::string> Movie::Start(GameBoy& gb) const
+{
+    if (RomCrc(gb) != m_RomCrc)
+        return std::unexpected("Movie was recorded with a different ROM");
+
+    std::istringstream snapshot{std::string(m_State.begin(), m_State.end()), std::ios::binary};
+    if (!gb.LoadState(snapshot))
+        return std::unexpected("Movie start state does not load");
+    // The state restores the master clock; anchor the seed to it as Record() did
+    gb.UseEmulatedRTC(m_RtcSeed);
+    return {};
+}
+
+S32 ReplayMovie(const std::string& romPath, const std::string& moviePath)
+{
+    auto movie = Movie::Load(moviePath);
+    if (!movie)
+    {
+        std::println(stderr, "{}", movie.error());
+        return 1;
+    }
+    auto cart = Cartridge::Load(romPath);
+    if (!cart)
+    {
+        std::println(stderr, "Failed to load ROM: {}", cart.error());
+        return 1;
+    }
+
+    GameBoy gb{std::move(*cart)};
+    if (auto started = movie->Start(gb); !started)
+    {
+        std::println(stderr, "{}", started.error());
+        return 1;
+    }
+
+    const auto start = Clock::now();
+    for (Size frame = 0; frame < movie->FrameCount(); ++frame)
+    {
+        gb.GetBus().GetJoypad().SetButtons(movie->Buttons(frame));
+        gb.RunUntilFrame();
+        gb.GetAPU().ClearBuffer();
+    }
+    const double seconds = Seconds{Clock::now() - start}.count();
+
+    const auto& frame = gb.GetPPU().GetFramebuffer();
+    const double fps = static_cast<double>(movie->FrameCount()) / seconds;
+    std::println("Replayed {} frames in {:.3f}s: {:.1f} fps ({:.2f}x real time)",
+        movie->FrameCount(), seconds, fps, fps / FrameRate);
+    std::println("Final frame: {:016x}", hash::Xxh64Of(std::span<const U32>{frame}));
+    std::println("Final state: {:016x}", gb.StateHash());
+    return 0;
+}
+
+} // namespace gb
@@ -0,0 +1,370 @@
+#include <gb_netplay.hpp>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <print>
+#include <spanstream>
+#include <sstream>
+
+#include <gb.hpp>
+#include <hash.hpp>
+#include <instrument.hpp>
+
+namespace gb {
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+
+    // Magic, ack, first frame, input count, hash frame, hash; then the inputs
+    constexpr U32 PacketMagic = state::SectionId("PNET");
+    constexpr Size PacketHeaderSize = 4 + 4 + 4 + 2 + 4 + 8;
+    // Unacknowledged input past this is split across packets
+    constexpr U32 MaxPacketInputs = 128;
+    static_assert(PacketHeaderSize + MaxPacketInputs <= net::Transport::MaxPacketSize);
+
+    // How long the self-test waits for both sides to confirm the last frame
+    constexpr U32 DrainTicks = 1000;
+    // Loopback ticks each way for the run at the largest delay and rollback
+    constexpr U32 StressLatency = 90;
+}
+
+RollbackSession::RollbackSession(GameBoy& gb, net::Transport& transport, const NetplayOptions& options)
+    : m_GameBoy{gb}
+    , m_Transport{transport}
+    , m_Options{options}
+{
+    m_Options.InputDelay = std::min(options.InputDelay, MaxInputDelay);
+    m_Options.MaxRollback = std::clamp(options.MaxRollback, 1u, MaxRollbackLimit);
+    // Nothing is pressed during the delay at the start; the peer learns that
+    // like any other input, so the two sides may use different delays
+    m_LocalCount = m_Options.InputDelay;
+    m_Snapshots.resize(m_Options.MaxRollback + 1);
+}
+
+bool RollbackSession::AdvanceFrame(U8 buttons)
+{
+    m_Stats.LastResimulated = 0;
+    m_Stats.LastResimulationMs = 0.0;
+    Receive();
+
+    const bool stalled = m_Frame >= m_RemoteCount + m_Options.MaxRollback;
+    if (!stalled)
+        m_LocalInputs[m_LocalCount++ % InputWindow] = buttons;
+    Rollback();
+    SendInput();
+    if (stalled)
+    {
+        ++m_Stats.StalledFrames;
+        return false;
+    }
+
+    SimulateFrame();
+    ++m_Stats.Frames;
+    return true;
+}
+
+void RollbackSession::Poll()
+{
+    m_Stats.LastResimulated = 0;
+    m_Stats.LastResimulationMs = 0.0;
+    Receive();
+    Rollback();
+    SendInput();
+}
+
+void RollbackSession::Receive()
+{
+    while (auto packet = m_Transport.Receive())
+        HandlePacket(*packet);
+}
+
+void RollbackSession::HandlePacket(std::span<const U8> packet)
+{
+    std::ispanstream in{std::span{reinterpret_cast<const char*>(packet.data()), packet.size()}};
+    U32 magic = 0;
+    U32 ack = 0;
+    U32 first = 0;
+    U16 count = 0;
+    U32 hashFrame = NoFrame;
+    U64 hash = 0;
+    state::Read(in, magic);
+    state::Read(in, ack);
+    state::Read(in, first);
+    state::Read(in, count);
+    state::Read(in, hashFrame);
+    state::Read(in, hash);
+    if (in.fail() || magic != PacketMagic || packet.size() != PacketHeaderSize + count)
+        return;
+
+    m_PeerAck = std::max(m_PeerAck, ack);
+
+    // Only extend the received run; anything older is a duplicate and a gap
+    // is filled by the next packet, which resends from our ack. The limit
+    // keeps the ring from overwriting frames a rollback may still read.
+    const U32 limit = m_Frame + InputWindow - MaxRollbackLimit - 1;
+    for (U32 i = 0; i < count; ++i)
+    {
+        const U32 frame = first + i;
+        if (frame != m_RemoteCount)
+            continue;
+        if (frame >= limit)
+            break;
+        const U8 input = packet[PacketHeaderSize + i];
+        m_RemoteInputs[frame % InputWindow] = input;
+        if (frame < m_Frame && input != m_UsedRemote[frame % InputWindow])
+            m_RollbackFrom = std::min(m_RollbackFrom, frame);
+        ++m_RemoteCount;
+    }
+
+    if (hashFrame != NoFrame && !m_Stats.Desynced)
+    {
+        const auto local = ConfirmedHash(hashFrame);
+        if (local && *local != hash)
+        {
+            m_Stats.Desynced = true;
+            m_Stats.DesyncFrame = hashFrame;
+            std::println(stderr, "Netplay desync: states differ at frame {}", hashFrame);
+        }
+    }
+}
+
+void RollbackSession::SendInput()
+{
+    const U32 hashFrame = ConfirmedFrame() / HashInterval * HashInterval;
+    const auto hash = ConfirmedHash(hashFrame);
+
+    // Everything the peer has not acknowledged, so a lost packet costs
+    // nothing; the peer only takes input in order, so a long run goes out
+    // in as many packets as it needs
+    U32 first = std::min(m_PeerAck, m_LocalCount);
+    do
+    {
+        const U32 count = std::min(m_LocalCount - first, MaxPacketInputs);
+
+        std::ostringstream out{std::ios::binary};
+        state::Write(out, PacketMagic);
+        state::Write(out, m_RemoteCount);
+        state::Write(out, first);
+        state::Write(out, static_cast<U16>(count));
+        state::Write(out, hash ? hashFrame : NoFrame);
+        state::Write(out, hash.value_or(0));
+        for (U32 frame = first; frame < first + count; ++frame)
+            state::Write(out, m_LocalInputs[frame % InputWindow]);
+
+        const std::string packet = std::move(out).str();
+        m_Transport.Send({reinterpret_cast<const U8*>(packet.data()), packet.size()});
+        first += count;
+    } while (first < m_LocalCount);
+}
+
+void RollbackSession::Rollback()
+{
+    if (m_RollbackFrom >= m_Frame)
+    {
+        m_RollbackFrom = NoFrame;
+        return;
+    }
+
+    PHOSPHOR_SPAN(instrument::Zone::Rollback);
+    const auto start = Clock::now();
+    const U32 target = m_Frame;
+    const U32 depth = target - m_RollbackFrom;
+
+    // The first wrong frame ran on a prediction, so it has a snapshot
+    m_GameBoy.RestoreState(m_Snapshots[m_RollbackFrom % m_Snapshots.size()]);
+    m_Frame = m_RollbackFrom;
+    m_RollbackFrom = NoFrame;
+
+    // Re-runs are neither shown nor heard
+    const bool rendering = m_GameBoy.GetPPU().RenderingEnabled();
+    m_GameBoy.SetRenderingEnabled(false);
+    while (m_Frame < target)
+    {
+        SimulateFrame();
+        m_GameBoy.GetAPU().ClearBuffer();
+    }
+    m_GameBoy.SetRenderingEnabled(rendering);
+
+    const double ms = Milliseconds{Clock::now() - start}.count();
+    ++m_Stats.Rollbacks;
+    m_Stats.ResimulatedFrames += depth;
+    m_Stats.MaxRollbackDepth = std::max(m_Stats.MaxRollbackDepth, depth);
+    m_Stats.LastResimulated += depth;
+    m_Stats.LastResimulationMs += ms;
+    m_Stats.MaxResimulationMs = std::max(m_Stats.MaxResimulationMs, ms);
+    m_Stats.TotalResimulationMs += ms;
+}
+
+void RollbackSession::SimulateFrame()
+{
+    // Frames with all input known are never restored, so skip their snapshot
+    if (m_Frame >= m_RemoteCount)
+    {
+        const auto start = Clock::now();
+        m_Snapshots[m_Frame % m_Snapshots.size()] = m_GameBoy.CaptureState();
+        m_Stats.TotalSnapshotMs += Milliseconds{Clock::now() - start}.count();
+    }
+    if (m_Frame % HashInterval == 0)
+        m_Hashes[m_Frame / HashInterval % HashSlots] = {m_Frame, m_GameBoy.StateHash()};
+
+    const U32 slot = m_Frame % InputWindow;
+    m_UsedRemote[slot] = RemoteInput(m_Frame);
+    m_GameBoy.GetBus().GetJoypad().SetButtons(m_LocalInputs[slot] | m_UsedRemote[slot]);
+    m_GameBoy.RunUntilFrame();
+    ++m_Frame;
+}
+
+U8 RollbackSession::RemoteInput(U32 frame) const
+{
+    if (frame < m_RemoteCount)
+        return m_RemoteInputs[frame % InputWindow];
+    // Predict that the peer still holds what it last pressed
+    return m_RemoteCount > 0 ? m_RemoteInputs[(m_RemoteCount - 1) % InputWindow] : U8{0};
+}
+
+std::optional<U64> RollbackSession::ConfirmedHash(U32 frame) const
+{
+    // The state at the start of `frame` depends on the input of earlier frames only
+    if (frame > ConfirmedFrame() || m_RollbackFrom < frame)
+        return std::nullopt;
+    const StoredHash& stored = m_Hashes[frame / HashInterval % HashSlots];
+    if (stored.Frame != frame)
+        return std::nullopt;
+    return stored.Hash;
+}
+
+namespace {
+    // Each player holds a button combination for a while, then switches
+    U8 ScriptedInput(U32 player, U32 frame, U32 inputDelay)
+    {
+        if (frame < inputDelay)
+            return 0;
+        const U64 key = (static_cast<U64>(player) << 32) | (frame / 12);
+        return static_cast<U8>(hash::Xxh64Of(&key, sizeof(key)));
+    }
+
+    double Percentile(std::vector<double> values, double fraction)
+    {
+        if (values.empty())
+            return 0.0;
+        const auto index = static_cast<Size>(fraction * static_cast<double>(values.size() - 1));
+        std::ranges::nth_element(values, values.begin() + static_cast<std::ptrdiff_t>(index));
+        return values[index];
+    }
+
+    // One run of the self-test; prints its report and returns whether both
+    // sides ended in the reference state
+    bool RunSelfTestPass(const std::string& romPath, const NetplayTestOptions& options)
+    {
+        // The same ROM, RTC and power-on state everywhere; like a real session, no .sav
+        const S64 epoch = static_cast<S64>(std::time(nullptr));
+        std::array<std::unique_ptr<GameBoy>, 3> machines;
+        for (auto& machine : machines)
+        {
+            auto cart = Cartridge::LoadRom(romPath);
+            if (!cart)
+            {
+                std::println(stderr, "Failed to load ROM: {}", cart.error());
+                return false;
+            }
+            machine = std::make_unique<GameBoy>(std::move(*cart));
+            machine->UseEmulatedRTC(epoch);
+        }
+
+        net::Loopback loopback{options.Latency, options.DropEvery};
+        std::array<RollbackSession, 2> sessions{
+            RollbackSession{*machines[0], loopback.End(0), options.Session},
+            RollbackSession{*machines[1], loopback.End(1), options.Session},
+        };
+        const U32 delay = std::min(options.Session.InputDelay, RollbackSession::MaxInputDelay);
+
+        std::vector<double> frameMs;
+        frameMs.reserve(static_cast<Size>(options.Frames) * 2);
+        const auto start = Clock::now();
+        U32 ticks = 0;
+        auto done = [&](auto frameOf) {
+            return std::ranges::all_of(sessions, [&](const RollbackSession& session) { return frameOf(session) >= options.Frames; });
+        };
+        while (!done([](const RollbackSession& session) { return session.Frame(); }))
+        {
+            for (U32 player = 0; player < sessions.size(); ++player)
+            {
+                auto& session = sessions[player];
+                if (session.Frame() >= options.Frames)
+                {
+                    session.Poll();
+                    continue;
+                }
+                if (session.AdvanceFrame(ScriptedInput(player, session.Frame() + delay, delay)))
+                    frameMs.push_back(session.Stats().LastResimulationMs);
+                machines[player]->GetAPU().ClearBuffer();
+            }
+            loopback.Tick();
+            ++ticks;
+        }
+        // Let the last inputs arrive and get corrected for
+        for (U32 drain = 0; drain < DrainTicks && !done([](const RollbackSession& session) { return session.ConfirmedFrame(); }); ++drain)
+        {
+            for (auto& session : sessions)
+                session.Poll();
+            loopback.Tick();
+        }
+        const double seconds = std::chrono::duration<double>{Clock::now() - start}.count();
+
+        // Reference: a plain run with the combined input
+        auto& reference = *machines[2];
+        for (U32 frame = 0; frame < options.Frames; ++frame)
+        {
+            reference.GetBus().GetJoypad().SetButtons(ScriptedInput(0, frame, delay) | ScriptedInput(1, frame, delay));
+            reference.RunUntilFrame();
+            reference.GetAPU().ClearBuffer();
+        }
+
+        std::println("Netplay self-test: {} frames, latency {} frames, every {} packet lost, input delay {}, max rollback {}",
+            options.Frames, options.Latency, options.DropEvery, delay, options.Session.MaxRollback);
+        std::println("{:<8} {:>9} {:>10} {:>10} {:>13} {:>12} {:>12} {:>12}",
+            "Side", "Stalls", "Rollbacks", "Re-run", "Max depth", "Resim avg", "Resim max", "Snapshot");
+        for (U32 player = 0; player < sessions.size(); ++player)
+        {
+            const auto& stats = sessions[player].Stats();
+            const auto frames = static_cast<double>(std::max<U64>(stats.Frames, 1));
+            std::println("{:<8} {:>9} {:>10} {:>10} {:>13} {:>9.3f} ms {:>9.3f} ms {:>9.3f} ms",
+                player, stats.StalledFrames, stats.Rollbacks, stats.ResimulatedFrames, stats.MaxRollbackDepth,
+                stats.TotalResimulationMs / frames, stats.MaxResimulationMs, stats.TotalSnapshotMs / frames);
+        }
+        std::println("Resimulation per frame: p50 {:.3f} ms, p99 {:.3f} ms ({} ticks, {:.2f}s)",
+            Percentile(frameMs, 0.5), Percentile(frameMs, 0.99), ticks, seconds);
+
+        const U64 expected = reference.StateHash();
+        bool pass = true;
+        for (U32 player = 0; player < sessions.size(); ++player)
+        {
+            const U64 actual = machines[player]->StateHash();
+            const bool confirmed = sessions[player].ConfirmedFrame() >= options.Frames;
+            const bool match = confirmed && actual == expected && !sessions[player].Stats().Desynced;
+            std::println("Side {}: state {:016x} {}", player, actual, match ? "matches" : "MISMATCH");
+            pass = pass && match;
+        }
+        std::println("Reference: state {:016x}", expected);
+        return pass;
+    }
+}
+
+S32 RunNetplaySelfTest(const std::string& romPath, const NetplayTestOptions& options)
+{
+    bool pass = RunSelfTestPass(romPath, options);
+
+    // The largest delay and rollback over a slow link leave more input
+    // unacknowledged than one packet holds
+    NetplayTestOptions stress = options;
+    stress.Latency = StressLatency;
+    stress.Session = {RollbackSession::MaxInputDelay, RollbackSession::MaxRollbackLimit};
+    pass = RunSelfTestPass(romPath, stress) && pass;
+
+    std::println("{}", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+} // namespace gb
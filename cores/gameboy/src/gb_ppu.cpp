@@ -3,46 +3,48 @@
 #include <ostream>
 #include <istream>
 #include <state.hpp>
+#include <instrument.hpp>
 
 namespace gb {
 
-PPU::PPU(bool cgbMode)
-    : m_CgbMode{cgbMode}
+PPU::PPU(const U64& clock, bool cgbMode)
+    : m_Clock{clock}
+    , m_LineStart{clock}
+    , m_CgbMode{cgbMode}
 {
 }
 
-void PPU::Tick(U8 mCycles)
+template<Model M>
+void PPU::Tick()
 {
+    const U64 position = m_Clock - m_LineStart;
+
     // When LCD is off, still count cycles for frame timing
     if (!(m_LCDC & 0x80))
     {
-        m_Cycles += mCycles;
-        // 154 scanlines * 456 cycles = 70224 cycles per frame
-        if (m_Cycles >= 70224)
+        if (position >= CyclesPerFrame)
         {
-            m_Cycles -= static_cast<U16>(70224);
+            m_LineStart += CyclesPerFrame;
             m_FrameReady = true;
         }
         return;
     }
 
-    m_Cycles += mCycles;
-
     switch (m_Mode)
     {
     case PPUMode::OAMScan:
-        if (m_Cycles >= OAMScanCycles)
+        if (position >= OAMScanCycles)
         {
             m_Mode = PPUMode::Drawing;
         }
         break;
 
     case PPUMode::Drawing:
-        if (m_Cycles >= OAMScanCycles + DrawingCycles)
+        if (position >= OAMScanCycles + DrawingCycles)
         {
             m_Mode = PPUMode::HBlank;
             m_HBlankStart = true;
-            DrawScanline();
+            DrawScanline<M>();
             // STAT interrupt on Mode 0 (HBlank) if bit 3 is set
             if (m_STAT & 0x08)
                 m_StatInterrupt = true;
@@ -50,9 +52,9 @@ void PPU::Tick(U8 mCycles)
         break;
 
     case PPUMode::HBlank:
-        if (m_Cycles >= CyclesPerScanline)
+        if (position >= CyclesPerScanline)
         {
-            m_Cycles -= CyclesPerScanline;
+            m_LineStart += CyclesPerScanline;
             m_LY++;
 
             if (m_LY == ScreenHeight)
@@ -74,9 +76,9 @@ void PPU::Tick(U8 mCycles)
         break;
 
     case PPUMode::VBlank:
-        if (m_Cycles >= CyclesPerScanline)
+        if (position >= CyclesPerScanline)
         {
-            m_Cycles -= CyclesPerScanline;
+            m_LineStart += CyclesPerScanline;
             m_LY++;
 
             if (m_LY > 153)
@@ -144,10 +146,14 @@ bool PPU::Write(U16 address, U8 value)
         if ((m_LCDC & 0x80) && !(value & 0x80))
         {
             m_LY = 0;
-            m_Cycles = 0;
+            m_LineStart = m_Clock;
             m_Mode = PPUMode::HBlank;
             m_STAT = (m_STAT & 0xFC);
         }
+        // Turned back on: line 0 starts now, in mode 0 as on hardware,
+        // rather than wherever the LCD-off frame count had got to
+        else if (!(m_LCDC & 0x80) && (value & 0x80))
+            m_LineStart = m_Clock;
         m_LCDC = value;
         return true;
     case 0xFF41:
@@ -224,21 +230,6 @@ bool PPU::HBlankStarted()
     return started;
 }
 
-U8 PPU::ReadVRAM(U16 address) const
-{
-    if (m_CgbMode)
-        return m_VRAM[(m_VBK & 1) * 0x2000 + (address & 0x1FFF)];
-    return m_VRAM[address & 0x1FFF];
-}
-
-void PPU::WriteVRAM(U16 address, U8 value)
-{
-    if (m_CgbMode)
-        m_VRAM[(m_VBK & 1) * 0x2000 + (address & 0x1FFF)] = value;
-    else
-        m_VRAM[address & 0x1FFF] = value;
-}
-
 U8 PPU::ReadOAM(U16 address) const
 {
     // TODO: Block during Mode 2/3 for accuracy
@@ -251,18 +242,29 @@ void PPU::WriteOAM(U16 address, U8 value)
     m_OAM[address & 0xFF] = value;
 }
 
+template<Model M>
 void PPU::DrawScanline()
 {
+    constexpr bool cgb = M == Model::Cgb;
+    PHOSPHOR_SPAN(instrument::Zone::Render);
     if (!(m_LCDC & 0x80))
         return;
 
+    if (!m_RenderingEnabled)
+    {
+        // Keep the window line counter in step so the next rendered frame is correct
+        if ((m_LCDC & 0x20) && m_WY <= m_LY && m_WX - 7 < ScreenWidth)
+            m_WindowLine++;
+        return;
+    }
+
     // Clear per-scanline tracking
     m_BgColorIndices.fill(0);
     m_BgAttributes.fill(0);
 
     // Background (LCDC bit 0 on DMG disables BG; on CGB it controls priority only)
     const bool bgEnabled = m_LCDC & 0x01;
-    if (bgEnabled || m_CgbMode)
+    if (bgEnabled || cgb)
     {
         const U16 tileMapBase = (m_LCDC & 0x08) ? 0x1C00 : 0x1800;
         const bool unsignedMode = m_LCDC & 0x10;
@@ -285,7 +287,7 @@ void PPU::DrawScanline()
             else
                 tileDataAddr = 0x1000 + static_cast<S8>(tileIndex) * 16;
 
-            if (m_CgbMode)
+            if constexpr (cgb)
             {
                 const U8 attrs = m_VRAM[0x2000 + tileMapAddr];
                 const U8 cgbPalette = attrs & 0x07;
@@ -348,7 +350,7 @@ void PPU::DrawScanline()
                 else
                     tileDataAddr = 0x1000 + static_cast<S8>(tileIndex) * 16;
 
-                if (m_CgbMode)
+                if constexpr (cgb)
                 {
                     const U8 attrs = m_VRAM[0x2000 + tileMapAddr];
                     const U8 cgbPalette = attrs & 0x07;
@@ -416,7 +418,7 @@ void PPU::DrawScanline()
         }
 
         // DMG: sort by X (lower X = higher priority). CGB: OAM order only.
-        if (!m_CgbMode)
+        if constexpr (!cgb)
         {
             for (S32 i = 0; i < spriteCount - 1; i++)
             {
@@ -445,7 +447,7 @@ void PPU::DrawScanline()
                 tileIndex &= 0xFE;
 
             const U16 tileDataAddr = tileIndex * 16 + row * 2;
-            const U16 bankOffset = (m_CgbMode && (sprite.attrs & 0x08)) ? 0x2000 : 0;
+            const U16 bankOffset = (cgb && (sprite.attrs & 0x08)) ? 0x2000 : 0;
 
             for (S32 px = 0; px < 8; px++)
             {
@@ -462,7 +464,7 @@ void PPU::DrawScanline()
                     continue;
 
                 // Priority check
-                if (m_CgbMode)
+                if constexpr (cgb)
                 {
                     // CGB: sprite hidden behind BG if (LCDC bit 0 enabled) AND (bgColorIndex != 0)
                     // AND (OAM priority bit OR BG attr priority bit)
@@ -505,7 +507,7 @@ U32 PPU::CgbColorToARGB(U8 low, U8 high)
 
 void PPU::SaveState(std::ostream& out) const
 {
-    state::Write(out, m_Cycles);
+    state::Write(out, static_cast<U32>(m_Clock - m_LineStart));
     state::Write(out, static_cast<U8>(m_Mode));
     state::Write(out, m_LCDC);
     state::Write(out, m_STAT);
@@ -533,9 +535,27 @@ void PPU::SaveState(std::ostream& out) const
     state::Write(out, m_ObjPaletteRAM);
 }
 
-void PPU::LoadState(std::istream& in)
+void PPU::Hash(hash::Xxh64& hasher) const
+{
+    hasher.Add(static_cast<U32>(m_Clock - m_LineStart), m_Mode, m_LCDC, m_STAT, m_SCY, m_SCX, m_LY, m_LYC);
+    hasher.Add(m_BGP, m_OBP0, m_OBP1, m_WY, m_WX);
+    hasher.Add(m_VramHashes.Digest(m_VRAM), m_OAM);
+    hasher.Add(m_WindowLine, m_VBlankInterrupt, m_StatInterrupt, m_FrameReady);
+    hasher.Add(m_VBK, m_BCPS, m_OCPS, m_BgPaletteRAM, m_ObjPaletteRAM);
+}
+
+void PPU::LoadState(std::istream& in, U16 version)
 {
-    state::Read(in, m_Cycles);
+    U32 position = 0;
+    if (version < 2)
+    {
+        U16 legacyPosition = 0;
+        state::Read(in, legacyPosition);
+        position = legacyPosition;
+    }
+    else
+        state::Read(in, position);
+    m_LineStart = m_Clock - position;
     U8 mode;
     state::Read(in, mode);
     m_Mode = static_cast<PPUMode>(mode);
@@ -551,6 +571,7 @@ void PPU::LoadState(std::istream& in)
     state::Read(in, m_WY);
     state::Read(in, m_WX);
     state::Read(in, m_VRAM);
+    m_VramHashes.MarkAllDirty();
     state::Read(in, m_OAM);
     state::Read(in, m_Framebuffer);
     state::Read(in, m_WindowLine);
@@ -565,4 +586,7 @@ void PPU::LoadState(std::istream& in)
     state::Read(in, m_ObjPaletteRAM);
 }
 
+template void PPU::Tick<Model::Dmg>();
+template void PPU::Tick<Model::Cgb>();
+
 } // namespace gb
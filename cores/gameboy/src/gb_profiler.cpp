@@ -0,0 +1,215 @@
+#include <gb_profiler.hpp>
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <string>
+
+#include <gb_bus.hpp>
+#include <gb_cpu.hpp>
+
+namespace gb {
+
+namespace {
+    constexpr U32 RootFunction = 0xFFFFFFFF;
+    constexpr Size HotPcCount = 64;
+
+    constexpr U32 Key(U32 bank, U16 pc) { return (bank << 16) | pc; }
+
+    std::string Location(U32 key)
+    {
+        const U16 pc = static_cast<U16>(key & 0xFFFF);
+        if (pc >= 0x4000 && pc < 0x8000)
+            return std::format("{:02X}:{:04X}", key >> 16, pc);
+        return std::format("{:04X}", pc);
+    }
+
+    bool IsCall(U8 opcode)
+    {
+        return opcode == 0xCD || (opcode & 0xE7) == 0xC4 || (opcode & 0xC7) == 0xC7;
+    }
+
+    bool IsReturn(U8 opcode)
+    {
+        return opcode == 0xC9 || opcode == 0xD9 || (opcode & 0xE7) == 0xC0;
+    }
+
+    double Percent(U64 part, U64 total)
+    {
+        return total == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(total);
+    }
+}
+
+Profiler::Profiler()
+{
+    m_Nodes.push_back({RootFunction, 0, 0, {}});
+}
+
+void Profiler::Instruction(U32 bank, U16 pc, U8 opcode, U8 cbOpcode, U32 cycles)
+{
+    auto& op = m_Opcodes[opcode];
+    ++op.Count;
+    op.Cycles += cycles;
+    if (opcode == 0xCB)
+    {
+        auto& cb = m_CbOpcodes[cbOpcode];
+        ++cb.Count;
+        cb.Cycles += cycles;
+    }
+
+    auto& hot = m_Pcs[Key(bank, pc)];
+    ++hot.Count;
+    hot.Cycles += cycles;
+
+    m_Nodes[m_Current].Cycles += cycles;
+}
+
+void Profiler::Interrupt(U16 vector, U32 cycles)
+{
+    m_InterruptCycles += cycles;
+    Call(0, vector);
+}
+
+void Profiler::Call(U32 bank, U16 target)
+{
+    if (m_Depth >= MaxCallDepth)
+    {
+        m_Current = 0;
+        m_Depth = 0;
+    }
+
+    const U32 function = Key(target >= 0x4000 && target < 0x8000 ? bank : 0, target);
+    auto& children = m_Nodes[m_Current].Children;
+    auto it = children.find(function);
+    if (it == children.end())
+    {
+        const U32 index = static_cast<U32>(m_Nodes.size());
+        // Insert before push_back: growing m_Nodes invalidates `children`
+        it = children.emplace(function, index).first;
+        m_Nodes.push_back({function, m_Current, 0, {}});
+    }
+    m_Current = it->second;
+    ++m_Depth;
+}
+
+void Profiler::Return()
+{
+    // Unbalanced RETs (stack tricks, jump tables) just stay at the root
+    if (m_Depth == 0)
+        return;
+    m_Current = m_Nodes[m_Current].Parent;
+    --m_Depth;
+}
+
+bool Profiler::WriteReport(const std::filesystem::path& path) const
+{
+    std::ofstream out{path};
+    if (!out) return false;
+
+    U64 instructions = 0, cycles = 0;
+    for (const auto& op : m_Opcodes)
+    {
+        instructions += op.Count;
+        cycles += op.Cycles;
+    }
+    const U64 total = cycles + m_HaltedCycles + m_InterruptCycles;
+
+    out << std::format("{} instructions, {} cycles; {:.1f}% halted, {:.1f}% interrupt dispatch\n",
+        instructions, total, Percent(m_HaltedCycles, total), Percent(m_InterruptCycles, total));
+
+    auto writeOpcodes = [&](const char* title, const char* prefix, const std::array<Counter, 256>& counters) {
+        std::vector<U32> order;
+        for (U32 i = 0; i < 256; ++i)
+            if (counters[i].Count > 0)
+                order.push_back(i);
+        std::sort(order.begin(), order.end(), [&](U32 a, U32 b) { return counters[a].Cycles > counters[b].Cycles; });
+
+        out << std::format("\n{}\n{:>8} {:>14} {:>14} {:>7}\n", title, "opcode", "count", "cycles", "%");
+        for (U32 i : order)
+            out << std::format("{:>6}{:02X} {:>14} {:>14} {:>6.2f}%\n",
+                prefix, i, counters[i].Count, counters[i].Cycles, Percent(counters[i].Cycles, total));
+    };
+    writeOpcodes("Opcodes by cycles", "", m_Opcodes);
+    writeOpcodes("CB opcodes by cycles", "CB", m_CbOpcodes);
+
+    std::vector<std::pair<U32, Counter>> pcs{m_Pcs.begin(), m_Pcs.end()};
+    const Size hotCount = std::min(pcs.size(), HotPcCount);
+    std::partial_sort(pcs.begin(), pcs.begin() + static_cast<std::ptrdiff_t>(hotCount), pcs.end(),
+        [](const auto& a, const auto& b) { return a.second.Cycles > b.second.Cycles; });
+
+    out << std::format("\nHottest PCs\n{:>8} {:>14} {:>14} {:>7}\n", "pc", "count", "cycles", "%");
+    for (Size i = 0; i < hotCount; ++i)
+        out << std::format("{:>8} {:>14} {:>14} {:>6.2f}%\n",
+            Location(pcs[i].first), pcs[i].second.Count, pcs[i].second.Cycles, Percent(pcs[i].second.Cycles, total));
+
+    return out.good();
+}
+
+bool Profiler::WriteFoldedStacks(const std::filesystem::path& path) const
+{
+    std::ofstream out{path};
+    if (!out) return false;
+
+    std::vector<U32> stack;
+    for (U32 index = 0; index < m_Nodes.size(); ++index)
+    {
+        if (m_Nodes[index].Cycles == 0)
+            continue;
+
+        stack.clear();
+        for (U32 node = index; node != 0; node = m_Nodes[node].Parent)
+            stack.push_back(m_Nodes[node].Function);
+
+        std::string line = "main";
+        for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+            line += ";" + Location(*it);
+        out << std::format("{} {}\n", line, m_Nodes[index].Cycles);
+    }
+    if (m_HaltedCycles > 0)
+        out << std::format("halted {}\n", m_HaltedCycles);
+
+    return out.good();
+}
+
+ProfileScope::ProfileScope(Profiler* profiler, const CPU& cpu, const Bus& bus)
+    : m_Profiler{profiler}
+    , m_Cpu{cpu}
+    , m_Bus{bus}
+{
+    if (!m_Profiler) return;
+
+    m_StartCycles = bus.GetCpuCycles();
+    m_Pc = cpu.PC;
+    m_Sp = cpu.SP;
+    m_WasHalted = cpu.IsHalted();
+    m_Bank = bus.GetCartridge().RomBank();
+    m_Opcode = bus.Read(m_Pc);
+    if (m_Opcode == 0xCB)
+        m_CbOpcode = bus.Read(static_cast<U16>(m_Pc + 1));
+}
+
+ProfileScope::~ProfileScope()
+{
+    if (!m_Profiler) return;
+
+    const auto cycles = static_cast<U32>(m_Bus.GetCpuCycles() - m_StartCycles);
+
+    if (m_Profiler->TakeInterrupt())
+    {
+        m_Profiler->Interrupt(m_Cpu.PC, cycles);
+        return;
+    }
+    if (m_WasHalted && m_Cpu.IsHalted())
+    {
+        m_Profiler->Halted(cycles);
+        return;
+    }
+
+    m_Profiler->Instruction(m_Bank, m_Pc, m_Opcode, m_CbOpcode, cycles);
+
+    if (IsCall(m_Opcode) && m_Cpu.SP == static_cast<U16>(m_Sp - 2))
+        m_Profiler->Call(m_Bus.GetCartridge().RomBank(), m_Cpu.PC);
+    else if (IsReturn(m_Opcode) && m_Cpu.SP == static_cast<U16>(m_Sp + 2))
+        m_Profiler->Return();
+}
+
+} // namespace gb
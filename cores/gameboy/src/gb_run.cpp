@@ -3,86 +3,158 @@
 #include <print>
 #include <format>
 #include <filesystem>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <ctime>
+#include <expected>
+#include <memory>
+#include <optional>
 #include <vector>
 
 #include <gb.hpp>
 #include <gb_ppu.hpp>
 #include <gb_apu.hpp>
+#include <gb_battery.hpp>
 #include <gb_joypad.hpp>
+#include <gb_emu_thread.hpp>
+#include <gb_movie.hpp>
+#include <gb_netplay.hpp>
+#include <gb_save_slots.hpp>
+#include <overlay.hpp>
+#include <instrument.hpp>
+#include <net.hpp>
 
 namespace gb {
 
-void RunTests(const std::string& testRomsDir)
-{
-    const std::vector<std::string> tests = {
-        "cpu_instrs/individual/01-special.gb",
-        "cpu_instrs/individual/02-interrupts.gb",
-        "cpu_instrs/individual/03-op sp,hl.gb",
-        "cpu_instrs/individual/04-op r,imm.gb",
-        "cpu_instrs/individual/05-op rp.gb",
-        "cpu_instrs/individual/06-ld r,r.gb",
-        "cpu_instrs/individual/07-jr,jp,call,ret,rst.gb",
-        "cpu_instrs/individual/08-misc instrs.gb",
-        "cpu_instrs/individual/09-op r,r.gb",
-        "cpu_instrs/individual/10-bit ops.gb",
-        "cpu_instrs/individual/11-op a,(hl).gb",
-        "instr_timing/instr_timing.gb",
-        "mem_timing/individual/01-read_timing.gb",
-        "mem_timing/individual/02-write_timing.gb",
-        "mem_timing/individual/03-modify_timing.gb",
-        "mem_timing/mem_timing.gb",
-    };
+constexpr S32 Scale = 4;
+constexpr S32 WindowWidth = PPU::ScreenWidth * Scale;
+constexpr S32 WindowHeight = PPU::ScreenHeight * Scale;
 
-    S32 passed = 0, failed = 0;
+// Tab holds fast-forward at the selected rate (F1 cycles), ` holds slow motion (F2 cycles)
+constexpr std::array<float, 4> FastForwardSpeeds = {EmuThread::Uncapped, 2.0f, 4.0f, 8.0f};
+constexpr std::array<float, 2> SlowMotionSpeeds = {0.5f, 0.25f};
 
-    for (const auto& test : tests)
-    {
-        auto romPath = (std::filesystem::path(testRomsDir) / test).string();
-        auto cart = Cartridge::Load(romPath);
-        if (!cart)
-        {
-            std::println("{}: SKIP", test);
-            continue;
-        }
+constexpr U32 OverlayColor = 0xFFFFFFFF;
 
-        GameBoy gb{std::move(*cart)};
+// How long the slot number and thumbnail stay up after F6/F7
+constexpr std::chrono::seconds SlotOverlayDuration{2};
 
-        U32 cycles = 0;
-        constexpr U32 maxCycles = 200'000'000;
+static std::string SpeedLabel(float speed)
+{
+    return speed == EmuThread::Uncapped ? std::string{"uncapped"} : std::format("{}x", speed);
+}
 
-        while (gb.GetBus().GetTestResult() == TestResult::Running && cycles < maxCycles)
-        {
-            cycles += gb.Step();
-        }
+// Per-frame host timings (F3): min/avg/p99 over the last frames, in ms
+static void DrawTimings(Framebuffer& display, S32 y)
+{
+    constexpr std::array<instrument::Zone, 6> zones = {
+        instrument::Zone::Cpu, instrument::Zone::Render, instrument::Zone::Synthesis,
+        instrument::Zone::QueueAudio, instrument::Zone::Present, instrument::Zone::Rollback,
+    };
 
-        if (gb.GetBus().GetTestResult() == TestResult::Passed)
-        {
-            std::println("{}: PASSED", test);
-            ++passed;
-        }
-        else
-        {
-            std::println("{}: FAILED", test);
-            ++failed;
-        }
+    overlay::DrawText(display, PPU::ScreenWidth, PPU::ScreenHeight, 2, y,
+        std::format("{:<10}{:>5}{:>5}{:>5}", "ms", "min", "avg", "p99"), OverlayColor);
+    for (auto zone : zones)
+    {
+        y += overlay::LineHeight;
+        const auto stats = instrument::Stats(zone);
+        overlay::DrawText(display, PPU::ScreenWidth, PPU::ScreenHeight, 2, y,
+            std::format("{:<10}{:>5.2f}{:>5.2f}{:>5.2f}", instrument::ZoneName(zone), stats.MinMs, stats.AvgMs, stats.P99Ms),
+            OverlayColor);
     }
+}
 
-    std::println("\n{}/{} passed", passed, passed + failed);
+static std::string FormatTimestamp(S64 seconds)
+{
+    const auto time = static_cast<std::time_t>(seconds);
+    std::array<char, 32> text{};
+    std::strftime(text.data(), text.size(), "%Y-%m-%d %H:%M:%S", std::localtime(&time));
+    return text.data();
 }
 
-constexpr S32 Scale = 4;
-constexpr S32 WindowWidth = PPU::ScreenWidth * Scale;
-constexpr S32 WindowHeight = PPU::ScreenHeight * Scale;
+// Selected state slot (F6/F7) with the saved thumbnail in the top right corner
+static void DrawSlot(Framebuffer& display, U32 slot, const std::optional<SaveSlots::Info>& info)
+{
+    constexpr S32 left = PPU::ScreenWidth - SaveSlots::ThumbnailWidth - 2;
+    S32 y = 2;
+    if (info && !info->Thumbnail.empty())
+    {
+        for (U32 row = 0; row < SaveSlots::ThumbnailHeight; ++row)
+            std::copy_n(info->Thumbnail.begin() + row * SaveSlots::ThumbnailWidth, SaveSlots::ThumbnailWidth,
+                display.begin() + (y + row) * PPU::ScreenWidth + left);
+        y += SaveSlots::ThumbnailHeight + 1;
+    }
+    overlay::DrawText(display, PPU::ScreenWidth, PPU::ScreenHeight, left, y,
+        std::format("SLOT {}{}", slot, info ? "" : " EMPTY"), OverlayColor);
+}
+
+// host:port, the port last so IPv6 hosts may contain colons
+static std::expected<std::unique_ptr<net::UdpTransport>, std::string> OpenNetplay(const RunOptions& options)
+{
+    const auto colon = options.NetplayPeer.rfind(':');
+    U16 port = 0;
+    const std::string_view text = colon == std::string::npos ? std::string_view{} : std::string_view{options.NetplayPeer}.substr(colon + 1);
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), port);
+    if (text.empty() || ec != std::errc{} || ptr != text.data() + text.size() || port == 0)
+        return std::unexpected(std::format("Invalid netplay peer: {} (use host:port)", options.NetplayPeer));
+    return net::UdpTransport::Open(options.NetplayPort, options.NetplayPeer.substr(0, colon), port);
+}
 
-S32 Run(const std::string& romPath, bool fullscreen)
+S32 Run(const std::string& romPath, const RunOptions& options)
 {
-    auto cart = Cartridge::Load(romPath);
+    const bool netplay = !options.NetplayPeer.empty();
+    if (netplay && (!options.PlayMoviePath.empty() || !options.RecordMoviePath.empty()
+        || !options.Breakpoints.empty() || !options.Watches.empty() || options.Rtc == RtcMode::WallClock))
+    {
+        std::println(stderr, "Netplay cannot be combined with movies, breakpoints, watchpoints or the wall-clock RTC");
+        return 1;
+    }
+    std::unique_ptr<net::UdpTransport> transport;
+    if (netplay)
+    {
+        auto opened = OpenNetplay(options);
+        if (!opened)
+        {
+            std::println(stderr, "{}", opened.error());
+            return 1;
+        }
+        transport = std::move(*opened);
+    }
+
+    // Both peers must start from the same machine, so netplay leaves the local
+    // .sav alone: the session runs on blank battery RAM and never saves it
+    auto cart = netplay ? Cartridge::LoadRom(romPath) : Cartridge::Load(romPath);
     if (!cart)
     {
         std::println(stderr, "Failed to load ROM: {}", cart.error());
         return 1;
     }
     std::println("Loaded: {}", cart->Header().Title);
+
+    std::unique_ptr<TraceRecorder> tracer;
+    if (!options.TracePath.empty())
+    {
+        auto opened = TraceRecorder::Open(options.TracePath);
+        if (!opened)
+        {
+            std::println(stderr, "{}", opened.error());
+            return 1;
+        }
+        tracer = std::move(*opened);
+    }
+
+    std::optional<Movie> playback;
+    if (!options.PlayMoviePath.empty())
+    {
+        auto loaded = Movie::Load(options.PlayMoviePath);
+        if (!loaded)
+        {
+            std::println(stderr, "{}", loaded.error());
+            return 1;
+        }
+        playback = std::move(*loaded);
+    }
     std::println("  Mode: {}", cart->IsCgbMode() ? "Game Boy Color" : "DMG");
     std::println("  Type: {:02X}, ROM: {}KB, RAM: {}KB",
         cart->Header().CartridgeType,
@@ -114,11 +186,10 @@ S32 Run(const std::string& romPath, bool fullscreen)
     audioSpec.samples = 1024;
     audioSpec.callback = nullptr;
 
-    SDL_AudioDeviceID audioDevice = SDL_OpenAudioDevice(nullptr, 0, &audioSpec, nullptr, 0);
+    SDL_AudioSpec obtainedSpec{};
+    SDL_AudioDeviceID audioDevice = SDL_OpenAudioDevice(nullptr, 0, &audioSpec, &obtainedSpec, 0);
     if (audioDevice == 0)
         std::println(stderr, "Audio device failed: {}", SDL_GetError());
-    else
-        SDL_PauseAudioDevice(audioDevice, 0);
 
     // Game window
     SDL_Window* window = SDL_CreateWindow(
@@ -133,7 +204,7 @@ S32 Run(const std::string& romPath, bool fullscreen)
         return 1;
     }
 
-    if (fullscreen)
+    if (options.Fullscreen)
         SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
 
     SDL_Renderer* renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
@@ -162,6 +233,42 @@ S32 Run(const std::string& romPath, bool fullscreen)
     SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
 
     GameBoy gb{std::move(*cart)};
+    gb.SetTracer(tracer.get());
+    if (options.Rtc == RtcMode::WallClock)
+        gb.UseWallClockRTC();
+    else if (options.RtcEpoch)
+        gb.UseEmulatedRTC(*options.RtcEpoch);
+    else if (netplay)
+        gb.UseEmulatedRTC(0);  // Host clocks differ; peers must agree on the epoch
+    for (const U16 pc : options.Breakpoints)
+        gb.GetDebugger().AddBreakpoint(pc);
+    for (const auto& watch : options.Watches)
+        gb.GetDebugger().AddWatch(watch);
+
+    std::optional<Movie> recording;
+    std::string movieError;
+    if (playback)
+    {
+        if (auto started = playback->Start(gb); !started)
+            movieError = started.error();
+        else
+            std::println("Playing movie: {} frames", playback->FrameCount());
+    }
+    if (movieError.empty() && !options.RecordMoviePath.empty())
+    {
+        if (auto started = Movie::Record(gb); !started)
+            movieError = started.error();
+        else
+            recording = std::move(*started);
+    }
+    if (!movieError.empty())
+    {
+        std::println(stderr, "{}", movieError);
+        SDL_DestroyTexture(texture);
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(window);
+        return 1;
+    }
 
     // Open first available game controller
     SDL_GameController* controller = nullptr;
@@ -178,11 +285,53 @@ S32 Run(const std::string& romPath, bool fullscreen)
         }
     }
 
+    instrument::SetThreadName("Main");
+    if (!options.ChromeTracePath.empty())
+        instrument::StartTrace();
+
+    // A replayed movie's SRAM is the recording's, not the player's save
+    const bool persistSave = !playback && !netplay;
+    if (options.MapSaveFile && persistSave)
+    {
+        if (auto mapped = gb.GetCartridge().MapSaveFile(); !mapped)
+            std::println(stderr, "Not mapping save file: {}", mapped.error());
+    }
+    std::optional<BatterySaver> batterySaver;
+    if (persistSave && gb.GetCartridge().HasBattery())
+        batterySaver.emplace(gb.GetCartridge());
+
+    SaveSlots stateSlots{std::filesystem::path(statePath).replace_extension()};
+    // Keep roughly two device buffers queued; the device stays paused until
+    // the queue is primed to that level so playback starts without a gap
+    EmuThread emu{gb, stateSlots, audioDevice, static_cast<Size>(obtainedSpec.samples) * 2};
+    emu.SetPlayback(playback ? &*playback : nullptr);
+    emu.SetRecording(recording ? &*recording : nullptr);
+    emu.SetBatterySaver(batterySaver ? &*batterySaver : nullptr);
+    std::optional<RollbackSession> session;
+    if (netplay)
+    {
+        session.emplace(gb, *transport, options.Netplay);
+        emu.SetNetplay(&*session);
+        std::println("Netplay with {} from UDP port {}", options.NetplayPeer, options.NetplayPort);
+    }
+    emu.Start();
+
+    U8 buttons = 0;
+    bool fastForwardHeld = false;
+    bool fastForwardLatched = false;  // Gamepad R3 toggles instead of holding
+    bool slowMotionHeld = false;
+    Size fastForwardIndex = 0;
+    Size slowMotionIndex = 0;
+    bool showTimings = false;
+    U32 stateSlot = 0;
+    std::optional<SaveSlots::Info> slotInfo;
+    auto slotOverlayUntil = std::chrono::steady_clock::time_point{};
+    Framebuffer display{};
+
     bool running = true;
     while (running)
     {
         SDL_Event event;
-        auto& joypad = gb.GetBus().GetJoypad();
         while (SDL_PollEvent(&event))
         {
             if (event.type == SDL_QUIT)
@@ -200,62 +349,81 @@ S32 Run(const std::string& romPath, bool fullscreen)
                     SDL_SetWindowFullscreen(window, flags & SDL_WINDOW_FULLSCREEN_DESKTOP ? 0 : SDL_WINDOW_FULLSCREEN_DESKTOP);
                     break;
                 }
-                case SDLK_F5:
-                    if (gb.SaveState(statePath))
-                        std::println("State saved");
+                case SDLK_F5:     emu.RequestSaveState(); break;
+                case SDLK_F8:     emu.RequestLoadState(); break;
+                case SDLK_F6:
+                case SDLK_F7:
+                    stateSlot = (stateSlot + (event.key.keysym.sym == SDLK_F7 ? 1 : SaveSlots::Count - 1)) % SaveSlots::Count;
+                    emu.SetStateSlot(stateSlot);
+                    slotInfo = stateSlots.ReadInfo(stateSlot);
+                    if (slotInfo && slotInfo->Timestamp != 0)
+                        std::println("State slot {}: saved {}", stateSlot, FormatTimestamp(slotInfo->Timestamp));
                     else
-                        std::println("Save state failed");
+                        std::println("State slot {}{}", stateSlot, slotInfo ? "" : " (empty)");
+                    slotOverlayUntil = std::chrono::steady_clock::now() + SlotOverlayDuration;
                     break;
-                case SDLK_F8:
-                    if (gb.LoadState(statePath))
-                        std::println("State loaded");
+                case SDLK_F9:
+                    if (emu.IsPaused())
+                        emu.RequestResume();
                     else
-                        std::println("Load state failed");
+                        emu.RequestPause();
                     break;
-                case SDLK_RIGHT:  joypad.Press(Joypad::Right); break;
-                case SDLK_LEFT:   joypad.Press(Joypad::Left); break;
-                case SDLK_UP:     joypad.Press(Joypad::Up); break;
-                case SDLK_DOWN:   joypad.Press(Joypad::Down); break;
-                case SDLK_z:      joypad.Press(Joypad::A); break;
-                case SDLK_x:      joypad.Press(Joypad::B); break;
-                case SDLK_RETURN: joypad.Press(Joypad::Start); break;
-                case SDLK_RSHIFT: joypad.Press(Joypad::Select); break;
+                case SDLK_F10:    emu.RequestStep(); break;
+                case SDLK_TAB:       fastForwardHeld = true; break;
+                case SDLK_BACKQUOTE: slowMotionHeld = true; break;
+                case SDLK_F1:
+                    fastForwardIndex = (fastForwardIndex + 1) % FastForwardSpeeds.size();
+                    std::println("Fast-forward: {}", SpeedLabel(FastForwardSpeeds[fastForwardIndex]));
+                    break;
+                case SDLK_F3:
+                    showTimings = !showTimings;
+                    instrument::SetEnabled(showTimings);
+                    break;
+                case SDLK_F2:
+                    slowMotionIndex = (slowMotionIndex + 1) % SlowMotionSpeeds.size();
+                    std::println("Slow motion: {}", SpeedLabel(SlowMotionSpeeds[slowMotionIndex]));
+                    break;
+                case SDLK_RIGHT:  buttons |= Joypad::Right; break;
+                case SDLK_LEFT:   buttons |= Joypad::Left; break;
+                case SDLK_UP:     buttons |= Joypad::Up; break;
+                case SDLK_DOWN:   buttons |= Joypad::Down; break;
+                case SDLK_z:      buttons |= Joypad::A; break;
+                case SDLK_x:      buttons |= Joypad::B; break;
+                case SDLK_RETURN: buttons |= Joypad::Start; break;
+                case SDLK_RSHIFT: buttons |= Joypad::Select; break;
                 }
             }
             if (event.type == SDL_KEYUP)
             {
                 switch (event.key.keysym.sym)
                 {
-                case SDLK_RIGHT:  joypad.Release(Joypad::Right); break;
-                case SDLK_LEFT:   joypad.Release(Joypad::Left); break;
-                case SDLK_UP:     joypad.Release(Joypad::Up); break;
-                case SDLK_DOWN:   joypad.Release(Joypad::Down); break;
-                case SDLK_z:      joypad.Release(Joypad::A); break;
-                case SDLK_x:      joypad.Release(Joypad::B); break;
-                case SDLK_RETURN: joypad.Release(Joypad::Start); break;
-                case SDLK_RSHIFT: joypad.Release(Joypad::Select); break;
+                case SDLK_TAB:       fastForwardHeld = false; break;
+                case SDLK_BACKQUOTE: slowMotionHeld = false; break;
+                case SDLK_RIGHT:  buttons &= ~Joypad::Right; break;
+                case SDLK_LEFT:   buttons &= ~Joypad::Left; break;
+                case SDLK_UP:     buttons &= ~Joypad::Up; break;
+                case SDLK_DOWN:   buttons &= ~Joypad::Down; break;
+                case SDLK_z:      buttons &= ~Joypad::A; break;
+                case SDLK_x:      buttons &= ~Joypad::B; break;
+                case SDLK_RETURN: buttons &= ~Joypad::Start; break;
+                case SDLK_RSHIFT: buttons &= ~Joypad::Select; break;
                 }
             }
             if (event.type == SDL_CONTROLLERBUTTONDOWN)
             {
                 switch (event.cbutton.button)
                 {
-                case SDL_CONTROLLER_BUTTON_DPAD_RIGHT: joypad.Press(Joypad::Right); break;
-                case SDL_CONTROLLER_BUTTON_DPAD_LEFT:  joypad.Press(Joypad::Left); break;
-                case SDL_CONTROLLER_BUTTON_DPAD_UP:    joypad.Press(Joypad::Up); break;
-                case SDL_CONTROLLER_BUTTON_DPAD_DOWN:  joypad.Press(Joypad::Down); break;
-                case SDL_CONTROLLER_BUTTON_A:          joypad.Press(Joypad::A); break;
-                case SDL_CONTROLLER_BUTTON_B:          joypad.Press(Joypad::B); break;
-                case SDL_CONTROLLER_BUTTON_START:      joypad.Press(Joypad::Start); break;
-                case SDL_CONTROLLER_BUTTON_BACK:       joypad.Press(Joypad::Select); break;
-                case SDL_CONTROLLER_BUTTON_LEFTSHOULDER:
-                    if (gb.SaveState(statePath))
-                        std::println("State saved");
-                    break;
-                case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER:
-                    if (gb.LoadState(statePath))
-                        std::println("State loaded");
-                    break;
+                case SDL_CONTROLLER_BUTTON_DPAD_RIGHT: buttons |= Joypad::Right; break;
+                case SDL_CONTROLLER_BUTTON_DPAD_LEFT:  buttons |= Joypad::Left; break;
+                case SDL_CONTROLLER_BUTTON_DPAD_UP:    buttons |= Joypad::Up; break;
+                case SDL_CONTROLLER_BUTTON_DPAD_DOWN:  buttons |= Joypad::Down; break;
+                case SDL_CONTROLLER_BUTTON_A:          buttons |= Joypad::A; break;
+                case SDL_CONTROLLER_BUTTON_B:          buttons |= Joypad::B; break;
+                case SDL_CONTROLLER_BUTTON_START:      buttons |= Joypad::Start; break;
+                case SDL_CONTROLLER_BUTTON_BACK:       buttons |= Joypad::Select; break;
+                case SDL_CONTROLLER_BUTTON_LEFTSHOULDER:  emu.RequestSaveState(); break;
+                case SDL_CONTROLLER_BUTTON_RIGHTSHOULDER: emu.RequestLoadState(); break;
+                case SDL_CONTROLLER_BUTTON_RIGHTSTICK:    fastForwardLatched = !fastForwardLatched; break;
                 case SDL_CONTROLLER_BUTTON_GUIDE:
                 {
                     Uint32 flags = SDL_GetWindowFlags(window);
@@ -268,14 +436,14 @@ S32 Run(const std::string& romPath, bool fullscreen)
             {
                 switch (event.cbutton.button)
                 {
-                case SDL_CONTROLLER_BUTTON_DPAD_RIGHT: joypad.Release(Joypad::Right); break;
-                case SDL_CONTROLLER_BUTTON_DPAD_LEFT:  joypad.Release(Joypad::Left); break;
-                case SDL_CONTROLLER_BUTTON_DPAD_UP:    joypad.Release(Joypad::Up); break;
-                case SDL_CONTROLLER_BUTTON_DPAD_DOWN:  joypad.Release(Joypad::Down); break;
-                case SDL_CONTROLLER_BUTTON_A:          joypad.Release(Joypad::A); break;
-                case SDL_CONTROLLER_BUTTON_B:          joypad.Release(Joypad::B); break;
-                case SDL_CONTROLLER_BUTTON_START:      joypad.Release(Joypad::Start); break;
-                case SDL_CONTROLLER_BUTTON_BACK:       joypad.Release(Joypad::Select); break;
+                case SDL_CONTROLLER_BUTTON_DPAD_RIGHT: buttons &= ~Joypad::Right; break;
+                case SDL_CONTROLLER_BUTTON_DPAD_LEFT:  buttons &= ~Joypad::Left; break;
+                case SDL_CONTROLLER_BUTTON_DPAD_UP:    buttons &= ~Joypad::Up; break;
+                case SDL_CONTROLLER_BUTTON_DPAD_DOWN:  buttons &= ~Joypad::Down; break;
+                case SDL_CONTROLLER_BUTTON_A:          buttons &= ~Joypad::A; break;
+                case SDL_CONTROLLER_BUTTON_B:          buttons &= ~Joypad::B; break;
+                case SDL_CONTROLLER_BUTTON_START:      buttons &= ~Joypad::Start; break;
+                case SDL_CONTROLLER_BUTTON_BACK:       buttons &= ~Joypad::Select; break;
                 }
             }
             if (event.type == SDL_CONTROLLERDEVICEADDED && !controller)
@@ -295,31 +463,110 @@ S32 Run(const std::string& romPath, bool fullscreen)
             }
         }
 
-        U32 cycles = 0;
-        while (!gb.FrameReady() && cycles < 1000000)
+        emu.SetInput(buttons);
+
+        // Netplay runs at the pace the peers share
+        float speed = 1.0f;
+        if (!netplay && (fastForwardHeld || fastForwardLatched))
+            speed = FastForwardSpeeds[fastForwardIndex];
+        else if (!netplay && slowMotionHeld)
+            speed = SlowMotionSpeeds[slowMotionIndex];
+        emu.SetSpeed(speed);
+
+        // Present only when the emulation thread published a new frame
+        if (!emu.AcquireFrame())
         {
-            cycles += gb.Step();
+            SDL_Delay(1);
+            continue;
         }
 
-        SDL_UpdateTexture(texture, nullptr, gb.GetPPU().GetFramebuffer().data(), PPU::ScreenWidth * sizeof(U32));
-        SDL_RenderClear(renderer);
-        SDL_RenderCopy(renderer, texture, nullptr, nullptr);
-        SDL_RenderPresent(renderer);
-
-        auto& apu = gb.GetAPU();
-        if (audioDevice != 0 && apu.GetSampleCount() > 0)
+        const Framebuffer* frame = &emu.Frame();
+        const bool paused = emu.IsPaused();
+        const bool showSlot = std::chrono::steady_clock::now() < slotOverlayUntil;
+        if (speed != 1.0f || showTimings || paused || showSlot)
         {
-            constexpr U32 MaxQueueBytes = APU::SampleRate * sizeof(float) / 15;
-            while (SDL_GetQueuedAudioSize(audioDevice) > MaxQueueBytes)
-                SDL_Delay(1);
+            display = *frame;
+            S32 y = 2;
+            if (paused)
+            {
+                overlay::DrawText(display, PPU::ScreenWidth, PPU::ScreenHeight, 2, y, "PAUSED", OverlayColor);
+                y += overlay::LineHeight;
+            }
+            else if (speed != 1.0f)
+            {
+                const bool slow = speed != EmuThread::Uncapped && speed < 1.0f;
+                const auto label = std::format("{} {:.2f}x", slow ? "SLOW" : "FF", emu.AchievedSpeed());
+                overlay::DrawText(display, PPU::ScreenWidth, PPU::ScreenHeight, 2, y, label, OverlayColor);
+                y += overlay::LineHeight;
+            }
+            if (showTimings)
+                DrawTimings(display, y);
+            if (showSlot)
+                DrawSlot(display, stateSlot, slotInfo);
+            frame = &display;
+        }
 
-            SDL_QueueAudio(audioDevice, apu.GetAudioBuffer().data(),
-                static_cast<U32>(apu.GetSampleCount() * sizeof(float)));
-            apu.ClearBuffer();
+        {
+            PHOSPHOR_SPAN(instrument::Zone::Present);
+            SDL_UpdateTexture(texture, nullptr, frame->data(), PPU::ScreenWidth * sizeof(U32));
+            SDL_RenderClear(renderer);
+            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+            SDL_RenderPresent(renderer);
         }
+        instrument::EndFrame(instrument::Track::Presentation);
+    }
+
+    emu.Stop();
+    if (session)
+    {
+        const auto& stats = session->Stats();
+        const auto frames = static_cast<double>(std::max<U64>(stats.Frames, 1));
+        std::println("Netplay: {} frames, {} stalled, {} rollbacks re-ran {} frames (max depth {})",
+            stats.Frames, stats.StalledFrames, stats.Rollbacks, stats.ResimulatedFrames, stats.MaxRollbackDepth);
+        std::println("  re-run {:.3f} ms/frame avg, {:.3f} ms max; snapshots {:.3f} ms/frame",
+            stats.TotalResimulationMs / frames, stats.MaxResimulationMs, stats.TotalSnapshotMs / frames);
+        if (stats.Desynced)
+            std::println("  desynced at frame {}", stats.DesyncFrame);
     }
+    // The final save also catches writes still inside the saver's quiet period
+    batterySaver.reset();
+    if (persistSave)
+        gb.SaveRAM();
 
-    gb.SaveRAM();
+    if (recording)
+    {
+        if (recording->Save(options.RecordMoviePath))
+            std::println("Movie written to {} ({} frames)", options.RecordMoviePath, recording->FrameCount());
+        else
+            std::println(stderr, "Failed to write movie: {}", options.RecordMoviePath);
+    }
+
+    if (tracer)
+    {
+        gb.SetTracer(nullptr);
+        if (tracer->Close())
+            std::println("Execution trace written to {} ({} instructions)", options.TracePath, tracer->RecordCount());
+        else
+            std::println(stderr, "Failed to write execution trace: {}", options.TracePath);
+    }
+
+    if (!options.ChromeTracePath.empty())
+    {
+        if (instrument::WriteChromeTrace(options.ChromeTracePath))
+            std::println("Trace written to {}", options.ChromeTracePath);
+        else
+            std::println(stderr, "Failed to write trace: {}", options.ChromeTracePath);
+    }
+
+#ifdef PHOSPHOR_PROFILE
+    const auto profileBase = std::filesystem::path(statePath).replace_extension();
+    const auto reportPath = profileBase.string() + ".profile.txt";
+    const auto foldedPath = profileBase.string() + ".folded";
+    if (gb.GetProfiler().WriteReport(reportPath) && gb.GetProfiler().WriteFoldedStacks(foldedPath))
+        std::println("Profile written to {} and {}", reportPath, foldedPath);
+    else
+        std::println(stderr, "Failed to write profile next to {}", statePath);
+#endif
 
     if (controller)
         SDL_GameControllerClose(controller);
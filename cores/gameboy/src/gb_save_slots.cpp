@@ -0,0 +1,178 @@
+#include <gb_save_slots.hpp>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <format>
+#include <fstream>
+#include <print>
+#include <sstream>
+
+#include <file.hpp>
+#include <gb.hpp>
+#include <instrument.hpp>
+
+namespace gb {
+
+namespace {
+    constexpr U32 ThumbnailSection = state::SectionId("THMB");
+    constexpr U32 TimestampSection = state::SectionId("TIME");
+
+    // 2x2 box filter of the framebuffer, as U16 width, U16 height, pixels
+    state::Section CaptureThumbnail(const PPU& ppu)
+    {
+        const auto& frame = ppu.GetFramebuffer();
+        std::vector<U32> pixels(SaveSlots::ThumbnailWidth * SaveSlots::ThumbnailHeight);
+        for (U32 y = 0; y < SaveSlots::ThumbnailHeight; ++y)
+        {
+            for (U32 x = 0; x < SaveSlots::ThumbnailWidth; ++x)
+            {
+                const Size top = (y * 2) * PPU::ScreenWidth + x * 2;
+                const std::array<U32, 4> quad{frame[top], frame[top + 1],
+                    frame[top + PPU::ScreenWidth], frame[top + PPU::ScreenWidth + 1]};
+                U32 pixel = 0;
+                for (U32 shift = 0; shift < 32; shift += 8)
+                {
+                    U32 sum = 0;
+                    for (const U32 p : quad)
+                        sum += (p >> shift) & 0xFF;
+                    pixel |= (sum / 4) << shift;
+                }
+                pixels[y * SaveSlots::ThumbnailWidth + x] = pixel;
+            }
+        }
+
+        state::Section section{ThumbnailSection, 1, {}};
+        section.Data.resize(2 * sizeof(U16) + pixels.size() * sizeof(U32));
+        const U16 size[2] = {SaveSlots::ThumbnailWidth, SaveSlots::ThumbnailHeight};
+        std::memcpy(section.Data.data(), size, sizeof(size));
+        std::memcpy(section.Data.data() + sizeof(size), pixels.data(), pixels.size() * sizeof(U32));
+        return section;
+    }
+
+    state::Section CaptureTimestamp()
+    {
+        const S64 now = static_cast<S64>(std::time(nullptr));
+        state::Section section{TimestampSection, 1, {}};
+        section.Data.resize(sizeof(now));
+        std::memcpy(section.Data.data(), &now, sizeof(now));
+        return section;
+    }
+}
+
+SaveSlots::SaveSlots(std::filesystem::path base)
+    : m_Base{std::move(base)}
+{
+    m_Writer = std::jthread{[this](std::stop_token stop) { WriterLoop(stop); }};
+}
+
+SaveSlots::~SaveSlots()
+{
+    // The writer drains the queue before it honours the stop
+    m_Writer.request_stop();
+    m_Wake.notify_all();
+}
+
+std::filesystem::path SaveSlots::SlotPath(U32 slot) const
+{
+    std::filesystem::path path = m_Base;
+    path += std::format(".ss{}", slot);
+    return path;
+}
+
+void SaveSlots::Save(const GameBoy& gb, U32 slot)
+{
+    Job job{slot, gb.CaptureState()};
+    job.Sections.push_back(CaptureThumbnail(gb.GetPPU()));
+    job.Sections.push_back(CaptureTimestamp());
+
+    {
+        std::lock_guard lock{m_Mutex};
+        // A newer snapshot of the same slot supersedes one still queued
+        std::erase_if(m_Queue, [slot](const Job& queued) { return queued.Slot == slot; });
+        m_Queue.push_back(std::move(job));
+    }
+    m_Wake.notify_one();
+}
+
+bool SaveSlots::Load(GameBoy& gb, U32 slot)
+{
+    WaitForSlot(slot);
+    return gb.LoadState(SlotPath(slot).string());
+}
+
+std::optional<SaveSlots::Info> SaveSlots::ReadInfo(U32 slot)
+{
+    WaitForSlot(slot);
+
+    std::ifstream file{SlotPath(slot), std::ios::binary};
+    U32 magic = 0;
+    U8 version = 0;
+    state::Read(file, magic);
+    state::Read(file, version);
+    if (!file || magic != state::Magic)
+        return std::nullopt;
+
+    Info info;
+    if (version != state::Version)
+        return info;  // Older states carry neither
+
+    const std::array wanted{ThumbnailSection, TimestampSection};
+    auto sections = state::ReadSections(file, wanted);
+    if (!sections)
+        return std::nullopt;
+
+    for (const auto& section : *sections)
+    {
+        if (section.Id == TimestampSection && section.Data.size() == sizeof(S64))
+            std::memcpy(&info.Timestamp, section.Data.data(), sizeof(S64));
+
+        constexpr Size header = 2 * sizeof(U16);
+        if (section.Id == ThumbnailSection && section.Data.size() == header + ThumbnailWidth * ThumbnailHeight * sizeof(U32))
+        {
+            info.Thumbnail.resize(ThumbnailWidth * ThumbnailHeight);
+            std::memcpy(info.Thumbnail.data(), section.Data.data() + header, info.Thumbnail.size() * sizeof(U32));
+        }
+    }
+    return info;
+}
+
+void SaveSlots::WaitForSlot(U32 slot)
+{
+    std::unique_lock lock{m_Mutex};
+    m_Written.wait(lock, [&] {
+        return m_Writing != slot && std::ranges::none_of(m_Queue, [slot](const Job& job) { return job.Slot == slot; });
+    });
+}
+
+void SaveSlots::WriterLoop(std::stop_token stop)
+{
+    instrument::SetThreadName("Save states");
+
+    std::unique_lock lock{m_Mutex};
+    while (true)
+    {
+        m_Wake.wait(lock, stop, [this] { return !m_Queue.empty(); });
+        if (m_Queue.empty())
+            return;
+
+        Job job = std::move(m_Queue.front());
+        m_Queue.pop_front();
+        m_Writing = job.Slot;
+        lock.unlock();
+
+        std::ostringstream out;
+        const bool packed = state::WriteSections(out, job.Sections);
+        const std::string bytes = std::move(out).str();
+        const auto path = SlotPath(job.Slot);
+        if (packed && file::WriteAtomic(path, {reinterpret_cast<const U8*>(bytes.data()), bytes.size()}))
+            std::println("State saved to slot {}", job.Slot);
+        else
+            std::println(stderr, "Save state failed: {}", path.string());
+
+        lock.lock();
+        m_Writing.reset();
+        m_Written.notify_all();
+    }
+}
+
+} // namespace gb
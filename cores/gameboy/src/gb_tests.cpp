@@ -0,0 +1,367 @@
+#include <gb_tests.hpp>
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <print>
+#include <string_view>
+
+#include <gb.hpp>
+#include <hash.hpp>
+#include <parallel.hpp>
+
+namespace gb {
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    using Seconds = std::chrono::duration<double>;
+
+    // How often the wall-clock timeout is checked, in emulated cycles
+    constexpr U64 ClockCheckInterval = 1 << 20;
+
+    enum class Outcome { Passed, Failed, CycleTimeout, WallTimeout, LoadError };
+
+    struct TestRun {
+        std::string Name;
+        Outcome Result{Outcome::LoadError};
+        double Seconds{};
+        U64 Cycles{};
+    };
+
+    const char* OutcomeName(Outcome outcome)
+    {
+        switch (outcome)
+        {
+        case Outcome::Passed:       return "PASSED";
+        case Outcome::Failed:       return "FAILED";
+        case Outcome::CycleTimeout: return "TIMEOUT";
+        case Outcome::WallTimeout:  return "TIMEOUT/WALL";
+        case Outcome::LoadError:    return "SKIP";
+        }
+        return "?";
+    }
+
+    // '*' matches any run of characters (including '/'), '?' any single one
+    bool GlobMatch(std::string_view pattern, std::string_view text)
+    {
+        Size p = 0, t = 0;
+        Size starP = std::string_view::npos, starT = 0;
+        while (t < text.size())
+        {
+            if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t]))
+            {
+                ++p;
+                ++t;
+            }
+            else if (p < pattern.size() && pattern[p] == '*')
+            {
+                starP = p++;
+                starT = t;
+            }
+            else if (starP != std::string_view::npos)
+            {
+                p = starP + 1;
+                t = ++starT;
+            }
+            else
+                return false;
+        }
+        while (p < pattern.size() && pattern[p] == '*')
+            ++p;
+        return p == pattern.size();
+    }
+
+    std::vector<std::string> DiscoverTests(const std::filesystem::path& root, std::string_view filter)
+    {
+        std::vector<std::string> tests;
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(root, ec))
+        {
+            if (!entry.is_regular_file())
+                continue;
+            const auto ext = entry.path().extension();
+            if (ext != ".gb" && ext != ".gbc")
+                continue;
+
+            auto relative = entry.path().lexically_relative(root).generic_string();
+            if (GlobMatch(filter, relative))
+                tests.push_back(std::move(relative));
+        }
+        std::sort(tests.begin(), tests.end());
+        return tests;
+    }
+
+    TestRun RunTest(const std::filesystem::path& root, const std::string& test, const TestOptions& options)
+    {
+        TestRun run{test};
+        const auto start = Clock::now();
+
+        auto cart = Cartridge::Load((root / test).string());
+        if (!cart)
+            return run;
+
+        // Heap-allocated: worker threads may have small stacks
+        auto gb = std::make_unique<GameBoy>(std::move(*cart));
+        const auto& bus = gb->GetBus();
+
+        run.Result = Outcome::CycleTimeout;
+        auto finished = [&bus] { return bus.GetTestResult() != TestResult::Running; };
+        while (run.Cycles < options.MaxCycles)
+        {
+            run.Cycles += gb->RunUntil(finished, std::min(ClockCheckInterval, options.MaxCycles - run.Cycles));
+            if (finished())
+            {
+                run.Result = bus.GetTestResult() == TestResult::Passed ? Outcome::Passed : Outcome::Failed;
+                break;
+            }
+            if (Seconds{Clock::now() - start}.count() > options.TimeoutSeconds)
+            {
+                run.Result = Outcome::WallTimeout;
+                break;
+            }
+        }
+
+        run.Seconds = Seconds{Clock::now() - start}.count();
+        return run;
+    }
+
+    // Same per-frame guard as the emulation thread, for LCD-off stretches
+    constexpr U32 MaxCyclesPerFrame = 1'000'000;
+
+    struct ScreenshotEntry {
+        Size Line{};                   // Index into the manifest lines
+        std::string Rom;
+        U32 Frames{};
+        std::optional<U64> Expected;
+        std::optional<U64> Actual;     // Empty if the ROM failed to load
+    };
+
+    std::string_view Trim(std::string_view text)
+    {
+        const auto first = text.find_first_not_of(" \t\r");
+        if (first == std::string_view::npos)
+            return {};
+        return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+    }
+
+    std::optional<ScreenshotEntry> ParseEntry(std::string_view line)
+    {
+        const auto hashEnd = line.find_first_of(" \t");
+        if (hashEnd == std::string_view::npos)
+            return std::nullopt;
+        const auto hashText = line.substr(0, hashEnd);
+        auto rest = Trim(line.substr(hashEnd));
+
+        const auto framesEnd = rest.find_first_of(" \t");
+        if (framesEnd == std::string_view::npos)
+            return std::nullopt;
+        const auto framesText = rest.substr(0, framesEnd);
+
+        ScreenshotEntry entry;
+        entry.Rom = std::string{Trim(rest.substr(framesEnd))};
+
+        auto [framesPtr, framesEc] = std::from_chars(framesText.data(), framesText.data() + framesText.size(), entry.Frames);
+        if (framesEc != std::errc{} || framesPtr != framesText.data() + framesText.size() || entry.Rom.empty())
+            return std::nullopt;
+
+        if (hashText != "-")
+        {
+            U64 hash = 0;
+            auto [hashPtr, hashEc] = std::from_chars(hashText.data(), hashText.data() + hashText.size(), hash, 16);
+            if (hashEc != std::errc{} || hashPtr != hashText.data() + hashText.size())
+                return std::nullopt;
+            entry.Expected = hash;
+        }
+        return entry;
+    }
+
+    std::optional<U64> ScreenshotHash(const std::filesystem::path& rom, U32 frames)
+    {
+        // Goldens must not depend on a local .sav or on the host clock
+        auto cart = Cartridge::LoadRom(rom.string());
+        if (!cart)
+            return std::nullopt;
+
+        auto gb = std::make_unique<GameBoy>(std::move(*cart));
+        gb->UseEmulatedRTC(0);
+        for (U32 frame = 0; frame < frames; ++frame)
+        {
+            gb->RunUntil([&gb] { return gb->FrameReady(); }, MaxCyclesPerFrame);
+            gb->GetAPU().ClearBuffer();
+        }
+
+        const auto& framebuffer = gb->GetPPU().GetFramebuffer();
+        return hash::Xxh64Of(std::span<const U32>{framebuffer});
+    }
+}
+
+S32 RunScreenshotTests(const ScreenshotOptions& options)
+{
+    std::ifstream manifest{options.ManifestPath};
+    if (!manifest)
+    {
+        std::println(stderr, "Failed to open manifest: {}", options.ManifestPath);
+        return 1;
+    }
+
+    std::vector<std::string> lines;
+    std::vector<ScreenshotEntry> entries;
+    for (std::string line; std::getline(manifest, line);)
+    {
+        const auto content = Trim(line);
+        if (!content.empty() && content.front() != '#')
+        {
+            auto entry = ParseEntry(content);
+            if (!entry)
+            {
+                std::println(stderr, "{}:{}: expected \"<hash|-> <frames> <rom>\"", options.ManifestPath, lines.size() + 1);
+                return 1;
+            }
+            entry->Line = lines.size();
+            entries.push_back(std::move(*entry));
+        }
+        lines.push_back(std::move(line));
+    }
+    manifest.close();
+
+    const std::filesystem::path root{options.TestRomsDir};
+    const auto start = Clock::now();
+    ParallelFor(entries.size(), options.Jobs, [&](Size i) {
+        entries[i].Actual = ScreenshotHash(root / entries[i].Rom, entries[i].Frames);
+    });
+    const double elapsed = Seconds{Clock::now() - start}.count();
+
+    S32 matched = 0, mismatched = 0, added = 0, missing = 0, skipped = 0;
+    for (auto& entry : entries)
+    {
+        // A golden whose ROM no longer loads is a failure, not a pass
+        if (!entry.Actual && entry.Expected)
+        {
+            std::println("{} @{}: MISSING (cannot load ROM)", entry.Rom, entry.Frames);
+            ++missing;
+            continue;
+        }
+        if (!entry.Actual)
+        {
+            std::println("{} @{}: SKIP", entry.Rom, entry.Frames);
+            ++skipped;
+            continue;
+        }
+
+        if (!entry.Expected)
+        {
+            std::println("{} @{}: NEW {:016x}", entry.Rom, entry.Frames, *entry.Actual);
+            ++added;
+        }
+        else if (*entry.Expected == *entry.Actual)
+        {
+            std::println("{} @{}: MATCH", entry.Rom, entry.Frames);
+            ++matched;
+        }
+        else
+        {
+            std::println("{} @{}: MISMATCH (expected {:016x}, got {:016x})",
+                entry.Rom, entry.Frames, *entry.Expected, *entry.Actual);
+            ++mismatched;
+        }
+
+        lines[entry.Line] = std::format("{:016x} {} {}", *entry.Actual, entry.Frames, entry.Rom);
+    }
+
+    std::println("\n{} matched, {} mismatched, {} new, {} missing, {} skipped ({:.2f}s)",
+        matched, mismatched, added, missing, skipped, elapsed);
+
+    if (options.Update && (mismatched > 0 || added > 0))
+    {
+        std::ofstream out{options.ManifestPath, std::ios::trunc};
+        for (const auto& line : lines)
+            out << line << '\n';
+        if (!out)
+        {
+            std::println(stderr, "Failed to write manifest: {}", options.ManifestPath);
+            return 1;
+        }
+        std::println("Updated {}", options.ManifestPath);
+        return missing > 0 ? 1 : 0;
+    }
+
+    return mismatched > 0 || missing > 0 ? 1 : 0;
+}
+
+const std::vector<std::string>& TestRoms()
+{
+    static const std::vector<std::string> tests = {
+        "cpu_instrs/individual/01-special.gb",
+        "cpu_instrs/individual/02-interrupts.gb",
+        "cpu_instrs/individual/03-op sp,hl.gb",
+        "cpu_instrs/individual/04-op r,imm.gb",
+        "cpu_instrs/individual/05-op rp.gb",
+        "cpu_instrs/individual/06-ld r,r.gb",
+        "cpu_instrs/individual/07-jr,jp,call,ret,rst.gb",
+        "cpu_instrs/individual/08-misc instrs.gb",
+        "cpu_instrs/individual/09-op r,r.gb",
+        "cpu_instrs/individual/10-bit ops.gb",
+        "cpu_instrs/individual/11-op a,(hl).gb",
+        "instr_timing/instr_timing.gb",
+        "mem_timing/individual/01-read_timing.gb",
+        "mem_timing/individual/02-write_timing.gb",
+        "mem_timing/individual/03-modify_timing.gb",
+        "mem_timing/mem_timing.gb",
+    };
+    return tests;
+}
+
+S32 RunTests(const TestOptions& options)
+{
+    const std::filesystem::path root{options.TestRomsDir};
+    const auto tests = options.Filter.empty() ? TestRoms() : DiscoverTests(root, options.Filter);
+    if (tests.empty())
+    {
+        std::println("No test ROMs matching \"{}\" in {}", options.Filter, options.TestRomsDir);
+        return 1;
+    }
+
+    const auto start = Clock::now();
+    std::vector<TestRun> runs(tests.size());
+    ParallelFor(tests.size(), options.Jobs, [&](Size i) {
+        runs[i] = RunTest(root, tests[i], options);
+    });
+    const double elapsed = Seconds{Clock::now() - start}.count();
+
+    S32 passed = 0, failed = 0, skipped = 0;
+    double cpuSeconds = 0.0;
+    for (const auto& run : runs)
+    {
+        if (run.Result == Outcome::LoadError)
+        {
+            std::println("{}: SKIP", run.Name);
+            ++skipped;
+            continue;
+        }
+
+        std::println("{}: {} ({:.2f}s, {:.1f}M cycles)",
+            run.Name,
+            OutcomeName(run.Result),
+            run.Seconds,
+            static_cast<double>(run.Cycles) / 1e6);
+
+        cpuSeconds += run.Seconds;
+        if (run.Result == Outcome::Passed)
+            ++passed;
+        else
+            ++failed;
+    }
+
+    std::println("\n{}/{} passed", passed, passed + failed);
+    if (skipped > 0)
+        std::println("{} skipped", skipped);
+    std::println("{:.2f}s wall, {:.2f}s summed over tests", elapsed, cpuSeconds);
+
+    return failed > 0 ? 1 : 0;
+}
+
+} // namespace gb
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <ostream>
 #include <istream>
@@ -6,23 +7,73 @@
 
 namespace gb {
 
-void Timer::Tick(U8 mCycles)
+Timer::Timer(const U64& cycles)
+    : m_Cycles{cycles}
+    , m_DivStart{cycles}
+    , m_SyncedAt{cycles}
 {
-    for (U8 i = 0; i < mCycles; ++i)
+}
+
+U64 Timer::PendingEdges() const
+{
+    if (!Enabled())
+        return 0;
+    // The bit falls each time the counter reaches a multiple of the period
+    const U64 period = Period();
+    return Counter() / period - (m_SyncedAt - m_DivStart) / period;
+}
+
+U8 Timer::CurrentTima() const
+{
+    // Overflows are handled at their cycle, so reads between them never
+    // see one pending
+    return static_cast<U8>(m_TIMA + PendingEdges());
+}
+
+void Timer::Sync()
+{
+    U64 edges = PendingEdges();
+    while (edges != 0)
     {
-        const bool oldBit = (m_Div >> GetTimerBit()) & 1;
-        ++m_Div;
-        const bool newBit = (m_Div >> GetTimerBit()) & 1;
-        if (oldBit && !newBit && (m_TAC & 0x04))
+        const U64 step = std::min<U64>(edges, 0x100 - m_TIMA);
+        m_TIMA = static_cast<U8>(m_TIMA + step);
+        edges -= step;
+        if (m_TIMA == 0)
         {
-            ++m_TIMA;
-            if (m_TIMA == 0)
-            {
-                m_TIMA = m_TMA;
-                m_InterruptFlag = true;
-            }
+            m_TIMA = m_TMA;
+            m_InterruptFlag = true;
         }
     }
+    m_SyncedAt = m_Cycles;
+}
+
+void Timer::Increment()
+{
+    if (++m_TIMA == 0)
+    {
+        m_TIMA = m_TMA;
+        m_InterruptFlag = true;
+    }
+}
+
+void Timer::Schedule()
+{
+    if (m_InterruptFlag)
+    {
+        // Raised by a write; the Bus takes it on the next M-cycle
+        m_NextEvent = m_Cycles;
+    }
+    else if (!Enabled())
+    {
+        m_NextEvent = NoEvent;
+    }
+    else
+    {
+        // The next edge, then one more per count left before TIMA wraps
+        const U64 period = Period();
+        const U64 nextEdge = (Counter() / period + 1) * period;
+        m_NextEvent = m_DivStart + nextEdge + (0xFF - m_TIMA) * period;
+    }
 }
 
 std::optional<U8> Timer::Read(U16 address) const
@@ -30,9 +81,9 @@ std::optional<U8> Timer::Read(U16 address) const
     switch (address)
     {
     case 0xFF04:
-        return m_Div >> 8;
+        return static_cast<U8>(Counter() >> 8);
     case 0xFF05:
-        return m_TIMA;
+        return CurrentTima();
     case 0xFF06:
         return m_TMA;
     case 0xFF07:
@@ -48,43 +99,40 @@ bool Timer::Write(U16 address, U8 value)
     {
     case 0xFF04:
         {
+            Sync();
             // Falling edge detection: if selected bit was 1, it becomes 0
-            const bool oldBit = (m_Div >> GetTimerBit()) & 1;
-            const bool enabled = m_TAC & 0x04;
+            const bool oldBit = (Counter() >> GetTimerBit()) & 1;
 
-            m_Div = 0;
+            m_DivStart = m_Cycles;
 
-            if (enabled && oldBit) {
-                if (++m_TIMA == 0) {
-                    m_TIMA = m_TMA;
-                    m_InterruptFlag = true;
-                }
-            }
+            if (Enabled() && oldBit)
+                Increment();
+            Schedule();
             return true;
         }
     case 0xFF05:
+        Sync();
         m_TIMA = value;
+        Schedule();
         return true;
     case 0xFF06:
         m_TMA = value;
         return true;
     case 0xFF07:
         {
-            const bool oldEnable = m_TAC & 0x04;
-            const bool oldBit = (m_Div >> GetTimerBit()) & 1;
+            Sync();
+            const bool oldEnable = Enabled();
+            const bool oldBit = (Counter() >> GetTimerBit()) & 1;
 
             m_TAC = value & 0x07;
 
-            const bool newEnable = m_TAC & 0x04;
-            const bool newBit = (m_Div >> GetTimerBit()) & 1;
+            const bool newEnable = Enabled();
+            const bool newBit = (Counter() >> GetTimerBit()) & 1;
 
             // Falling edge: was high (enabled AND bit=1), now low (disabled OR bit=0)
-            if ((oldEnable && oldBit) && !(newEnable && newBit)) {
-                if (++m_TIMA == 0) {
-                    m_TIMA = m_TMA;
-                    m_InterruptFlag = true;
-                }
-            }
+            if ((oldEnable && oldBit) && !(newEnable && newBit))
+                Increment();
+            Schedule();
             return true;
         }
     default:
@@ -94,11 +142,20 @@ bool Timer::Write(U16 address, U8 value)
 
 bool Timer::InterruptRequested()
 {
+    Sync();
     const bool currentInterruptFlag = m_InterruptFlag;
     m_InterruptFlag = false;
+    Schedule();
     return currentInterruptFlag;
 }
 
+void Timer::ResetDiv()
+{
+    Sync();
+    m_DivStart = m_Cycles;
+    Schedule();
+}
+
 U8 Timer::GetTimerBit() const
 {
     constexpr std::array<U8, 4> BitPositions{9, 3, 5, 7};
@@ -107,20 +164,31 @@ U8 Timer::GetTimerBit() const
 
 void Timer::SaveState(std::ostream& out) const
 {
-    state::Write(out, m_Div);
-    state::Write(out, m_TIMA);
+    state::Write(out, static_cast<U16>(Counter()));
+    state::Write(out, CurrentTima());
     state::Write(out, m_TMA);
     state::Write(out, m_TAC);
     state::Write(out, m_InterruptFlag);
 }
 
+void Timer::Hash(hash::Xxh64& hasher) const
+{
+    hasher.Add(static_cast<U16>(Counter()), CurrentTima(), m_TMA, m_TAC, m_InterruptFlag);
+}
+
 void Timer::LoadState(std::istream& in)
 {
-    state::Read(in, m_Div);
+    U16 div = 0;
+    state::Read(in, div);
     state::Read(in, m_TIMA);
     state::Read(in, m_TMA);
     state::Read(in, m_TAC);
     state::Read(in, m_InterruptFlag);
+
+    // Rebuild the counter's origin from the restored cycle count
+    m_DivStart = m_Cycles - div;
+    m_SyncedAt = m_Cycles;
+    Schedule();
 }
 
 } // namespace gb
@@ -0,0 +1,285 @@
+#include <gb_trace.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <format>
+#include <print>
+#include <span>
+
+#include <compress.hpp>
+#include <state.hpp>
+
+namespace gb {
+
+namespace {
+    constexpr U32 Magic = 0x52544850;  // "PHTR"
+    constexpr U8 Version = 1;
+    constexpr U8 RecordSize = sizeof(TraceRecord);
+
+    constexpr Size RingCapacity = Size{1} << 18;
+    constexpr Size ChunkRecords = Size{1} << 16;
+    constexpr Size ContextRecords = 4;
+
+    // XOR with the previous record, then transpose so each byte position of
+    // the record becomes one contiguous plane: most planes end up as long
+    // runs of zeros
+    void EncodeChunk(std::span<const TraceRecord> records, std::vector<U8>& planes)
+    {
+        const Size count = records.size();
+        planes.assign(count * RecordSize, 0);
+        std::array<U8, RecordSize> previous{};
+        for (Size i = 0; i < count; ++i)
+        {
+            std::array<U8, RecordSize> bytes;
+            std::memcpy(bytes.data(), &records[i], RecordSize);
+            for (Size b = 0; b < RecordSize; ++b)
+                planes[b * count + i] = bytes[b] ^ previous[b];
+            previous = bytes;
+        }
+    }
+
+    void DecodeChunk(std::span<const U8> planes, std::span<TraceRecord> records)
+    {
+        const Size count = records.size();
+        std::array<U8, RecordSize> previous{};
+        for (Size i = 0; i < count; ++i)
+        {
+            for (Size b = 0; b < RecordSize; ++b)
+                previous[b] ^= planes[b * count + i];
+            std::memcpy(&records[i], previous.data(), RecordSize);
+        }
+    }
+
+    std::string FormatRecord(U64 index, const TraceRecord& r)
+    {
+        return std::format("{:>10} cyc={:<12} {:02X}:{:04X} op={:02X} A={:02X} F={:02X} BC={:02X}{:02X} DE={:02X}{:02X} HL={:02X}{:02X} SP={:04X}",
+            index, r.Cycle, r.Bank, r.PC, r.Opcode, r.A, r.F, r.B, r.C, r.D, r.E, r.H, r.L, r.SP);
+    }
+
+    std::string DifferingFields(const TraceRecord& a, const TraceRecord& b)
+    {
+        std::string fields;
+        auto check = [&](const char* name, bool differs) {
+            if (!differs) return;
+            if (!fields.empty()) fields += ' ';
+            fields += name;
+        };
+        check("cycle", a.Cycle != b.Cycle);
+        check("pc", a.PC != b.PC);
+        check("bank", a.Bank != b.Bank);
+        check("sp", a.SP != b.SP);
+        check("op", a.Opcode != b.Opcode);
+        check("a", a.A != b.A);
+        check("f", a.F != b.F);
+        check("b", a.B != b.B);
+        check("c", a.C != b.C);
+        check("d", a.D != b.D);
+        check("e", a.E != b.E);
+        check("h", a.H != b.H);
+        check("l", a.L != b.L);
+        return fields;
+    }
+}
+
+std::expected<std::unique_ptr<TraceRecorder>, std::string> TraceRecorder::Open(std::string_view path)
+{
+    std::ofstream file{std::string(path), std::ios::binary};
+    if (!file)
+        return std::unexpected(std::format("Cannot create trace file: {}", path));
+
+    state::Write(file, Magic);
+    state::Write(file, Version);
+    state::Write(file, RecordSize);
+    if (!file)
+        return std::unexpected(std::format("Cannot write trace file: {}", path));
+
+    return std::unique_ptr<TraceRecorder>(new TraceRecorder(std::move(file)));
+}
+
+TraceRecorder::TraceRecorder(std::ofstream file)
+    : m_File{std::move(file)}
+    , m_Ring{RingCapacity}
+    , m_Writer{[this](std::stop_token stop) { WriterLoop(stop); }}
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    Close();
+}
+
+void TraceRecorder::Record(const TraceRecord& record)
+{
+    // Never drop records: a trace with holes can't be diffed
+    while (!m_Ring.TryPush(record))
+        std::this_thread::yield();
+    ++m_Recorded;
+}
+
+bool TraceRecorder::Close()
+{
+    if (m_Writer.joinable())
+    {
+        m_Writer.request_stop();
+        m_Writer.join();
+        m_File.flush();
+    }
+    return m_File.good();
+}
+
+void TraceRecorder::WriterLoop(std::stop_token stop)
+{
+    std::vector<TraceRecord> chunk(ChunkRecords);
+    Size filled = 0;
+
+    for (;;)
+    {
+        // Read the flag first so a stop never strands records pushed before it
+        const bool stopping = stop.stop_requested();
+        const Size popped = m_Ring.Pop(chunk.data() + filled, ChunkRecords - filled);
+        filled += popped;
+
+        if (filled == ChunkRecords || (stopping && popped == 0 && filled > 0))
+        {
+            chunk.resize(filled);
+            WriteChunk(chunk);
+            chunk.resize(ChunkRecords);
+            filled = 0;
+        }
+        else if (stopping && popped == 0)
+            break;
+        else if (popped == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void TraceRecorder::WriteChunk(std::vector<TraceRecord>& chunk)
+{
+    std::vector<U8> planes;
+    EncodeChunk(chunk, planes);
+    const auto compressed = compress::Compress(planes);
+
+    state::Write(m_File, static_cast<U32>(chunk.size()));
+    state::Write(m_File, static_cast<U32>(compressed.size()));
+    m_File.write(reinterpret_cast<const char*>(compressed.data()), static_cast<std::streamsize>(compressed.size()));
+}
+
+std::expected<TraceReader, std::string> TraceReader::Open(std::string_view path)
+{
+    TraceReader reader;
+    reader.m_File.open(std::string(path), std::ios::binary);
+    if (!reader.m_File)
+        return std::unexpected(std::format("Cannot open trace file: {}", path));
+
+    U32 magic = 0;
+    U8 version = 0;
+    U8 recordSize = 0;
+    state::Read(reader.m_File, magic);
+    state::Read(reader.m_File, version);
+    state::Read(reader.m_File, recordSize);
+    if (!reader.m_File || magic != Magic)
+        return std::unexpected(std::format("Not a trace file: {}", path));
+    if (version != Version || recordSize != RecordSize)
+        return std::unexpected(std::format("Unsupported trace version {} in {}", version, path));
+
+    return reader;
+}
+
+bool TraceReader::Next(TraceRecord& record)
+{
+    if (m_Position == m_Chunk.size() && !ReadChunk())
+        return false;
+    record = m_Chunk[m_Position++];
+    return true;
+}
+
+bool TraceReader::ReadChunk()
+{
+    U32 count = 0;
+    U32 compressedSize = 0;
+    state::Read(m_File, count);
+    state::Read(m_File, compressedSize);
+    if (!m_File)
+        return false;  // Clean end of file
+
+    // Both sizes come from the file; check them before allocating
+    if (count == 0 || count > ChunkRecords || compressedSize > compress::CompressBound(Size{count} * RecordSize))
+    {
+        m_Error = "corrupt trace chunk";
+        return false;
+    }
+
+    std::vector<U8> compressed(compressedSize);
+    m_File.read(reinterpret_cast<char*>(compressed.data()), compressedSize);
+
+    std::vector<U8> planes(Size{count} * RecordSize);
+    if (!m_File || !compress::Decompress(compressed, planes))
+    {
+        m_Error = "corrupt or truncated trace chunk";
+        return false;
+    }
+
+    m_Chunk.resize(count);
+    DecodeChunk(planes, m_Chunk);
+    m_Position = 0;
+    return true;
+}
+
+S32 DiffTraces(const std::string& pathA, const std::string& pathB)
+{
+    auto a = TraceReader::Open(pathA);
+    if (!a)
+    {
+        std::println(stderr, "{}", a.error());
+        return 1;
+    }
+    auto b = TraceReader::Open(pathB);
+    if (!b)
+    {
+        std::println(stderr, "{}", b.error());
+        return 1;
+    }
+
+    std::deque<TraceRecord> context;
+    TraceRecord recordA{}, recordB{};
+    for (U64 index = 0;; ++index)
+    {
+        const bool hasA = a->Next(recordA);
+        const bool hasB = b->Next(recordB);
+        for (const auto* reader : {&*a, &*b})
+        {
+            if (!reader->Error().empty())
+            {
+                std::println(stderr, "{}: {}", reader == &*a ? pathA : pathB, reader->Error());
+                return 1;
+            }
+        }
+
+        if (!hasA && !hasB)
+        {
+            std::println("Traces are identical ({} instructions)", index);
+            return 0;
+        }
+        if (hasA && hasB && std::memcmp(&recordA, &recordB, sizeof(TraceRecord)) == 0)
+        {
+            context.push_back(recordA);
+            if (context.size() > ContextRecords)
+                context.pop_front();
+            continue;
+        }
+
+        std::println("Traces diverge at instruction {}:", index);
+        U64 contextIndex = index - context.size();
+        for (const auto& record : context)
+            std::println("  {}", FormatRecord(contextIndex++, record));
+        std::println("A {}", hasA ? FormatRecord(index, recordA) : "<end of trace>");
+        std::println("B {}", hasB ? FormatRecord(index, recordB) : "<end of trace>");
+        if (hasA && hasB)
+            std::println("Differs in: {}", DifferingFields(recordA, recordB));
+        return 1;
+    }
+}
+
+} // namespace gb